@@ -0,0 +1,144 @@
+/** @file
+   Benchmark of the parser of polynomials
+
+   Measures the throughput of the parser on generated lines whose monomials
+   are given in the canonical order and on the same lines with the monomials
+   shuffled, which have to be sorted and merged.
+
+   Usage: bench_parse_poly [number of lines]
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-26
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include "poly.h"
+#include "input_poly.h"
+#include "parse_poly.h"
+
+/** default number of generated lines */
+#define DEFAULT_LINES 200000
+/** maximal depth of the generated polynomials */
+#define MAX_DEPTH 3
+/** maximal number of monomials of a generated polynomial */
+#define MAX_MONOS 6
+
+/**
+ * Writes a random polynomial.
+ * @param f : file
+ * @param depth : number of variables left
+ * @param shuffle : whether the monomials are out of order
+ */
+static void WriteRandomPoly(FILE *f, int depth, bool shuffle) {
+    if (depth == 0 || rand() % 4 == 0) {
+        fprintf(f, "%ld", (long) (rand() % 2000001) - 1000000);
+        return;
+    }
+    int count = 1 + rand() % MAX_MONOS;
+    int exps[MAX_MONOS];
+    for (int i = 0, exp = 0; i < count; i++) {
+        exp += 1 + rand() % 100;
+        exps[i] = exp;
+    }
+    if (shuffle) {
+        for (int i = count - 1; i > 0; i--) {
+            int j = rand() % (i + 1), t = exps[i];
+            exps[i] = exps[j];
+            exps[j] = t;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            fputc(POLY_MONO_SEPARATOR, f);
+        }
+        fputc(POLY_OPENING_SEPARATOR, f);
+        WriteRandomPoly(f, depth - 1, shuffle);
+        fprintf(f, "%c%d%c", POLY_COEFF_EXP_SEPARATOR, exps[i],
+                POLY_CLOSING_SEPARATOR);
+    }
+}
+
+/**
+ * Generates a file with random polynomials, one in each line.
+ * @param lines : number of lines
+ * @param shuffle : whether the monomials are out of order
+ * @return file
+ */
+static FILE *Generate(long lines, bool shuffle) {
+    FILE *f = tmpfile();
+    if (f == NULL) {
+        perror("tmpfile");
+        exit(1);
+    }
+    /* The same seed gives the same polynomials in both files. */
+    srand(1);
+    for (long i = 0; i < lines; i++) {
+        WriteRandomPoly(f, MAX_DEPTH, shuffle);
+        fputc('\n', f);
+    }
+    fflush(f);
+    return f;
+}
+
+/**
+ * Parses all lines of a file and prints the throughput.
+ * @param name : name of the case
+ * @param f : file
+ */
+static void Measure(const char *name, FILE *f) {
+    long bytes = ftell(f), lines = 0, errors = 0;
+    struct timespec start, end;
+    rewind(f);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    InputOpen(fileno(f));
+    int c;
+    while ((c = InputGetc()) != EOF) {
+        InputUngetc(c);
+        Poly p;
+        int column;
+        if (ParsePolyLine(&p, &column)) {
+            errors++;
+        }
+        else {
+            PolyDestroy(&p);
+        }
+        InputSkipLine();
+        InputGetc();
+        lines++;
+    }
+    InputClose();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) +
+                     (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%-10s %10ld lines %12ld bytes %8.3f s %10.1f MB/s\n", name, lines,
+           bytes, seconds, bytes / seconds / 1e6);
+    if (errors > 0) {
+        printf("%-10s %10ld incorrect lines\n", name, errors);
+    }
+}
+
+/**
+ * Runs the benchmark.
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char *argv[]) {
+    long lines = argc > 1 ? atol(argv[1]) : DEFAULT_LINES;
+    if (lines <= 0) {
+        fprintf(stderr, "Usage: %s [number of lines]\n", argv[0]);
+        return 1;
+    }
+    FILE *canonical = Generate(lines, false);
+    FILE *shuffled = Generate(lines, true);
+    Measure("canonical", canonical);
+    Measure("shuffled", shuffled);
+    fclose(canonical);
+    fclose(shuffled);
+    return 0;
+}
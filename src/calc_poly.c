@@ -12,99 +12,209 @@
 #include <assert.h>
 #include <string.h>
 #include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
 #include "poly.h"
 #include "stack_poly.h"
+#include "input_poly.h"
+#include "parse_poly.h"
+#include "output_poly.h"
+#include "image_poly.h"
+#include "checkpoint_poly.h"
+#include "pack_poly.h"
+#include "register_poly.h"
+#include "server_poly.h"
+#include "program_poly.h"
+#include "lazy_poly.h"
+#include "pipeline_poly.h"
+#include "gcd_poly.h"
+#include "chain_poly.h"
+#include "fork_poly.h"
+#include "calc_poly.h"
 #include "utils.h"
 
-/** number of characters in the name of the longest command (IS_COEFF) */
-#define MAX_COMMAND_LENGTH 8
-/** number of commands */
-#define NUM_OF_COMMANDS 15
-/** character which opens a sequence in the notation of polynomials */
-#define POLY_OPENING_SEPARATOR '('
-/** character which closes a sequence in the notation of polynomials */
-#define POLY_CLOSING_SEPARATOR ')'
-/** character which separates coefficient and exponential in
-  * the notation of polynomials */
-#define POLY_COEFF_EXP_SEPARATOR ','
+/** number of characters in the name of the longest command (IS_DIVISIBLE) */
+#define MAX_COMMAND_LENGTH 12
 /** character which separates words in command names */
 #define COMMAND_WORDS_SEPARATOR '_'
 /** character which separates command names from parameters */
 #define COMMAND_PARAM_SEPARATOR ' '
-#define NO_ERROR 0
-#define ERROR_HANDLED 1
-#define ERROR_UNHANDLED 2
-
-/** Value returned by function, which checks the content of a given line */
-#define VAL_IF_POLY 0
-/** Value returned by function, which checks the content of a given line */
-#define VAL_IF_COMMAND 1
-/** Value returned by function, which checks the content of a given line */
-#define VAL_IF_EOF (-1)
-/** value if the parsed number is inside a monomial */
-#define NUM_IN_MONO 0
-/** value if the parsed number is at the end of a line */
-#define NUM_LAST 1
+
+/** default number of worker threads of the server */
+#define DEFAULT_WORKERS 4
+
 /** value if the parsed number is a coefficient and a part of a command */
 #define COEFF_IN_COMMAND 2
 /** value if the parsed number is an exponential and is a part of a command */
 #define EXP_IN_COMMAND 3
 /** value if the parsed number is a count in command */
 #define COUNT_IN_COMMAND 4
-/** Number by which the size of the array in the ParseTermsHelper
-  *  function is multiplicated */
-#define POLY_SIZE_MULTIPLICATION 2
-/** Starting size of the array in the ParseTermsHelper function */
-#define POLY_ARR_STARTING_SIZE 2
 
 /**
- * Enumerates calculator commands.
+ * Array with the names of the commands.
  */
-typedef enum CommandId {
-    ZERO_ID, IS_COEFF_ID, IS_ZERO_ID, CLONE_ID, ADD_ID, MUL_ID, NEG_ID, 
-    SUB_ID, IS_EQ_ID, DEG_ID, DEG_BY_ID, AT_ID, PRINT_ID, POP_ID, COMPOSE_ID
-} CommandId;
+const char *arrayOfCommands[NUM_OF_COMMANDS] = {
+    "ZERO", "IS_COEFF", "IS_ZERO", "CLONE", "ADD", "MUL", "NEG", "SUB", "IS_EQ",
+    "DEG", "DEG_BY", "AT", "PRINT", "POP", "COMPOSE", "DEPTH", "SAVE", "LOAD",
+    "CHECKPOINT", "STORE", "RECALL", "DROP", "MUL_ADD", "ADD_N",
+    "MUL_N", "MUL_PRINT", "MUL_SAVE", "DIV", "REM", "IS_DIVISIBLE", "GCD"
+};
 
 /**
- * Structure for commands and possible parameters.
+ * Stack collecting the printed results instead of the output or NULL.
+ * In the chain mode the results of a file are the stack of the next one.
  */
-typedef struct command_and_params {
-    CommandId id; ///< id of a command
-    poly_exp_t degByParam; ///< parameter of the DEG_BY command
-    poly_coeff_t atParam; ///< parameter of the AT command
-    unsigned composeParam; ///< parameter of the COMPOSE command
-}  CommandAndParam;
+static _Thread_local Stack *printedResults = NULL;
+
+void SetPrintedResults(Stack *s) {
+    printedResults = s;
+}
 
 /**
- * Array with the names of the commands.
+ * Whether the error messages of the lines are added to the output
+ * instead of stderr, as in the sessions of the server mode.
  */
-const char *arrayOfCommands[NUM_OF_COMMANDS] = {
-    "ZERO", "IS_COEFF", "IS_ZERO", "CLONE", "ADD", "MUL", "NEG", "SUB", "IS_EQ",
-    "DEG", "DEG_BY", "AT", "PRINT", "POP", "COMPOSE"
-};
+static _Thread_local bool errorsToOutput = false;
+
+void SetErrorsToOutput(bool toOutput) {
+    errorsToOutput = toOutput;
+}
+
+/**
+ * Writer to the next stage of the pipelined mode, to which the results
+ * and the error messages are sent instead of the output, or NULL.
+ */
+static _Thread_local PipeWriter *nextStage = NULL;
+
+void SetNextStage(PipeWriter *w) {
+    nextStage = w;
+}
+
+void FlushNextStage() {
+    PipeFlush(nextStage);
+}
+
+void SendMessage(int kind, int line, long param, Poly p, const char *text) {
+    Message m = {.kind = kind, .line = line, .param = param, .p = p,
+                 .text = NULL};
+    if (text != NULL) {
+        m.text = malloc(strlen(text) + 1);
+        assert(m.text != NULL);
+        strcpy(m.text, text);
+    }
+    PipeWrite(nextStage, &m);
+}
+
+void ErrorMsg(int lineCount, const char *message) {
+    if (nextStage != NULL) {
+        SendMessage(ERROR_MESSAGE, lineCount, 0, PolyZero(), message);
+        return;
+    }
+    if (errorsToOutput) {
+        OutputString("ERROR ");
+        OutputLong(lineCount);
+        OutputPutc(' ');
+        OutputString(message);
+        OutputEndLine();
+        return;
+    }
+    fprintf(stderr, "ERROR %d %s\n", lineCount, message);
+}
 
 void UnderflowErrorMsg(int lineCount) {
-    fprintf(stderr, "ERROR %d STACK UNDERFLOW\n", lineCount);
+    ErrorMsg(lineCount, "STACK UNDERFLOW");
 }
 
 void ParsingErrorMsg(int lineCount, int columnCount) {
+    if (nextStage != NULL) {
+        SendMessage(PARSING_ERROR_MESSAGE, lineCount, columnCount,
+                    PolyZero(), NULL);
+        return;
+    }
+    if (errorsToOutput) {
+        OutputString("ERROR ");
+        OutputLong(lineCount);
+        OutputPutc(' ');
+        OutputLong(columnCount);
+        OutputEndLine();
+        return;
+    }
     fprintf(stderr, "ERROR %d %d\n", lineCount, columnCount);
 }
 
 void WrongCommandErrorMsg(int lineCount) {
-    fprintf(stderr, "ERROR %d WRONG COMMAND\n", lineCount);
+    ErrorMsg(lineCount, "WRONG COMMAND");
 }
 
 void WrongValueErrorMsg(int lineCount) {
-    fprintf(stderr, "ERROR %d WRONG VALUE\n", lineCount);
+    ErrorMsg(lineCount, "WRONG VALUE");
 }
 
 void WrongVariableErrorMsg(int lineCount) {
-    fprintf(stderr, "ERROR %d WRONG VARIABLE\n", lineCount);
+    ErrorMsg(lineCount, "WRONG VARIABLE");
 }
 
 void WrongCountErrorMsg(int lineCount) {
-    fprintf(stderr, "ERROR %d WRONG COUNT\n", lineCount);
+    ErrorMsg(lineCount, "WRONG COUNT");
+}
+
+void MemoryErrorMsg(int lineCount) {
+    ErrorMsg(lineCount, "OUT OF MEMORY");
+}
+
+void WrongFileErrorMsg(int lineCount) {
+    ErrorMsg(lineCount, "WRONG FILE");
+}
+
+void WrongNameErrorMsg(int lineCount) {
+    ErrorMsg(lineCount, "WRONG NAME");
+}
+
+void UsageErrorMsg() {
+    fprintf(stderr, "Usage: calc_poly [--mem-limit BYTES] [--op-limit BYTES] "
+                    "[--spill-file PATH] [--spill-depth N] "
+                    "[--restore PATH] "
+                    "[--storage-format image|packed|packed-zlib] [--lazy] "
+                    "[--pipeline] [--force-pipeline] [--parallel N] "
+                    "[--mul-processes N] "
+                    "[--mul-min-work N] "
+                    "[--chain DIR | --server SOCKET [--workers N] "
+                    "[--server-dir DIR] | "
+                    "--compile PROGRAM | --exec PROGRAM]\n");
+}
+
+void CommandErrorMsg(int error, int lineCount) {
+    if (error == ERROR_UNDERFLOW) {
+        UnderflowErrorMsg(lineCount);
+    }
+    else if (error == ERROR_MEMORY) {
+        MemoryErrorMsg(lineCount);
+    }
+    else if (error == ERROR_SAVE) {
+        ErrorMsg(lineCount, "CANNOT SAVE");
+    }
+    else if (error == ERROR_LOAD) {
+        ErrorMsg(lineCount, "CANNOT LOAD");
+    }
+    else if (error == ERROR_CHECKPOINT) {
+        ErrorMsg(lineCount, "CANNOT CHECKPOINT");
+    }
+    else if (error == ERROR_REGISTER) {
+        ErrorMsg(lineCount, "UNKNOWN REGISTER");
+    }
+    else if (error == ERROR_TOO_LARGE) {
+        ErrorMsg(lineCount, "RESULT TOO LARGE");
+    }
+    else if (error == ERROR_DIVISION) {
+        ErrorMsg(lineCount, "DIVISION BY ZERO");
+    }
+    else if (error == ERROR_FILE) {
+        WrongFileErrorMsg(lineCount);
+    }
+    else if (error == ERROR_CONFINED) {
+        ErrorMsg(lineCount, "FILE NOT ALLOWED");
+    }
 }
 
 /**
@@ -138,6 +248,15 @@ bool CheckIfUnsignedIntOverflows(int number, int digit) {
  * @return 
  */
 poly_exp_t CalculateUnsigned(bool *overflows, int *c, int *columnCount) {
+    uint64_t value;
+    InputUngetc(*c);
+    int digits = InputDigits(UINT_MAX, &value);
+    if (digits > 0) {
+        *columnCount += digits;
+        *c = InputGetc();
+        return value;
+    }
+    *c = InputGetc();
     unsigned number = 0;
     unsigned ascii = '0';
     while (IsDigit(*c) && !*overflows) {
@@ -145,7 +264,7 @@ poly_exp_t CalculateUnsigned(bool *overflows, int *c, int *columnCount) {
         if (!*overflows) {
             number *= 10;
             number += *c - ascii;
-            *c = getchar();
+            *c = InputGetc();
             (*columnCount)++;
         }
     }
@@ -162,7 +281,7 @@ poly_exp_t CalculateUnsigned(bool *overflows, int *c, int *columnCount) {
  */
 bool ParseUnsigned(int inside, unsigned *exp, int lineCount, int *columnCount) {
     int lastChar, c;
-    lastChar = c = getchar();
+    lastChar = c = InputGetc();
     (*columnCount)++;
     if (!IsDigit(c)) {
         if (inside == EXP_IN_COMMAND) {
@@ -171,10 +290,7 @@ bool ParseUnsigned(int inside, unsigned *exp, int lineCount, int *columnCount) {
         else if (inside == COUNT_IN_COMMAND) {
             WrongCountErrorMsg(lineCount);
         }
-        else {
-            ParsingErrorMsg(lineCount, *columnCount);
-        }
-        ungetc(lastChar, stdin); (*columnCount)--;
+        InputUngetc(lastChar); (*columnCount)--;
         return true;
     }
     bool overflows = false, result;
@@ -187,13 +303,6 @@ bool ParseUnsigned(int inside, unsigned *exp, int lineCount, int *columnCount) {
         else if (inside == COUNT_IN_COMMAND) {
             WrongCountErrorMsg(lineCount);
         }
-        else if (inside == NUM_IN_MONO) {
-            ParsingErrorMsg(lineCount, *columnCount);
-        }
-        result = true;
-    }
-    else if (inside == NUM_IN_MONO && c != POLY_CLOSING_SEPARATOR) {
-        ParsingErrorMsg(lineCount, *columnCount); 
         result = true;
     }
     else if (c != '\n' && c != EOF &&
@@ -210,21 +319,10 @@ bool ParseUnsigned(int inside, unsigned *exp, int lineCount, int *columnCount) {
         *exp = number;
         result = false;
     }
-    ungetc(lastChar, stdin); (*columnCount)--;
+    InputUngetc(lastChar); (*columnCount)--;
     return result;
 }
 
-/**
- * Evaluates an exponential inside a polynomial.
- * @param exp
- * @param lineCount
- * @param columnCount
- * @return 
- */
-bool ParseExpInPoly(poly_exp_t *exp, int lineCount, int *columnCount) {
-    return ParseUnsigned(NUM_IN_MONO, exp, lineCount, columnCount);
-}
-
 /**
  * Evaluates an exponential inside a command.
  * @param exp
@@ -274,6 +372,16 @@ bool CheckIfLongOverflows(long number, long digit) {
  */
 poly_coeff_t CalculateCoeff(bool *overflows, bool negative, int *c, 
                             int *columnCount) {
+    uint64_t value, max = negative ? (uint64_t) LONG_MAX + 1 : LONG_MAX;
+    InputUngetc(*c);
+    int digits = InputDigits(max, &value);
+    if (digits > 0) {
+        *columnCount += digits;
+        *c = InputGetc();
+        return negative ? -(poly_coeff_t) (value - 1) - 1 :
+               (poly_coeff_t) value;
+    }
+    *c = InputGetc();
     poly_coeff_t number = 0;
     poly_coeff_t ascii = '0';
     while (IsDigit(*c) && !*overflows) {
@@ -287,7 +395,7 @@ poly_coeff_t CalculateCoeff(bool *overflows, bool negative, int *c,
                 number *= 10;
                 number += *c - ascii;
             }
-            *c = getchar();
+            *c = InputGetc();
             (*columnCount)++;
         }
     }
@@ -305,22 +413,19 @@ poly_coeff_t CalculateCoeff(bool *overflows, bool negative, int *c,
 bool ParseCoeff(int inside, poly_coeff_t *coeff, int lineCount, 
                        int *columnCount) {
     int lastChar, c;
-    lastChar = c = getchar();
+    lastChar = c = InputGetc();
     (*columnCount)++;
     bool negative = false;
     if (c == '-') {
         negative = true;
-        lastChar = c = getchar();
+        lastChar = c = InputGetc();
         (*columnCount)++;
     }
     if (!IsDigit(c)) {
         if (inside == COEFF_IN_COMMAND) {
             WrongValueErrorMsg(lineCount);
         }
-        else {
-            ParsingErrorMsg(lineCount, *columnCount);
-        }
-        ungetc(lastChar, stdin); (*columnCount)--;
+        InputUngetc(lastChar); (*columnCount)--;
         return true;
     }
     
@@ -331,14 +436,6 @@ bool ParseCoeff(int inside, poly_coeff_t *coeff, int lineCount,
         if (inside == COEFF_IN_COMMAND) {
             WrongValueErrorMsg(lineCount);
         }
-        else if (inside == NUM_IN_MONO || inside == NUM_LAST) {
-            ParsingErrorMsg(lineCount, *columnCount);
-        }
-        result = true;
-    }
-    else if (inside == NUM_IN_MONO && c != POLY_COEFF_EXP_SEPARATOR ||
-             inside == NUM_LAST && c != '\n' && c != EOF) {
-        ParsingErrorMsg(lineCount, *columnCount);
         result = true;
     }
     else if (inside == COEFF_IN_COMMAND && c != '\n' && c != EOF) {
@@ -349,84 +446,172 @@ bool ParseCoeff(int inside, poly_coeff_t *coeff, int lineCount,
         *coeff = number;
         result = false;
     }
-    ungetc(lastChar, stdin); (*columnCount)--;
+    InputUngetc(lastChar); (*columnCount)--;
     return result;
 }
 
 /**
- * Evaluates a coefficient inside a polynomial.
+ * Evaluates a coefficient in a command.
  * @param coeff
  * @param lineCount
  * @param columnCount
  * @return 
  */
-bool ParseCoeffInPoly(poly_coeff_t *coeff, int lineCount, int *columnCount) {
-    return ParseCoeff(NUM_IN_MONO, coeff, lineCount, columnCount);
+bool ParseCoeffInCommand(poly_coeff_t *coeff, int lineCount, int *columnCount) {
+    return ParseCoeff(COEFF_IN_COMMAND, coeff, lineCount, columnCount);
 }
 
 /**
- * Evaluates a coefficient at the end of line.
- * @param coeff
- * @param lineCount
- * @param columnCount
- * @return 
+ * Combines the length and the first and last characters of a command name
+ * into a key, which is different for every command.
+ */
+#define COMMAND_KEY(length, first, last) \
+    ((length) << 16 | (first) << 8 | (last))
+
+/**
+ * Checks if the character can be a part of a command name.
+ * @param c
+ * @return
  */
-bool ParseCoeffAtEnd(poly_coeff_t *coeff, int lineCount, int *columnCount) {
-    return ParseCoeff(NUM_LAST, coeff, lineCount, columnCount);
+static inline bool IsCommandChar(int c) {
+    return c >= 'A' && c <= 'Z' || c == COMMAND_WORDS_SEPARATOR;
 }
 
 /**
- * Evaluates a coefficient in a command.
- * @param coeff
- * @param lineCount
+ * Finds a command by its name.
+ * @param name : name, not terminated with the null character
+ * @param length : length of the name
+ * @return id of the command or NUM_OF_COMMANDS if there is no such command
+ */
+int LookupCommand(const char *name, size_t length) {
+    if (length == 0) {
+        return NUM_OF_COMMANDS;
+    }
+    int id;
+    switch (COMMAND_KEY(length, name[0], name[length - 1])) {
+        case COMMAND_KEY(2, 'A', 'T'): id = AT_ID; break;
+        case COMMAND_KEY(3, 'A', 'D'): id = ADD_ID; break;
+        case COMMAND_KEY(3, 'D', 'G'): id = DEG_ID; break;
+        case COMMAND_KEY(3, 'D', 'V'): id = DIV_ID; break;
+        case COMMAND_KEY(3, 'G', 'D'): id = GCD_ID; break;
+        case COMMAND_KEY(3, 'M', 'L'): id = MUL_ID; break;
+        case COMMAND_KEY(3, 'N', 'G'): id = NEG_ID; break;
+        case COMMAND_KEY(3, 'P', 'P'): id = POP_ID; break;
+        case COMMAND_KEY(3, 'R', 'M'): id = REM_ID; break;
+        case COMMAND_KEY(3, 'S', 'B'): id = SUB_ID; break;
+        case COMMAND_KEY(4, 'D', 'P'): id = DROP_ID; break;
+        case COMMAND_KEY(4, 'L', 'D'): id = LOAD_ID; break;
+        case COMMAND_KEY(4, 'S', 'E'): id = SAVE_ID; break;
+        case COMMAND_KEY(4, 'Z', 'O'): id = ZERO_ID; break;
+        case COMMAND_KEY(5, 'A', 'N'): id = ADD_N_ID; break;
+        case COMMAND_KEY(5, 'C', 'E'): id = CLONE_ID; break;
+        case COMMAND_KEY(5, 'D', 'H'): id = DEPTH_ID; break;
+        case COMMAND_KEY(5, 'I', 'Q'): id = IS_EQ_ID; break;
+        case COMMAND_KEY(5, 'M', 'N'): id = MUL_N_ID; break;
+        case COMMAND_KEY(5, 'P', 'T'): id = PRINT_ID; break;
+        case COMMAND_KEY(5, 'S', 'E'): id = STORE_ID; break;
+        case COMMAND_KEY(6, 'D', 'Y'): id = DEG_BY_ID; break;
+        case COMMAND_KEY(6, 'R', 'L'): id = RECALL_ID; break;
+        case COMMAND_KEY(7, 'C', 'E'): id = COMPOSE_ID; break;
+        case COMMAND_KEY(7, 'I', 'O'): id = IS_ZERO_ID; break;
+        case COMMAND_KEY(7, 'M', 'D'): id = MUL_ADD_ID; break;
+        case COMMAND_KEY(8, 'I', 'F'): id = IS_COEFF_ID; break;
+        case COMMAND_KEY(8, 'M', 'E'): id = MUL_SAVE_ID; break;
+        case COMMAND_KEY(9, 'M', 'T'): id = MUL_PRINT_ID; break;
+        case COMMAND_KEY(10, 'C', 'T'): id = CHECKPOINT_ID; break;
+        case COMMAND_KEY(12, 'I', 'E'): id = IS_DIVISIBLE_ID; break;
+        default: return NUM_OF_COMMANDS;
+    }
+    if (memcmp(name, arrayOfCommands[id], length) != 0) {
+        return NUM_OF_COMMANDS;
+    }
+    return id;
+}
+
+/**
+ * Reads a command name directly from the input buffer.
+ * At most MAX_COMMAND_LENGTH characters are read.
  * @param columnCount
- * @return 
+ * @return id of the command or NUM_OF_COMMANDS if there is no such command
  */
-bool ParseCoeffInCommand(poly_coeff_t *coeff, int lineCount, int *columnCount) {
-    return ParseCoeff(COEFF_IN_COMMAND, coeff, lineCount, columnCount);
+int ReadCommandName(int *columnCount) {
+    size_t available = InputEnsure(MAX_COMMAND_LENGTH);
+    const char *name = calcInput.cur;
+    size_t length = 0;
+    while (length < available && length < MAX_COMMAND_LENGTH &&
+           IsCommandChar((unsigned char) name[length])) {
+        length++;
+    }
+    calcInput.cur += length;
+    *columnCount += length;
+    return LookupCommand(name, length);
 }
 
 /**
- * Fills the buffer with a command name.
- * @param c
- * @param count
+ * Parses a name, which takes the rest of the line.
+ * @param name
+ * @param maxLength
  * @param columnCount
- * @param buf
+ * @return true if the name is empty or too long, false otherwise
  */
-void FillCommandBuffer(int *c, int *count, int *columnCount, char buf[]) {
-    while ((*c >= 'A' && *c <= 'Z' || *c == COMMAND_WORDS_SEPARATOR) &&
-            *count < MAX_COMMAND_LENGTH) {
-        buf[*count] = *c;
-        *c = getchar();
-        (*count)++;
+bool ParseRestOfLine(char *name, size_t maxLength, int *columnCount) {
+    size_t length = 0;
+    int c = InputGetc();
+    (*columnCount)++;
+    while (c != '\n' && c != EOF && length < maxLength) {
+        name[length++] = c;
+        c = InputGetc();
         (*columnCount)++;
     }
-    buf[*count] = '\0';
+    name[length] = '\0';
+    InputUngetc(c); (*columnCount)--;
+    return length == 0 || c != '\n' && c != EOF;
 }
 
 /**
- * Parses a command form stdin.
- * @param cap
+ * Parses a file name, which takes the rest of the line.
+ * @param name
  * @param lineCount
- * @return 
+ * @param columnCount
+ * @return
+ */
+bool ParseFileName(char *name, int lineCount, int *columnCount) {
+    if (ParseRestOfLine(name, MAX_FILE_NAME_LENGTH, columnCount)) {
+        WrongFileErrorMsg(lineCount);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parses a name of a register, which takes the rest of the line.
+ * @param name
+ * @param lineCount
+ * @param columnCount
+ * @return
  */
+bool ParseRegisterName(char *name, int lineCount, int *columnCount) {
+    if (ParseRestOfLine(name, MAX_REGISTER_NAME_LENGTH, columnCount)) {
+        WrongNameErrorMsg(lineCount);
+        return true;
+    }
+    return false;
+}
+
 bool ParseCommand(CommandAndParam *cap, int lineCount) {
-    char buf[MAX_COMMAND_LENGTH + 1];
-    int lastChar, c;
-    lastChar = c = getchar(); 
-    int count = 0, columnCount = 1;
-    int commandId = 0;
+    int columnCount = 0;
+    int commandId = ReadCommandName(&columnCount);
+    int c = InputGetc();
+    columnCount++;
     bool error = false;
-    FillCommandBuffer(&c, &count, &columnCount, buf);
-    lastChar = c;
-    while (commandId < NUM_OF_COMMANDS &&
-           strcmp(buf, arrayOfCommands[commandId]) != 0) {
-        commandId++;
-    }
-    if (commandId < NUM_OF_COMMANDS &&
-        strcmp(buf, arrayOfCommands[commandId]) == 0) {
+    if (commandId < NUM_OF_COMMANDS) {
         if ((commandId == DEG_BY_ID || commandId == AT_ID || 
-             commandId == COMPOSE_ID) && c != ' ' && c != '\n' && c != EOF) {
+             commandId == COMPOSE_ID || commandId == ADD_N_ID ||
+             commandId == MUL_N_ID || commandId == SAVE_ID ||
+             commandId == LOAD_ID || commandId == CHECKPOINT_ID ||
+             commandId == MUL_SAVE_ID ||
+             commandId == STORE_ID || commandId == RECALL_ID ||
+             commandId == DROP_ID) && c != ' ' && c != '\n' && c != EOF) {
             /* If the name of the command isn't divided by whitespace
              * and isn't the end of the line. */
             WrongCommandErrorMsg(lineCount);
@@ -442,7 +627,7 @@ bool ParseCommand(CommandAndParam *cap, int lineCount) {
                 else {
                     error = true;
                 }
-                lastChar = getchar(); columnCount++;
+                c = InputGetc(); columnCount++;
             }
             else {
                 WrongVariableErrorMsg(lineCount);
@@ -459,363 +644,340 @@ bool ParseCommand(CommandAndParam *cap, int lineCount) {
                 else {
                     error = true;
                 }
-                lastChar = getchar(); columnCount++;
+                c = InputGetc(); columnCount++;
             }
             else {
                 WrongValueErrorMsg(lineCount);
                 error = true;
             }
         }
-        else if (commandId == COMPOSE_ID) {
+        else if (commandId == COMPOSE_ID || commandId == ADD_N_ID ||
+                 commandId == MUL_N_ID) {
             if (c == ' ') {
                 unsigned count;
                 if (!ParseCount(&count, lineCount, &columnCount)) {
-                    cap->composeParam = count;
+                    cap->countParam = count;
                     cap->id = commandId;
                 }
                 else {
                     error = true;
                 }
+                c = InputGetc(); columnCount++;
             }
             else {
                 WrongCountErrorMsg(lineCount);
                 error = true;
             }
         }
+        else if (commandId == SAVE_ID || commandId == LOAD_ID ||
+                 commandId == CHECKPOINT_ID || commandId == MUL_SAVE_ID) {
+            if (c == ' ') {
+                if (!ParseFileName(cap->fileParam, lineCount, &columnCount)) {
+                    cap->id = commandId;
+                }
+                else {
+                    error = true;
+                }
+                c = InputGetc(); columnCount++;
+            }
+            else {
+                WrongFileErrorMsg(lineCount);
+                error = true;
+            }
+        }
+        else if (commandId == STORE_ID || commandId == RECALL_ID ||
+                 commandId == DROP_ID) {
+            if (c == ' ') {
+                if (!ParseRegisterName(cap->nameParam, lineCount,
+                                       &columnCount)) {
+                    cap->id = commandId;
+                }
+                else {
+                    error = true;
+                }
+                c = InputGetc(); columnCount++;
+            }
+            else {
+                WrongNameErrorMsg(lineCount);
+                error = true;
+            }
+        }
         else {
             if (c == '\n' || c == EOF) {
                 cap->id = commandId;
             }
             else {
-                fprintf(stderr, "ERROR %d WRONG COMMAND\n", lineCount);
+                WrongCommandErrorMsg(lineCount);
                 error = true;
             }
         }
     }
     else {
-        fprintf(stderr, "ERROR %d WRONG COMMAND\n", lineCount);
+        WrongCommandErrorMsg(lineCount);
         error = true;
     }
-    ungetc(lastChar, stdin); columnCount--;
+    InputUngetc(c); columnCount--;
     return error;
 }
 
-int ParsePolyHelper(Poly *p, int lineCount, int *columnCount);
+bool ParsePoly(Poly *p, int lineCount) {
+    int columnCount;
+    if (ParsePolyLine(p, &columnCount)) {
+        ParsingErrorMsg(lineCount, columnCount);
+        return true;
+    }
+    return false;
+}
 
 /**
- * Parses and builds a monomial.
- * @param m
- * @param lineCount
- * @param columnCount
- * @return message about lack of error, handled error or unhandled error
+ * Puts the result of an operation in place of its arguments on the stack.
+ * Deletes the result if it doesn't fit in the memory limit.
+ * @param s
+ * @param n : number of arguments
+ * @param p : result
+ * @return 
  */
-int ParseMonoHelper(Mono *m, int lineCount, int *columnCount) {
-    int error = ERROR_UNHANDLED;
-    int c, lastChar;
-    lastChar = c = getchar();
-    (*columnCount)++;
-    Poly p;
-    if (c == POLY_OPENING_SEPARATOR) {
-        ungetc(c, stdin); (*columnCount)--;
-        error = ParsePolyHelper(&p, lineCount, columnCount);
-        lastChar = getchar(); (*columnCount)++;
-        if (error == NO_ERROR){ 
-            c = lastChar = getchar();
-            (*columnCount)++;
-            if (c == POLY_COEFF_EXP_SEPARATOR) {
-                error = NO_ERROR;
-            }
-            else {
-                PolyDestroy(&p);
-                error = ERROR_UNHANDLED;
-            }
-        }
+int ReplaceArgs(Stack *s, size_t n, Poly p) {
+    if (Replace(s, n, p)) {
+        PolyDestroy(&p);
+        return ERROR_MEMORY;
     }
-    else if (IsDigit(c) || c == '-') {
-        poly_coeff_t coeff;
-        ungetc(c, stdin);
-        (*columnCount)--;
-        if (!ParseCoeffInPoly(&coeff, lineCount, columnCount)) {
-            p = PolyFromCoeff(coeff);
-            error = NO_ERROR;
-        }
-        else {
-            error =  ERROR_HANDLED;
-        }
-        lastChar = c = getchar(); (*columnCount)++;
+    return NO_ERROR;
+}
+
+/**
+ * Pushes polynomial equal to zero on the stack.
+ * @param s
+ * @return 
+ */
+int PushZero(Stack *s) {
+    return ReplaceArgs(s, 0, PolyZero());
+}
+
+/**
+ * Prints a number which is the result of a command.
+ * @param n
+ * @return 
+ */
+int PrintNumber(long n) {
+    if (printedResults != NULL) {
+        return Push(printedResults, PolyFromCoeff(n)) ? ERROR_MEMORY :
+                                                        NO_ERROR;
     }
-    if (error == NO_ERROR) {
-        poly_exp_t exp;
-        error = ParseExpInPoly(&exp, lineCount, columnCount);
-        lastChar = c = getchar(); (*columnCount)++;
-        if (error == NO_ERROR) {
-            m->exp = exp;
-            m->p = p;
-            ungetc(lastChar, stdin); (*columnCount)--;
-            return NO_ERROR;
-        }
-        else {
-            PolyDestroy(&p);
-            error = ERROR_HANDLED;
-        }
+    if (nextStage != NULL) {
+        SendMessage(PRINT_NUMBER_MESSAGE, 0, n, PolyZero(), NULL);
+        return NO_ERROR;
     }
-    ungetc(lastChar, stdin); (*columnCount)--;
-    return error;
+    OutputLong(n);
+    OutputEndLine();
+    return NO_ERROR;
 }
 
 /**
- * Parses and builds a polynomial if it isn't only const polynomial in the line.
+ * Prints a polynomial which is the result of a command.
  * @param p
- * @param lineCount
- * @param columnCount
- * @return message about lack of error, handled error or unhandled error
+ * @return 
  */
-int ParsePolyHelper(Poly *p, int lineCount, int *columnCount) {
-    int count = 0, size = POLY_ARR_STARTING_SIZE, error = NO_ERROR;
-    int lastChar, c;
-    lastChar = c = getchar();
-    (*columnCount)++;
-    bool hasNext = true;
-    Mono *arr = calloc(size, sizeof(Mono));
-    assert (arr != NULL);
-    while (error == NO_ERROR && hasNext) {
-        if (c != POLY_OPENING_SEPARATOR) {
-            error = ERROR_UNHANDLED;
-        }
-        else {
-            if (count >= size) {
-                size *= POLY_SIZE_MULTIPLICATION;
-                arr = realloc(arr, size * sizeof(Mono));
-                assert(arr != NULL);
-            }
-            Mono temp;
-            error = ParseMonoHelper(&temp, lineCount, columnCount);
-            lastChar = getchar(); (*columnCount)++;
-            if (error == NO_ERROR) {
-                if (!PolyIsZero(&temp.p)) {
-                    arr[count] = temp;
-                    count++;
-                }
-                c = getchar();
-                (*columnCount)++;
-                if (c != '+') {
-                    hasNext = false;
-                    ungetc(c, stdin);
-                    (*columnCount)--;
-                }
-                else {
-                    lastChar = c = getchar();
-                    (*columnCount)++;
-                }
-            }
+int PrintResult(const Poly *p) {
+    if (printedResults != NULL) {
+        Poly q = PolyClone(p);
+        if (Push(printedResults, q)) {
+            PolyDestroy(&q);
+            return ERROR_MEMORY;
         }
+        return NO_ERROR;
     }
-    if (error == NO_ERROR) {
-        *p = PolyAddMonos(count, arr);
+    if (nextStage != NULL) {
+        /* The polynomial is formatted by the printing stage. */
+        SendMessage(PRINT_POLY_MESSAGE, 0, 0, PolyClone(p), NULL);
+        return NO_ERROR;
     }
-    else {
-        for (int i = 0; i < count; i++) {
-            PolyDestroy(&arr[i].p);
-        }
-    }
-    free(arr);
-    ungetc(lastChar, stdin); (*columnCount)--;
-    return error;
+    OutputPoly(p);
+    OutputEndLine();
+    return NO_ERROR;
 }
 
 /**
- * Parses and build a polynomial from stdin.
- * @param p
- * @param lineCount
- * @return 0 if incorrect, 1 if correct
+ * Checks if a polynomial on the top of the stack is a coefficient.
+ * @param s
+ * @return 
  */
-bool ParsePoly(Poly *p, int lineCount) {
-    int lastChar, c;
-    lastChar = c = getchar();
-    int columnCount = 1, error, result;
-    if (c != POLY_OPENING_SEPARATOR && c != '-' && !IsDigit(c)) {
-        ParsingErrorMsg(lineCount, columnCount);
-        result = true;
-    }
-    else if (IsDigit(c) || c == '-') {
-        poly_coeff_t coeff;
-        ungetc(c, stdin); columnCount--;
-        error = ParseCoeffAtEnd(&coeff, lineCount, &columnCount);
-        lastChar = getchar(); columnCount++;
-        if (!error) {
-            *p = PolyFromCoeff(coeff);
-            result = false;
-        }
-        else {
-            result = true;
-        }
+int IsCoeff(Stack *s) {
+    if (!Empty(s)) {
+        return PrintNumber(PolyIsCoeff(Peek(s, 0)));
     }
-    else {
-        ungetc(c, stdin); columnCount--;
-        error = ParsePolyHelper(p, lineCount, &columnCount);
-        lastChar = c = getchar(); columnCount++;
-        if (error == NO_ERROR) {
-            lastChar = c = getchar(); columnCount++;
-            if (c == EOF || c == '\n') {
-                result = false;
-            }
-            else {
-                error = ERROR_UNHANDLED;
-            }
-        }
-        if (error == ERROR_UNHANDLED) {
-            ParsingErrorMsg(lineCount, columnCount);
-            result = true;
-        }
-        else if (error == ERROR_HANDLED) {
-            result = true;
-        }
+    return ERROR_UNDERFLOW;
+}
+
+/**
+ * Checks if a polynomial equal to zero is on top of the stack.
+ * @param s
+ * @return 
+ */
+int IsZero(Stack *s) {
+    if (!Empty(s)) {
+        return PrintNumber(PolyIsZero(Peek(s, 0)));
     }
-    ungetc(lastChar, stdin); columnCount--;
-    return result;
+    return ERROR_UNDERFLOW;
 }
 
 /**
- * Checks if the stack contains more than one polynomial.
- * @param sPtr
+ * Checks if two polynomials on the top of the stack are equal.
+ * @param s
  * @return 
  */
-bool TwoElementsOnStack(Stack **sPtr) {
-    if (!Empty(*sPtr)) {
-        Poly p = Pop(sPtr);
-        bool result = !Empty(*sPtr);
-        Push(sPtr, p);
-        return result;
+int IsEq(Stack *s) {
+    if (Depth(s) >= 2) {
+        return PrintNumber(PolyIsEq(Peek(s, 0), Peek(s, 1)));
     }
-    return false;
+    return ERROR_UNDERFLOW;
 }
 
 /**
- * Pushes polynomial equal to zero on the stack.
- * @param sPtr
+ * Puts a copy of the polynomial on the top of the stack on the stack.
+ * @param s
+ * @return 
  */
-void PushZero(Stack **sPtr) {
-    Push(sPtr, PolyZero());
+int Clone(Stack *s) {
+    if (Empty(s)) {
+        return ERROR_UNDERFLOW;
+    }
+    Image *image = PeekImage(s, 0);
+    if (image != NULL) {
+        /* A polynomial of an image is shared instead of copied. */
+        return PushImage(s, *Peek(s, 0), image) ? ERROR_MEMORY : NO_ERROR;
+    }
+    return ReplaceArgs(s, 0, PolyClone(Peek(s, 0)));
 }
 
 /**
- * Checks if a polynomial on the top of the stack is a coefficient.
+ * Adds the two polynomials on the top of the stack.
  * @param s
  * @return 
  */
-bool IsCoeff(Stack *s) {
-    if (!Empty(s)) {
-        Poly p = Top(s);
-        printf("%d\n", PolyIsCoeff(&p));
-        return false;
+int Add(Stack *s) {
+    if (Depth(s) >= 2) {
+        return ReplaceArgs(s, 2, PolyAdd(Peek(s, 0), Peek(s, 1)));
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
- * Checks if a polynomial equal to zero is on top of the stack.
+ * Multiplies the two polynomials on the top of the stack.
  * @param s
  * @return 
  */
-bool IsZero(Stack *s) {
-    if (!Empty(s)) {
-        Poly p = Top(s);
-        printf("%d\n", PolyIsZero(&p));
-        return false;
+int Mul(Stack *s) {
+    if (Depth(s) >= 2) {
+        return ReplaceArgs(s, 2, ForkMul(Peek(s, 0), Peek(s, 1)));
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
- * Checks if two polynomials on the top of the stack are equal.
- * @param sPtr
+ * Adds the product of the two polynomials on the top of the stack to
+ * the third one, which is changed in place.
+ * @param s
  * @return 
  */
-bool IsEq(Stack **sPtr) {
-    if (TwoElementsOnStack(sPtr)) {
-        Poly p = Pop(sPtr);
-        Poly q = Top(*sPtr);
-        Push(sPtr, p);
-        printf("%d\n", PolyIsEq(&p, &q));
-        return false;
+int MulAdd(Stack *s) {
+    if (Depth(s) < 3) {
+        return ERROR_UNDERFLOW;
+    }
+    Poly acc;
+    if (Take(s, 2, &acc)) {
+        return ERROR_MEMORY;
+    }
+    PolyMulAdd(&acc, Peek(s, 0), Peek(s, 1));
+    if (Replace(s, 3, acc)) {
+        /* The product is subtracted back, so the stack isn't changed. */
+        Poly neg = PolyNeg(Peek(s, 0));
+        PolyMulAdd(&acc, &neg, Peek(s, 1));
+        PolyDestroy(&neg);
+        Put(s, 2, acc);
+        return ERROR_MEMORY;
     }
-    return true;
+    return NO_ERROR;
 }
 
 /**
- * Puts a copy of the polynomial on the top of the stack on the stack.
- * @param sPtr
+ * Replaces the two polynomials on the top of the stack with the quotient
+ * or the remainder of the division of the top one by the other one.
+ * @param s
+ * @param quotient : whether the quotient is put on the stack
  * @return 
  */
-bool Clone(Stack **sPtr) {
-    if (!Empty(*sPtr)) {
-        Poly p = Top(*sPtr);
-        Push(sPtr, PolyClone(&p));
-        return false;
+int Div(Stack *s, bool quotient) {
+    if (Depth(s) < 2) {
+        return ERROR_UNDERFLOW;
+    }
+    if (PolyIsZero(Peek(s, 1))) {
+        return ERROR_DIVISION;
     }
-    return true;
+    Poly quot, rem;
+    PolyDivRem(Peek(s, 0), Peek(s, 1), &quot, &rem);
+    PolyDestroy(quotient ? &rem : &quot);
+    return ReplaceArgs(s, 2, quotient ? quot : rem);
 }
 
 /**
- * Adds the two polynomials on the top of the stack.
- * @param sPtr
+ * Checks if the polynomial on the top of the stack is divisible by
+ * the one below it.
+ * @param s
  * @return 
  */
-bool Add(Stack **sPtr) {
-    if (TwoElementsOnStack(sPtr)) {
-        Poly p = Pop(sPtr);
-        Poly q = Pop(sPtr);
-        Push(sPtr, PolyAdd(&p, &q));
-        return false;
+int IsDivisible(Stack *s) {
+    if (Depth(s) < 2) {
+        return ERROR_UNDERFLOW;
     }
-    return true;
+    if (PolyIsZero(Peek(s, 1))) {
+        return ERROR_DIVISION;
+    }
+    Poly quot;
+    bool divisible = PolyDivExact(Peek(s, 0), Peek(s, 1), &quot);
+    PolyDestroy(&quot);
+    return PrintNumber(divisible);
 }
 
 /**
- * Multiplies the two polynomials on the top of the stack.
- * @param sPtr
+ * Replaces the two polynomials on the top of the stack with their
+ * greatest common divisor.
+ * @param s
  * @return 
  */
-bool Mul(Stack **sPtr) {
-    if (TwoElementsOnStack(sPtr)) {
-        Poly p = Pop(sPtr);
-        Poly q = Pop(sPtr);
-        Push(sPtr, PolyMul(&p, &q));
-        return false;
+int Gcd(Stack *s) {
+    if (Depth(s) < 2) {
+        return ERROR_UNDERFLOW;
+    }
+    Poly gcd;
+    if (PolyGcd(Peek(s, 0), Peek(s, 1), &gcd)) {
+        return ERROR_TOO_LARGE;
     }
-    return true;
+    return ReplaceArgs(s, 2, gcd);
 }
 
 /**
  * Negates a polynomial on the top od the stack.
- * @param sPtr
+ * @param s
  * @return 
  */
-bool Neg(Stack **sPtr) {
-    if (!Empty(*sPtr)) {
-        Poly p = Pop(sPtr);
-        Push(sPtr, PolyNeg(&p));
-        PolyDestroy(&p);
-        return false;
+int Neg(Stack *s) {
+    if (!Empty(s)) {
+        return ReplaceArgs(s, 1, PolyNeg(Peek(s, 0)));
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
  * Subtracts the second from top polynomial from the top polynomial.
- * @param sPtr
+ * @param s
  * @return 
  */
-bool Sub(Stack **sPtr) {
-    if (TwoElementsOnStack(sPtr)) {
-        Poly p = Pop(sPtr);
-        Poly q = Pop(sPtr);
-        Push(sPtr, PolySub(&p, &q));
-        PolyDestroy(&p);
-        PolyDestroy(&q);
-        return false;
+int Sub(Stack *s) {
+    if (Depth(s) >= 2) {
+        return ReplaceArgs(s, 2, PolySub(Peek(s, 0), Peek(s, 1)));
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
@@ -823,13 +985,11 @@ bool Sub(Stack **sPtr) {
  * @param s
  * @return 
  */
-bool Deg(Stack *s) {
+int Deg(Stack *s) {
     if (!Empty(s)) {
-        Poly p = Top(s);
-        printf("%d\n", PolyDeg(&p));
-        return false;
+        return PrintNumber(PolyDeg(Peek(s, 0)));
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
@@ -838,122 +998,410 @@ bool Deg(Stack *s) {
  * @param idx
  * @return 
  */
-bool DegBy(Stack *s, poly_exp_t idx) {
+int DegBy(Stack *s, poly_exp_t idx) {
     if (!Empty(s)) {
-        Poly p = Top(s);
-        printf("%d\n", PolyDegBy(&p, idx));
-        return false;
+        return PrintNumber(PolyDegBy(Peek(s, 0), idx));
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
  * Exaluates the value of a polynomial in the given point.
- * @param sPtr
+ * @param s
  * @param x
  * @return 
  */
-bool At(Stack **sPtr, poly_coeff_t x) {
-    if (!Empty(*sPtr)) {
-        Poly p = Pop(sPtr);
-        Push(sPtr, PolyAt(&p, x));
-        PolyDestroy(&p);
-        return false;
+int At(Stack *s, poly_coeff_t x) {
+    if (!Empty(s)) {
+        return ReplaceArgs(s, 1, PolyAt(Peek(s, 0), x));
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
  * Pops a polynomial from the top of the stack.
- * @param sPtr
+ * @param s
  * @return 
  */
-bool PopPoly(Stack **sPtr) {
-    if (!Empty(*sPtr)) {
-        Poly p = Pop(sPtr);
-        PolyDestroy(&p);
-        return false;
+int PopPoly(Stack *s) {
+    if (!Empty(s)) {
+        Drop(s);
+        return NO_ERROR;
     }
-    return true;
+    return ERROR_UNDERFLOW;
 }
 
 /**
  * Performs a PolyCompose function on the polynomials from the stack.
- * @param sPtr
+ * @param s
  * @param count
  * @return 
  */
-bool Compose(Stack **sPtr, unsigned count) {
-    bool wynik = true;
-    Poly p;
-    if (!Empty(*sPtr)) {
-        p = Pop(sPtr);
+int Compose(Stack *s, unsigned count) {
+    if (Empty(s) || Depth(s) - 1 < count) {
+        return ERROR_UNDERFLOW;
     }
-    else {
-        return wynik;
+    Poly *x = calloc(count, sizeof(Poly));
+    if (x == NULL && count > 0) {
+        return ERROR_MEMORY;
     }
-    Poly x[count];
-    unsigned i = 0;
-    while (i < count && !Empty(*sPtr)) {
-        x[i] = Pop(sPtr);
-        i++;
+    for (unsigned i = 0; i < count; i++) {
+        x[i] = *Peek(s, i + 1);
+    }
+    Poly p = PolyCompose(Peek(s, 0), count, x);
+    free(x);
+    return ReplaceArgs(s, (size_t) count + 1, p);
+}
+
+/**
+ * Replaces the polynomials on the top of the stack with their sum or
+ * their product.
+ * @param s
+ * @param op : PolyAddMany or PolyMulMany
+ * @param count : number of the polynomials
+ * @return
+ */
+int ApplyMany(Stack *s, Poly (*op)(unsigned, const Poly[]), unsigned count) {
+    if (Depth(s) < count) {
+        return ERROR_UNDERFLOW;
     }
-    if (i == count) {
-        Push(sPtr, PolyCompose(&p, count, x));
-        wynik = false;
+    Poly *polys = calloc(count, sizeof(Poly));
+    if (polys == NULL && count > 0) {
+        return ERROR_MEMORY;
     }
-    PolyDestroy(&p);
-    for (unsigned j = 0; j < i; j++) {
-        Poly temp = x[j];
-        PolyDestroy(&temp);
+    for (unsigned i = 0; i < count; i++) {
+        polys[i] = *Peek(s, i);
     }
-    return wynik;
+    Poly p = op(count, polys);
+    free(polys);
+    return ReplaceArgs(s, count, p);
 }
 
 /**
- * Recursively prints the argument polynomial.
- * @param p
+ * Replaces the polynomials on the top of the stack with an expression
+ * of them, which isn't evaluated until its value is used.
+ * @param s
+ * @param op : operation with one or two arguments, the top one is first
+ * @param x : point of NODE_AT
+ * @return
+ */
+int LazyApply(Stack *s, NodeOp op, poly_coeff_t x) {
+    bool binary = op != NODE_NEG && op != NODE_AT;
+    if (Depth(s) < (binary ? 2 : 1)) {
+        return ERROR_UNDERFLOW;
+    }
+    Node *a = PopNode(s);
+    Node *b = binary ? PopNode(s) : NULL;
+    /* The stack has room for the result where the arguments were. */
+    bool error = PushNode(s, NodeMake(op, a, b, x));
+    assert(!error);
+    (void) error;
+    return NO_ERROR;
+}
+
+/**
+ * Replaces the polynomials on the top of the stack with their sum or
+ * their product, which isn't evaluated until its value is used.
+ * The operations form a balanced tree, so that they are shallow when they
+ * are evaluated one by one, and the independent subtrees are evaluated
+ * in parallel by the worker threads.
+ * @param s
+ * @param op : NODE_ADD or NODE_MUL
+ * @param count : number of the polynomials
+ * @return
+ */
+int LazyApplyMany(Stack *s, NodeOp op, unsigned count) {
+    if (Depth(s) < count) {
+        return ERROR_UNDERFLOW;
+    }
+    if (count == 0) {
+        return ReplaceArgs(s, 0, PolyFromCoeff(op == NODE_MUL));
+    }
+    Node **nodes = calloc(count, sizeof(Node *));
+    if (nodes == NULL) {
+        return ERROR_MEMORY;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        nodes[i] = PopNode(s);
+    }
+    for (unsigned width = count; width > 1; width = (width + 1) / 2) {
+        for (unsigned i = 0; i < width / 2; i++) {
+            nodes[i] = NodeMake(op, nodes[2 * i], nodes[2 * i + 1], 0);
+        }
+        if (width % 2 == 1) {
+            nodes[width / 2] = nodes[width - 1];
+        }
+    }
+    /* The stack has room for the result where the arguments were. */
+    bool error = PushNode(s, nodes[0]);
+    assert(!error);
+    (void) error;
+    free(nodes);
+    return NO_ERROR;
+}
+
+/**
+ * Replaces the three polynomials on the top of the stack with the sum of
+ * the third one and the product of the others, which isn't evaluated
+ * until its value is used.
+ * @param s
+ * @return
+ */
+int LazyMulAdd(Stack *s) {
+    if (Depth(s) < 3) {
+        return ERROR_UNDERFLOW;
+    }
+    Node *a = PopNode(s);
+    Node *b = PopNode(s);
+    Node *acc = PopNode(s);
+    bool error = PushNode(s, NodeMake(NODE_ADD, acc,
+                                      NodeMake(NODE_MUL, a, b, 0), 0));
+    assert(!error);
+    (void) error;
+    return NO_ERROR;
+}
+
+/**
+ * Puts the polynomial on the top of the stack on the stack again, sharing
+ * its expression.
+ * @param s
+ * @return
+ */
+int LazyClone(Stack *s) {
+    if (Empty(s)) {
+        return ERROR_UNDERFLOW;
+    }
+    Node *n = PopNode(s);
+    NodeRetain(n);
+    bool error = PushNode(s, n);
+    assert(!error);
+    (void) error;
+    if (PushNode(s, n)) {
+        NodeRelease(n);
+        return ERROR_MEMORY;
+    }
+    return NO_ERROR;
+}
+
+/**
+ * Prints the number of polynomials on the stack.
+ * @param s
+ * @return 
+ */
+int PrintDepth(Stack *s) {
+    return PrintNumber((long) Depth(s));
+}
+
+/**
+ * Saves the polynomial on the top of the stack to a file.
+ * @param s
+ * @param path
+ * @param format
+ * @return 
  */
-void PrintHelper(Poly p) {
-    if (PolyIsCoeff(&p)) {
-        printf("%ld", p.coeff);
+int Save(Stack *s, const char *path, StorageFormat format) {
+    if (Empty(s)) {
+        return ERROR_UNDERFLOW;
+    }
+    bool error;
+    if (format == IMAGE_FORMAT) {
+        error = ImageSave(path, Peek(s, 0));
     }
     else {
-        for (unsigned i = 0; i < p.size; ++i) {
-            printf("%c", POLY_OPENING_SEPARATOR);
-            PrintHelper(p.arr[i].p);
-            printf("%c", POLY_COEFF_EXP_SEPARATOR);
-            printf("%d",p.arr[i].exp);
-            printf("%c", POLY_CLOSING_SEPARATOR);
-            
-            if (i < p.size - 1) {
-                printf("+");
-            }
+        error = PackSave(path, Peek(s, 0), format == PACKED_ZLIB_FORMAT);
+    }
+    return error ? ERROR_SAVE : NO_ERROR;
+}
+
+/**
+ * Saves the product of the two polynomials on the top of the stack to
+ * a file and removes them. The product isn't built, so it is always saved
+ * as a packed file, compressed if the storage format is packed-zlib.
+ * @param s
+ * @param path
+ * @param format : storage format
+ * @return
+ */
+int MulSave(Stack *s, const char *path, StorageFormat format) {
+    if (Depth(s) < 2) {
+        return ERROR_UNDERFLOW;
+    }
+    if (PackSaveProduct(path, Peek(s, 0), Peek(s, 1),
+                        format == PACKED_ZLIB_FORMAT)) {
+        return ERROR_SAVE;
+    }
+    Drop(s);
+    Drop(s);
+    return NO_ERROR;
+}
+
+/**
+ * Puts the polynomial of a file on the stack. A polynomial of an image file
+ * isn't copied, the one of a packed file is read to memory.
+ * @param s
+ * @param path
+ * @return 
+ */
+int Load(Stack *s, const char *path) {
+    Poly p;
+    if (PackIsPacked(path)) {
+        if (PackLoad(path, &p)) {
+            return ERROR_FILE;
+        }
+        if (Push(s, p)) {
+            PolyDestroy(&p);
+            return ERROR_MEMORY;
         }
+        return NO_ERROR;
     }
+    Image *image = ImageLoad(path, &p);
+    if (image == NULL) {
+        return ERROR_LOAD;
+    }
+    int error = PushImage(s, p, image) ? ERROR_MEMORY : NO_ERROR;
+    ImageRelease(image);
+    return error;
 }
 
 /**
- * Prints the polynomial on the top of the stack.
+ * Writes the polynomials changed since the previous checkpoint
+ * to a checkpoint file.
  * @param s
+ * @param cp
+ * @param path
  * @return 
  */
-bool Print(Stack *s) {
+int Checkpoint(Stack *s, CheckpointFile *cp, const char *path) {
+    return CheckpointWrite(cp, s, path) ? ERROR_CHECKPOINT : NO_ERROR;
+}
+
+/**
+ * Moves the polynomial from the top of the stack to a register.
+ * A polynomial shared by an image isn't copied.
+ * @param s
+ * @param r
+ * @param name
+ * @return 
+ */
+int Store(Stack *s, Registers *r, const char *name) {
     if (Empty(s)) {
-        return true;
+        return ERROR_UNDERFLOW;
     }
-    PrintHelper(Top(s));
-    printf("\n");
-    return false;
+    Image *image = PeekImage(s, 0);
+    if (image != NULL) {
+        RegisterStore(r, name, *Peek(s, 0), image);
+        Drop(s);
+        return NO_ERROR;
+    }
+    Poly p;
+    if (Pop(s, &p)) {
+        return ERROR_MEMORY;
+    }
+    image = ImageFromPoly(p);
+    RegisterStore(r, name, image->poly, image);
+    ImageRelease(image);
+    return NO_ERROR;
+}
+
+/**
+ * Puts the polynomial of a register on the stack without copying it.
+ * @param s
+ * @param r
+ * @param name
+ * @return 
+ */
+int Recall(Stack *s, Registers *r, const char *name) {
+    Poly p;
+    Image *image;
+    if (RegisterGet(r, name, &p, &image)) {
+        return ERROR_REGISTER;
+    }
+    int error = PushImage(s, p, image) ? ERROR_MEMORY : NO_ERROR;
+    ImageRelease(image);
+    return error;
 }
 
 /**
- * Checks the contents of the line.
+ * Deletes a register.
+ * @param r
+ * @param name
  * @return 
  */
+int DropRegister(Registers *r, const char *name) {
+    return RegisterDrop(r, name) ? ERROR_REGISTER : NO_ERROR;
+}
+
+/**
+ * Prints the polynomial on the top of the stack.
+ * @param s
+ * @return 
+ */
+int Print(Stack *s) {
+    if (Empty(s)) {
+        return ERROR_UNDERFLOW;
+    }
+    return PrintResult(Peek(s, 0));
+}
+
+/**
+ * Prints the product of the two polynomials on the top of the stack and
+ * removes them. The monomials of the product are printed as soon as they
+ * are computed, without building the product, unless the printed results
+ * are collected or sent to the printing stage.
+ * @param s
+ * @return
+ */
+int MulPrint(Stack *s) {
+    if (Depth(s) < 2) {
+        return ERROR_UNDERFLOW;
+    }
+    const Poly *p = Peek(s, 0), *q = Peek(s, 1);
+    if (printedResults != NULL || nextStage != NULL) {
+        Poly r = PolyMul(p, q);
+        int error = PrintResult(&r);
+        PolyDestroy(&r);
+        if (error == NO_ERROR) {
+            Drop(s);
+            Drop(s);
+        }
+        return error;
+    }
+    PolyProductIter it;
+    Mono first, m;
+    PolyProductBegin(&it, p, q);
+    if (!PolyProductNext(&it, &first)) {
+        OutputLong(0);
+    }
+    else if (!PolyProductNext(&it, &m)) {
+        /* A product with one monomial of the exponent 0 may be
+         * a constant. */
+        if (first.exp == 0 && PolyIsCoeff(&first.p)) {
+            OutputPoly(&first.p);
+        }
+        else {
+            OutputMono(&first);
+        }
+        PolyDestroy(&first.p);
+    }
+    else {
+        OutputMono(&first);
+        PolyDestroy(&first.p);
+        do {
+            OutputPutc(POLY_MONO_SEPARATOR);
+            OutputMono(&m);
+            PolyDestroy(&m.p);
+        } while (PolyProductNext(&it, &m));
+    }
+    PolyProductEnd(&it);
+    OutputEndLine();
+    Drop(s);
+    Drop(s);
+    return NO_ERROR;
+}
+
 int CheckLinePolyOrCommand() {
     int result;
-    int c = getchar();
+    int c = InputGetc();
     
     if (c >= 'a' && c <= 'z' || c >= 'A' && c <= 'Z') {
         result = VAL_IF_COMMAND;
@@ -964,75 +1412,488 @@ int CheckLinePolyOrCommand() {
     else {
         result = VAL_IF_POLY;
     }
-    ungetc(c, stdin);
+    InputUngetc(c);
     return result;
 }
 
+void ForwardToNewLine() {
+    InputSkipLine();
+}
+
+/**
+ * Parses a size given as a command line option.
+ * @param str
+ * @param size
+ * @return 
+ */
+bool ParseSizeOption(const char *str, size_t *size) {
+    char *end;
+    if (str == NULL || !IsDigit(*str)) {
+        return true;
+    }
+    errno = 0;
+    unsigned long long value = strtoull(str, &end, 10);
+    if (errno != 0 || *end != '\0' || value > SIZE_MAX) {
+        return true;
+    }
+    *size = value;
+    return false;
+}
+
 /**
- * Moves buffer to a new line.
+ * Parses the format of the files written by the SAVE command.
+ * @param str
+ * @param format
  * @return 
  */
-int ForwardToNewLine() {
-    int c = getchar();
-    while (c != EOF && c != '\n') {
-        c = getchar();
+bool ParseStorageFormat(const char *str, StorageFormat *format) {
+    if (strcmp(str, "image") == 0) {
+        *format = IMAGE_FORMAT;
+    }
+    else if (strcmp(str, "packed") == 0) {
+        *format = PACKED_FORMAT;
     }
-    ungetc(c, stdin);
+    else if (strcmp(str, "packed-zlib") == 0 && PackCanCompress()) {
+        *format = PACKED_ZLIB_FORMAT;
+    }
+    else {
+        return true;
+    }
+    return false;
 }
 
 /**
- * Executes the logic of the program.
+ * Parses the command line options.
+ * @param argc
+ * @param argv
+ * @param opts
  * @return 
  */
-int main() {
+bool ParseOptions(int argc, char *argv[], Options *opts) {
+    opts->memLimit = NO_MEMORY_LIMIT;
+    opts->opLimit = NO_MEMORY_LIMIT;
+    opts->spillFile = NULL;
+    opts->spillDepth = 0;
+    opts->restoreFile = NULL;
+    opts->storageFormat = IMAGE_FORMAT;
+    opts->chainDir = NULL;
+    opts->serverSocket = NULL;
+    opts->serverDir = NULL;
+    opts->workers = DEFAULT_WORKERS;
+    opts->compileFile = NULL;
+    opts->execFile = NULL;
+    opts->lazy = false;
+    opts->pipeline = false;
+    opts->forcePipeline = false;
+    opts->parallel = 0;
+    opts->mulProcesses = 1;
+    opts->mulMinWork = FORK_MIN_WORK;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc) {
+            if (ParseSizeOption(argv[++i], &opts->memLimit)) {
+                return true;
+            }
+        }
+        else if (strcmp(argv[i], "--op-limit") == 0 && i + 1 < argc) {
+            if (ParseSizeOption(argv[++i], &opts->opLimit)) {
+                return true;
+            }
+        }
+        else if (strcmp(argv[i], "--spill-file") == 0 && i + 1 < argc) {
+            opts->spillFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--spill-depth") == 0 && i + 1 < argc) {
+            if (ParseSizeOption(argv[++i], &opts->spillDepth)) {
+                return true;
+            }
+        }
+        else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            opts->restoreFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--storage-format") == 0 && i + 1 < argc) {
+            if (ParseStorageFormat(argv[++i], &opts->storageFormat)) {
+                return true;
+            }
+        }
+        else if (strcmp(argv[i], "--chain") == 0 && i + 1 < argc) {
+            opts->chainDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            opts->serverSocket = argv[++i];
+        }
+        else if (strcmp(argv[i], "--server-dir") == 0 && i + 1 < argc) {
+            opts->serverDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            if (ParseSizeOption(argv[++i], &opts->workers) ||
+                opts->workers == 0) {
+                return true;
+            }
+        }
+        else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) {
+            opts->compileFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--exec") == 0 && i + 1 < argc) {
+            opts->execFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--lazy") == 0) {
+            opts->lazy = true;
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0) {
+            opts->pipeline = true;
+        }
+        else if (strcmp(argv[i], "--force-pipeline") == 0) {
+            opts->pipeline = true;
+            opts->forcePipeline = true;
+        }
+        else if (strcmp(argv[i], "--parallel") == 0 && i + 1 < argc) {
+            if (ParseSizeOption(argv[++i], &opts->parallel) ||
+                opts->parallel == 0) {
+                return true;
+            }
+            /* The nodes of the lazy commands are evaluated in parallel. */
+            opts->lazy = true;
+        }
+        else if (strcmp(argv[i], "--mul-processes") == 0 && i + 1 < argc) {
+            if (ParseSizeOption(argv[++i], &opts->mulProcesses) ||
+                opts->mulProcesses == 0) {
+                return true;
+            }
+        }
+        else if (strcmp(argv[i], "--mul-min-work") == 0 && i + 1 < argc) {
+            if (ParseSizeOption(argv[++i], &opts->mulMinWork)) {
+                return true;
+            }
+        }
+        else {
+            return true;
+        }
+    }
+    int modes = (opts->chainDir != NULL) + (opts->serverSocket != NULL) +
+                (opts->compileFile != NULL) + (opts->execFile != NULL);
+    /* The sessions of the server start with empty stacks and the compiled
+     * lines aren't executed. Only the standard input is pipelined.
+     * The sessions of the server already run in parallel.
+     * The products are forked only by a single thread, since the other
+     * threads of the server, the pipeline and the lazy workers wouldn't be
+     * copied to the processes together with their locks. */
+    return modes > 1 || (opts->serverSocket != NULL ||
+                         opts->compileFile != NULL) &&
+                        opts->restoreFile != NULL ||
+           opts->pipeline && modes > (opts->execFile != NULL) ||
+           opts->parallel > 0 && opts->serverSocket != NULL ||
+           opts->serverDir != NULL && opts->serverSocket == NULL ||
+           opts->mulProcesses > 1 && (opts->serverSocket != NULL ||
+                                      opts->pipeline || opts->parallel > 0);
+}
+
+long NumericParam(const CommandAndParam *cap) {
+    switch (cap->id) {
+        case DEG_BY_ID: return cap->degByParam;
+        case AT_ID: return cap->atParam;
+        case COMPOSE_ID: case ADD_N_ID: case MUL_N_ID:
+            return cap->countParam;
+        default: return 0;
+    }
+}
+
+bool HasTextParam(int id) {
+    return id == SAVE_ID || id == LOAD_ID || id == CHECKPOINT_ID ||
+           id == STORE_ID || id == RECALL_ID || id == DROP_ID ||
+           id == MUL_SAVE_ID;
+}
+
+const char *TextParam(const CommandAndParam *cap) {
+    switch (cap->id) {
+        case SAVE_ID: case LOAD_ID: case CHECKPOINT_ID: case MUL_SAVE_ID:
+            return cap->fileParam;
+        case STORE_ID: case RECALL_ID: case DROP_ID:
+            return cap->nameParam;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Checks if the result of a command could take more bytes than a single
+ * command is allowed to allocate. The size of the result is bounded
+ * before anything is computed, so a mistaken product of two large
+ * polynomials fails instead of exhausting the memory.
+ * @param s
+ * @param id : id of the command
+ * @param param : numeric parameter
+ * @param limit : maximal number of bytes of the result
+ * @return ERROR_TOO_LARGE if the result could exceed the limit, NO_ERROR
+ * otherwise, also if the command fails for another reason
+ */
+int CheckOpLimit(Stack *s, int id, long param, size_t limit) {
+    size_t terms, count = (size_t) param;
+    if (limit == NO_MEMORY_LIMIT) {
+        return NO_ERROR;
+    }
+    if (id == MUL_ID && Depth(s) >= 2 || id == MUL_ADD_ID && Depth(s) >= 3) {
+        terms = PolyMulTermsBound(Peek(s, 0), Peek(s, 1));
+        if (id == MUL_ADD_ID) {
+            size_t acc = PolyMemSize(Peek(s, 2)) / sizeof(Mono);
+            terms = terms > SIZE_MAX - acc ? SIZE_MAX : terms + acc;
+        }
+    }
+    else if (id == MUL_N_ID && Depth(s) >= count ||
+             id == COMPOSE_ID && Depth(s) > count) {
+        size_t first = id == COMPOSE_ID ? 1 : 0;
+        Poly *polys = calloc(count + 1, sizeof(Poly));
+        if (polys == NULL) {
+            return NO_ERROR;
+        }
+        for (size_t i = 0; i < count; i++) {
+            polys[i] = *Peek(s, i + first);
+        }
+        terms = id == MUL_N_ID ?
+                PolyMulManyTermsBound((unsigned) count, polys) :
+                PolyComposeTermsBound(Peek(s, 0), (unsigned) count, polys);
+        free(polys);
+    }
+    else {
+        return NO_ERROR;
+    }
+    return terms > limit / sizeof(Mono) ? ERROR_TOO_LARGE : NO_ERROR;
+}
+
+void StackEffect(int op, long param, long *pops, long *pushes) {
+    switch (op) {
+        case ZERO_ID: case LOAD_ID: case RECALL_ID: case PUSH_LITERAL_OP:
+            *pops = 0; *pushes = 1; break;
+        case CLONE_ID: *pops = 1; *pushes = 2; break;
+        case ADD_ID: case MUL_ID: case SUB_ID: case DIV_ID: case REM_ID:
+        case GCD_ID:
+            *pops = 2; *pushes = 1; break;
+        case MUL_ADD_ID: *pops = 3; *pushes = 1; break;
+        case IS_EQ_ID: case IS_DIVISIBLE_ID: *pops = 2; *pushes = 2; break;
+        case POP_ID: case STORE_ID: *pops = 1; *pushes = 0; break;
+        case MUL_PRINT_ID: case MUL_SAVE_ID: *pops = 2; *pushes = 0; break;
+        case COMPOSE_ID: *pops = param + 1; *pushes = 1; break;
+        case ADD_N_ID: case MUL_N_ID: *pops = param; *pushes = 1; break;
+        case DEPTH_ID: case CHECKPOINT_ID: case DROP_ID:
+            *pops = 0; *pushes = 0; break;
+        default: *pops = 1; *pushes = 1; break;
+    }
+}
+
+int ExecuteCommand(Calculator *calc, int id, long param, const char *text,
+                   int lineCount) {
+    Stack *stack = &calc->stack;
+    long pops, pushes;
+    StackEffect(id, param, &pops, &pushes);
+    /* The arguments are loaded first, so the commands can't fail on them. */
+    size_t args = pops < 0 ? 0 : (size_t) pops;
+    if (args > Depth(stack)) {
+        args = Depth(stack);
+    }
+    if (calc->opts->lazy) {
+        if (Fetch(stack, args, false)) {
+            return ERROR_MEMORY;
+        }
+        switch (id) {
+            case CLONE_ID: return LazyClone(stack);
+            case ADD_ID: return LazyApply(stack, NODE_ADD, 0);
+            case MUL_ID: return LazyApply(stack, NODE_MUL, 0);
+            case MUL_ADD_ID: return LazyMulAdd(stack);
+            case ADD_N_ID:
+                return LazyApplyMany(stack, NODE_ADD, (unsigned) param);
+            case MUL_N_ID:
+                return LazyApplyMany(stack, NODE_MUL, (unsigned) param);
+            case NEG_ID: return LazyApply(stack, NODE_NEG, 0);
+            case SUB_ID: return LazyApply(stack, NODE_SUB, 0);
+            case AT_ID: return LazyApply(stack, NODE_AT, (poly_coeff_t) param);
+            /* A dropped expression is never evaluated. */
+            case POP_ID: return PopPoly(stack);
+            default: break;
+        }
+    }
+    /* The values of the lazy commands are bounded by --op-limit when they
+     * are evaluated and counted in the memory limit afterwards. */
+    if (Fetch(stack, args, true)) {
+        return TooLarge(stack, args) ? ERROR_TOO_LARGE : ERROR_MEMORY;
+    }
+    int error = CheckOpLimit(stack, id, param, calc->opts->opLimit);
+    if (error != NO_ERROR) {
+        return error;
+    }
+    switch (id) {
+        case ZERO_ID: return PushZero(stack);
+        case IS_COEFF_ID: return IsCoeff(stack);
+        case IS_ZERO_ID: return IsZero(stack);
+        case CLONE_ID: return Clone(stack);
+        case ADD_ID: return Add(stack);
+        case MUL_ID: return Mul(stack);
+        case NEG_ID: return Neg(stack);
+        case SUB_ID: return Sub(stack);
+        case IS_EQ_ID: return IsEq(stack);
+        case DEG_ID: return Deg(stack);
+        case DEG_BY_ID: return DegBy(stack, (poly_exp_t) param);
+        case AT_ID: return At(stack, (poly_coeff_t) param);
+        case PRINT_ID: return Print(stack);
+        case POP_ID: return PopPoly(stack);
+        case COMPOSE_ID: return Compose(stack, (unsigned) param);
+        case DEPTH_ID: return PrintDepth(stack);
+        case SAVE_ID: return Save(stack, text, calc->opts->storageFormat);
+        case LOAD_ID: return Load(stack, text);
+        case CHECKPOINT_ID: return Checkpoint(stack, &calc->checkpoint, text);
+        case STORE_ID: return Store(stack, calc->registers, text);
+        case RECALL_ID: return Recall(stack, calc->registers, text);
+        case DROP_ID: return DropRegister(calc->registers, text);
+        case MUL_ADD_ID: return MulAdd(stack);
+        case ADD_N_ID: return ApplyMany(stack, PolyAddMany, (unsigned) param);
+        case MUL_N_ID: return ApplyMany(stack, PolyMulMany, (unsigned) param);
+        case MUL_PRINT_ID: return MulPrint(stack);
+        case MUL_SAVE_ID:
+            return MulSave(stack, text, calc->opts->storageFormat);
+        case DIV_ID: return Div(stack, true);
+        case REM_ID: return Div(stack, false);
+        case IS_DIVISIBLE_ID: return IsDivisible(stack);
+        case GCD_ID: return Gcd(stack);
+        default:
+            WrongCommandErrorMsg(lineCount);
+            return NO_ERROR;
+    }
+}
+
+char *JoinPath(const char *dir, const char *name, size_t length) {
+    size_t dirLength = strlen(dir);
+    char *path = malloc(dirLength + length + 2);
+    assert(path != NULL);
+    memcpy(path, dir, dirLength);
+    path[dirLength] = '/';
+    memcpy(path + dirLength + 1, name, length);
+    path[dirLength + 1 + length] = '\0';
+    return path;
+}
+
+void RunLines(Calculator *calc, int lineCount) {
+    Stack *stack = &calc->stack;
     CommandAndParam cap;
-    int line = CheckLinePolyOrCommand(), lineCount = 1;
-    int c = 0;
-    bool underflows = false;
-    Stack *sPtr;
-    Init(&sPtr);
-    
+    int line = CheckLinePolyOrCommand();
+    int c = 0, error;
     while (c != EOF && line != VAL_IF_EOF) {
+        struct timespec start;
+        if (calc->latency != NULL) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+        }
         if (line == VAL_IF_POLY) {
             Poly p;
-            if (!ParsePoly(&p, lineCount)) {
-                Push(&sPtr, p);
+            if (!ParsePoly(&p, lineCount) && Push(stack, p)) {
+                PolyDestroy(&p);
+                MemoryErrorMsg(lineCount);
             }
         }
         else {
             if (!ParseCommand(&cap, lineCount)) {
-                switch (cap.id) {
-                    case ZERO_ID: PushZero(&sPtr); break; 
-                    case IS_COEFF_ID: underflows = IsCoeff(sPtr); break;
-                    case IS_ZERO_ID: underflows = IsZero(sPtr); break;
-                    case CLONE_ID: underflows = Clone(&sPtr); break;
-                    case ADD_ID: underflows = Add(&sPtr); break;
-                    case MUL_ID: underflows = Mul(&sPtr); break;
-                    case NEG_ID: underflows = Neg(&sPtr); break;
-                    case SUB_ID: underflows = Sub(&sPtr); break;
-                    case IS_EQ_ID: underflows = IsEq(&sPtr); break;
-                    case DEG_ID: underflows = Deg(sPtr); break;
-                    case DEG_BY_ID:
-                         underflows = DegBy(sPtr, cap.degByParam); break;
-                    case AT_ID: underflows = At(&sPtr, cap.atParam); break;
-                    case PRINT_ID: underflows = Print(sPtr); break;
-                    case POP_ID: underflows = PopPoly(&sPtr); break;
-                    case COMPOSE_ID:
-                         underflows = Compose(&sPtr, cap.composeParam); break;
-                    default: WrongCommandErrorMsg(lineCount); break;
-                }
-                if (underflows) {
-                    UnderflowErrorMsg(lineCount);
-                }
+                error = calc->confined ?
+                        ExecuteConfined(calc, cap.id, NumericParam(&cap),
+                                        TextParam(&cap), lineCount) :
+                        ExecuteCommand(calc, cap.id, NumericParam(&cap),
+                                       TextParam(&cap), lineCount);
+                CommandErrorMsg(error, lineCount);
             }
         }
         ForwardToNewLine();
-        c = getchar();
+        if (calc->latency != NULL) {
+            AddLatency(calc->latency, &start);
+        }
+        c = InputGetc();
         if (c != EOF) {
             line = CheckLinePolyOrCommand();
             lineCount++;
         }
     }
-    Clear(&sPtr);
-    return 0;
+}
+
+/**
+ * Executes the logic of the program.
+ * @param argc
+ * @param argv
+ * @return 
+ */
+int main(int argc, char *argv[]) {
+    Options opts;
+    if (ParseOptions(argc, argv, &opts)) {
+        UsageErrorMsg();
+        return 1;
+    }
+    if (opts.compileFile != NULL) {
+        return CompileProgram(opts.compileFile);
+    }
+    ForkMulSetProcesses(opts.mulProcesses);
+    ForkMulSetMinWork(opts.mulMinWork);
+    NodeSetMaxTerms(opts.opLimit == NO_MEMORY_LIMIT ? SIZE_MAX :
+                    opts.opLimit / sizeof(Mono));
+    Program prog;
+    ProgramInit(&prog);
+    if (opts.execFile != NULL && LoadProgram(&prog, opts.execFile)) {
+        fprintf(stderr, "Cannot read the program %s\n", opts.execFile);
+        return 1;
+    }
+    Registers registers;
+    RegistersInit(&registers);
+    Calculator calc = {.registers = &registers, .opts = &opts,
+                       .latency = NULL};
+    if (opts.serverSocket != NULL) {
+        int result = 0;
+        if (ServerRun(opts.serverSocket, opts.workers, ServeSession, &calc)) {
+            fprintf(stderr, "Cannot start the server at %s\n",
+                    opts.serverSocket);
+            result = 1;
+        }
+        RegistersClear(&registers);
+        return result;
+    }
+    Init(&calc.stack, opts.memLimit);
+    if (opts.spillFile != NULL &&
+        SetSpill(&calc.stack, opts.spillFile, opts.spillDepth)) {
+        fprintf(stderr, "Cannot create the spill file %s\n", opts.spillFile);
+        RegistersClear(&registers);
+        ProgramFree(&prog);
+        return 1;
+    }
+    CheckpointInit(&calc.checkpoint);
+    if (opts.restoreFile != NULL &&
+        CheckpointRestore(&calc.checkpoint, &calc.stack, opts.restoreFile)) {
+        fprintf(stderr, "Cannot restore the checkpoint %s\n",
+                opts.restoreFile);
+        Clear(&calc.stack);
+        RegistersClear(&registers);
+        ProgramFree(&prog);
+        return 1;
+    }
+    if (opts.parallel > 0 && NodeStartWorkers(opts.parallel)) {
+        fprintf(stderr, "Cannot start the threads evaluating commands\n");
+        Clear(&calc.stack);
+        CheckpointFree(&calc.checkpoint);
+        RegistersClear(&registers);
+        ProgramFree(&prog);
+        return 1;
+    }
+    OutputOpen(STDOUT_FILENO);
+    int result = 0;
+    if (opts.chainDir != NULL) {
+        result = RunChain(opts.chainDir, &calc);
+    }
+    else {
+        if (!opts.pipeline || RunPipelined(&calc, opts.forcePipeline)) {
+            InputOpen(STDIN_FILENO);
+            RunLines(&calc, 1);
+            InputClose();
+        }
+        /* The input gives the stack on which the program is run. */
+        if (opts.execFile != NULL && RunProgram(&calc, &prog)) {
+            result = 1;
+        }
+    }
+    ProgramFree(&prog);
+    NodeStopWorkers();
+    Clear(&calc.stack);
+    CheckpointFree(&calc.checkpoint);
+    RegistersClear(&registers);
+    OutputClose();
+    return result;
 }
@@ -0,0 +1,308 @@
+/** @file
+   Interface of the polynomial calculator
+
+   The calculator executes lines of polynomials and commands on a stack.
+   The modes of the calculator which read the lines elsewhere than from
+   the standard input, or run them in another way, use this interface.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#ifndef __CALC_POLY_H__
+#define __CALC_POLY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "poly.h"
+#include "stack_poly.h"
+#include "checkpoint_poly.h"
+#include "register_poly.h"
+
+struct pipe_writer;
+
+/** number of commands */
+#define NUM_OF_COMMANDS 31
+/** maximal length of a file name given to a command */
+#define MAX_FILE_NAME_LENGTH 4095
+/** maximal length of a name of a register */
+#define MAX_REGISTER_NAME_LENGTH 255
+
+/** Value returned by a command if it succeeded */
+#define NO_ERROR 0
+/** Value returned by a command if there are too few polynomials on the stack */
+#define ERROR_UNDERFLOW 3
+/** Value returned by a command if its result exceeds the memory limit */
+#define ERROR_MEMORY 4
+/** Value returned by a command if a polynomial couldn't be saved */
+#define ERROR_SAVE 5
+/** Value returned by a command if a polynomial couldn't be loaded */
+#define ERROR_LOAD 6
+/** Value returned by a command if the stack couldn't be checkpointed */
+#define ERROR_CHECKPOINT 7
+/** Value returned by a command if there is no register of the given name */
+#define ERROR_REGISTER 8
+/** Value returned by a command if its result could exceed the limit
+ * of a single operation or its arguments are too large for it */
+#define ERROR_TOO_LARGE 9
+/** Value returned by a command if it divides by zero */
+#define ERROR_DIVISION 10
+/** Value returned by a command if a file of a known format isn't correct */
+#define ERROR_FILE 11
+/** Value returned by a command if its file isn't allowed in the session */
+#define ERROR_CONFINED 12
+
+/** operation of a compiled program which pushes a literal polynomial */
+#define PUSH_LITERAL_OP NUM_OF_COMMANDS
+/** kind of a message of the pipelined mode with a printed polynomial */
+#define PRINT_POLY_MESSAGE (NUM_OF_COMMANDS + 1)
+/** kind of a message of the pipelined mode with a printed number */
+#define PRINT_NUMBER_MESSAGE (NUM_OF_COMMANDS + 2)
+/** kind of a message of the pipelined mode with an error message */
+#define ERROR_MESSAGE (NUM_OF_COMMANDS + 3)
+/** kind of a message of the pipelined mode with an error of parsing */
+#define PARSING_ERROR_MESSAGE (NUM_OF_COMMANDS + 4)
+
+/** Value returned by function, which checks the content of a given line */
+#define VAL_IF_POLY 0
+/** Value returned by function, which checks the content of a given line */
+#define VAL_IF_COMMAND 1
+/** Value returned by function, which checks the content of a given line */
+#define VAL_IF_EOF (-1)
+
+/**
+ * Enumerates calculator commands.
+ */
+typedef enum CommandId {
+    ZERO_ID, IS_COEFF_ID, IS_ZERO_ID, CLONE_ID, ADD_ID, MUL_ID, NEG_ID,
+    SUB_ID, IS_EQ_ID, DEG_ID, DEG_BY_ID, AT_ID, PRINT_ID, POP_ID, COMPOSE_ID,
+    DEPTH_ID, SAVE_ID, LOAD_ID, CHECKPOINT_ID, STORE_ID, RECALL_ID, DROP_ID,
+    MUL_ADD_ID, ADD_N_ID, MUL_N_ID, MUL_PRINT_ID, MUL_SAVE_ID, DIV_ID, REM_ID,
+    IS_DIVISIBLE_ID, GCD_ID
+} CommandId;
+
+/**
+ * Structure for commands and possible parameters.
+ */
+typedef struct command_and_params {
+    CommandId id; ///< id of a command
+    poly_exp_t degByParam; ///< parameter of the DEG_BY command
+    poly_coeff_t atParam; ///< parameter of the AT command
+    unsigned countParam; ///< parameter of the COMPOSE, ADD_N and MUL_N
+                         ///< commands
+    char fileParam[MAX_FILE_NAME_LENGTH + 1]; ///< parameter of SAVE, LOAD,
+                                              ///< CHECKPOINT and MUL_SAVE
+    char nameParam[MAX_REGISTER_NAME_LENGTH + 1]; ///< parameter of STORE,
+                                                  ///< RECALL and DROP
+}  CommandAndParam;
+
+/**
+ * Enumerates formats of the files written by the SAVE command.
+ */
+typedef enum StorageFormat {
+    IMAGE_FORMAT, PACKED_FORMAT, PACKED_ZLIB_FORMAT
+} StorageFormat;
+
+/**
+ * Structure for the command line options of the calculator.
+ */
+typedef struct options {
+    size_t memLimit; ///< maximal number of bytes held by the stack
+    size_t opLimit; ///< maximal number of bytes of the result of a command
+    const char *spillFile; ///< file for the cold polynomials or NULL
+    size_t spillDepth; ///< number of polynomials from the top never spilled
+    const char *restoreFile; ///< checkpoint file restored at start or NULL
+    StorageFormat storageFormat; ///< format of the files written by SAVE
+    const char *chainDir; ///< directory of the chained files or NULL
+    const char *serverSocket; ///< socket of the server mode or NULL
+    const char *serverDir; ///< directory of the files of the sessions of
+                           ///< the server or NULL
+    size_t workers; ///< number of worker threads of the server
+    const char *compileFile; ///< program compiled from the input or NULL
+    const char *execFile; ///< program run after the input or NULL
+    bool lazy; ///< whether the arithmetic commands are evaluated lazily
+    bool pipeline; ///< whether the input is parsed, executed and printed
+                   ///< by separate threads
+    bool forcePipeline; ///< whether the input is pipelined also on
+                        ///< a single processor
+    size_t parallel; ///< number of threads evaluating the independent
+                     ///< commands in parallel or 0
+    size_t mulProcesses; ///< number of processes computing a large product
+    size_t mulMinWork; ///< smallest work of a product split between
+                       ///< the processes
+} Options;
+
+/**
+ * Structure for the state of the calculator, one for every session
+ * of the server.
+ */
+typedef struct calculator {
+    Stack stack; ///< stack of polynomials
+    CheckpointFile checkpoint; ///< state of the checkpoint file
+    Registers *registers; ///< registers, shared by the sessions
+    const Options *opts; ///< command line options
+    struct latency *latency; ///< latencies of the lines or NULL
+    bool confined; ///< whether the files of the commands are confined to
+                   ///< the directory of the server
+} Calculator;
+
+/**
+ * Sets whether the error messages of the lines executed by the calling
+ * thread are added to the output instead of stderr.
+ * @param[in] toOutput : whether they are added to the output
+ */
+void SetErrorsToOutput(bool toOutput);
+
+/**
+ * Sets the stack collecting the results printed by the calling thread
+ * instead of the output, as in the chain mode.
+ * @param[in] s : stack or NULL
+ */
+void SetPrintedResults(Stack *s);
+
+/**
+ * Sets the writer to the next stage of the pipelined mode, to which
+ * the results and the error messages of the calling thread are sent
+ * instead of the output.
+ * @param[in] w : writer or NULL
+ */
+void SetNextStage(struct pipe_writer *w);
+
+/**
+ * Sends the messages written to the next stage.
+ */
+void FlushNextStage();
+
+/**
+ * Sends a message to the next stage of the pipelined mode.
+ * Takes ownership of the polynomial @p p.
+ * @param[in] kind : kind of the message
+ * @param[in] line : number of the line
+ * @param[in] param : numeric parameter
+ * @param[in] p : polynomial
+ * @param[in] text : text, which is copied, or NULL
+ */
+void SendMessage(int kind, int line, long param, Poly p, const char *text);
+
+/**
+ * Prints the error message of a line.
+ * @param[in] lineCount : number of the line
+ * @param[in] message : text after the number of the line
+ */
+void ErrorMsg(int lineCount, const char *message);
+
+/**
+ * Prints the error message of a line which couldn't be parsed.
+ * @param[in] lineCount : number of the line
+ * @param[in] columnCount : number of the column of the error
+ */
+void ParsingErrorMsg(int lineCount, int columnCount);
+
+/**
+ * Prints the error message of a line whose result doesn't fit in memory.
+ * @param[in] lineCount : number of the line
+ */
+void MemoryErrorMsg(int lineCount);
+
+/**
+ * Prints the error message of a line which finds too few polynomials
+ * on the stack.
+ * @param[in] lineCount : number of the line
+ */
+void UnderflowErrorMsg(int lineCount);
+
+/**
+ * Prints the error message of a failed command.
+ * @param[in] error : error of the command
+ * @param[in] lineCount : number of the line
+ */
+void CommandErrorMsg(int error, int lineCount);
+
+/**
+ * Checks the contents of the line.
+ * @return VAL_IF_POLY, VAL_IF_COMMAND or VAL_IF_EOF
+ */
+int CheckLinePolyOrCommand();
+
+/**
+ * Parses and build a polynomial from the input.
+ * @param[out] p : polynomial
+ * @param[in] lineCount : number of the line
+ * @return 0 if correct, 1 if incorrect
+ */
+bool ParsePoly(Poly *p, int lineCount);
+
+/**
+ * Parses a command with its parameter from the input in a single pass.
+ * @param[out] cap : command and its parameter
+ * @param[in] lineCount : number of the line
+ * @return 0 if correct, 1 if incorrect
+ */
+bool ParseCommand(CommandAndParam *cap, int lineCount);
+
+/**
+ * Moves buffer to a new line.
+ */
+void ForwardToNewLine();
+
+/**
+ * Returns the numeric parameter of a command.
+ * @param[in] cap : command and its parameter
+ * @return parameter or 0 if the command has none
+ */
+long NumericParam(const CommandAndParam *cap);
+
+/**
+ * Returns the parameter of a command which is a text.
+ * @param[in] cap : command and its parameter
+ * @return parameter or NULL if the command has none
+ */
+const char *TextParam(const CommandAndParam *cap);
+
+/**
+ * Checks if a command has a parameter which is a text.
+ * @param[in] id : id of the command
+ * @return true if it has one, false otherwise
+ */
+bool HasTextParam(int id);
+
+/**
+ * Returns how an instruction of a compiled program changes the stack
+ * when it succeeds.
+ * @param[in] op : operation
+ * @param[in] param : numeric parameter
+ * @param[out] pops : number of polynomials which have to be on the stack
+ * @param[out] pushes : number of polynomials put in their place
+ */
+void StackEffect(int op, long param, long *pops, long *pushes);
+
+/**
+ * Executes a command.
+ * @param[in] calc : calculator
+ * @param[in] id : id of the command
+ * @param[in] param : numeric parameter
+ * @param[in] text : parameter which is a text
+ * @param[in] lineCount : number of the line
+ * @return error of the command
+ */
+int ExecuteCommand(Calculator *calc, int id, long param, const char *text,
+                   int lineCount);
+
+/**
+ * Executes the lines of the input.
+ * @param[in] calc : calculator
+ * @param[in] lineCount : number of the first line
+ */
+void RunLines(Calculator *calc, int lineCount);
+
+/**
+ * Joins a directory and a name of a file.
+ * @param[in] dir : directory
+ * @param[in] name : name of the file
+ * @param[in] length : length of the name
+ * @return path, which has to be freed
+ */
+char *JoinPath(const char *dir, const char *name, size_t length);
+
+#endif /* __CALC_POLY_H__ */
@@ -0,0 +1,168 @@
+/** @file
+   Implementation of the chain mode of the calculator
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <dirent.h>
+#include "chain_poly.h"
+#include "input_poly.h"
+#include "utils.h"
+
+/** first line of the file starting a chain */
+#define CHAIN_START "START"
+/** last line of the file ending a chain */
+#define CHAIN_STOP "STOP"
+/** beginning of the last line of a file, followed by the name of
+ * the next one */
+#define CHAIN_FILE_PREFIX "FILE "
+
+/**
+ * Reads a whole file to memory.
+ * @param path
+ * @param length
+ * @return characters of the file or NULL if it couldn't be read
+ */
+static char *ReadWholeFile(const char *path, size_t *length) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    size_t size = INPUT_BLOCK_SIZE, n;
+    char *text = malloc(size);
+    assert(text != NULL);
+    *length = 0;
+    while ((n = fread(text + *length, 1, size - *length, f)) > 0) {
+        *length += n;
+        if (*length == size) {
+            size *= 2;
+            text = realloc(text, size);
+            assert(text != NULL);
+        }
+    }
+    bool error = ferror(f) != 0;
+    fclose(f);
+    if (error) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+/**
+ * Finds the file of a directory whose first line is CHAIN_START.
+ * Hidden files are skipped. The last such file in the order of the names
+ * is chosen, as chain_poly.sh does.
+ * @param dir
+ * @return path of the file or NULL if there is no such file
+ */
+static char *FindChainStart(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        return NULL;
+    }
+    char *start = NULL, *startName = NULL;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.' ||
+            startName != NULL && strcmp(entry->d_name, startName) <= 0) {
+            continue;
+        }
+        char *path = JoinPath(dir, entry->d_name, strlen(entry->d_name));
+        char line[sizeof(CHAIN_START) + 1] = "";
+        FILE *f = fopen(path, "r");
+        if (f != NULL) {
+            if (fgets(line, sizeof(line), f) == NULL) {
+                line[0] = '\0';
+            }
+            fclose(f);
+        }
+        if (strcmp(line, CHAIN_START "\n") == 0 ||
+            strcmp(line, CHAIN_START) == 0) {
+            free(start);
+            start = path;
+            startName = start + strlen(dir) + 1;
+        }
+        else {
+            free(path);
+        }
+    }
+    closedir(d);
+    return start;
+}
+
+int RunChain(const char *dir, Calculator *calc) {
+    Stack *stack = &calc->stack;
+    char *path = FindChainStart(dir);
+    if (path == NULL) {
+        fprintf(stderr, "Cannot find the chain start in %s\n", dir);
+        return 1;
+    }
+    Stack printed;
+    Init(&printed, calc->opts->memLimit);
+    bool first = true, last = false;
+    int carried = 0, result = 0;
+    while (!last) {
+        size_t length;
+        char *text = ReadWholeFile(path, &length);
+        if (text == NULL) {
+            fprintf(stderr, "Cannot read the chained file %s\n", path);
+            result = 1;
+            break;
+        }
+        size_t end = length > 0 && text[length - 1] == '\n' ? length - 1 :
+                     length;
+        size_t lastLine = end, begin = 0;
+        while (lastLine > 0 && text[lastLine - 1] != '\n') {
+            lastLine--;
+        }
+        if (first) {
+            const char *nl = memchr(text, '\n', lastLine);
+            begin = nl == NULL ? lastLine : (size_t) (nl - text) + 1;
+        }
+        const char *next = text + lastLine;
+        size_t nextLength = end - lastLine;
+        size_t prefixLength = strlen(CHAIN_FILE_PREFIX);
+        char *nextPath = NULL;
+        last = nextLength == strlen(CHAIN_STOP) &&
+               memcmp(next, CHAIN_STOP, nextLength) == 0;
+        if (!last) {
+            if (nextLength <= prefixLength ||
+                memcmp(next, CHAIN_FILE_PREFIX, prefixLength) != 0) {
+                fprintf(stderr, "Wrong last line of the chained file %s\n",
+                        path);
+                free(text);
+                result = 1;
+                break;
+            }
+            nextPath = JoinPath(dir, next + prefixLength,
+                                nextLength - prefixLength);
+        }
+        SetPrintedResults(last ? NULL : &printed);
+        InputOpenMemory(text + begin, lastLine - begin);
+        RunLines(calc, carried + 1);
+        InputClose();
+        free(text);
+        if (!last) {
+            while (!Empty(stack)) {
+                Drop(stack);
+            }
+            Move(stack, &printed);
+            carried = Depth(stack);
+        }
+        free(path);
+        path = nextPath;
+        first = false;
+    }
+    SetPrintedResults(NULL);
+    free(path);
+    Clear(&printed);
+    return result;
+}
@@ -0,0 +1,30 @@
+/** @file
+   Interface of the chain mode of the calculator
+
+   The chain mode executes the files of a directory one after another,
+   like chain_poly.sh, but in a single process. The chain starts with
+   the file whose first line is START. The last line of every file is
+   either STOP or FILE followed by the name of the next file, the lines
+   between are executed. The results printed by a file become the stack
+   of the next one, without being printed and parsed again, and only
+   the results of the last file are printed.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#ifndef __CHAIN_POLY_H__
+#define __CHAIN_POLY_H__
+
+#include "calc_poly.h"
+
+/**
+ * Executes the chain of files of a directory.
+ * @param[in] dir : directory
+ * @param[in] calc : calculator
+ * @return exit code of the program
+ */
+int RunChain(const char *dir, Calculator *calc);
+
+#endif /* __CHAIN_POLY_H__ */
@@ -0,0 +1,296 @@
+/** @file
+   Implementation of the checkpoints of the stack of polynomials
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-29
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include "checkpoint_poly.h"
+#include "serial_poly.h"
+
+/** identifier at the beginning of every segment */
+#define CHECKPOINT_MAGIC "POLYCKP"
+/** suffix of the temporary file used when the whole stack is written */
+#define CHECKPOINT_TEMP_SUFFIX ".tmp"
+/** number of segments after which the whole stack is written again */
+#define CHECKPOINT_MAX_SEGMENTS 64
+/** size of the buffer used to compute the checksums */
+#define CHECKPOINT_CHUNK_SIZE (1 << 16)
+/** polynomial of the CRC-32 checksum in the reversed bit order */
+#define CRC32_POLYNOMIAL 0xEDB88320u
+
+/**
+ * Structure containing the beginning of a segment of a checkpoint file
+ */
+typedef struct checkpoint_header {
+    char magic[8]; ///< CHECKPOINT_MAGIC, zeros while the segment is written
+    uint32_t version; ///< CHECKPOINT_VERSION
+    uint32_t checksum; ///< CRC-32 of the polynomials of the segment
+    uint64_t keep; ///< number of polynomials kept from the previous segments
+    uint64_t count; ///< number of polynomials of the segment
+    uint64_t length; ///< number of bytes of the polynomials of the segment
+} CheckpointHeader;
+
+/**
+ * Computes the table of the CRC-32 checksums of all bytes.
+ * @param table
+ */
+static void Crc32Table(uint32_t table[256]) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? CRC32_POLYNOMIAL ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+}
+
+/**
+ * Updates the CRC-32 checksum with the given bytes.
+ * @param table : table computed by Crc32Table
+ * @param crc : checksum of the previous bytes
+ * @param buf
+ * @param length
+ * @return
+ */
+static uint32_t Crc32(const uint32_t table[256], uint32_t crc,
+                      const unsigned char *buf, size_t length) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * Computes the checksum of a part of a file.
+ * @param f
+ * @param from : position of the part
+ * @param length : number of bytes of the part
+ * @param crc : checksum
+ * @return true if the part couldn't be read, false otherwise
+ */
+static bool Checksum(FILE *f, long from, uint64_t length, uint32_t *crc) {
+    if (fseek(f, from, SEEK_SET) != 0) {
+        return true;
+    }
+    /* The table is computed every time, because the checkpoints of
+     * different threads may be written at once. */
+    uint32_t table[256];
+    Crc32Table(table);
+    unsigned char *buf = malloc(CHECKPOINT_CHUNK_SIZE);
+    assert(buf != NULL);
+    *crc = 0;
+    while (length > 0) {
+        size_t chunk = length < CHECKPOINT_CHUNK_SIZE ? length :
+                       CHECKPOINT_CHUNK_SIZE;
+        if (fread(buf, 1, chunk, f) != chunk) {
+            break;
+        }
+        *crc = Crc32(table, *crc, buf, chunk);
+        length -= chunk;
+    }
+    free(buf);
+    return length > 0;
+}
+
+/**
+ * Writes a segment with the polynomials of the stack lying over the @p keep
+ * bottom ones. The header is written last, so an interrupted segment
+ * is recognized as damaged.
+ * @param f
+ * @param start : position of the segment
+ * @param s
+ * @param keep
+ * @param end : position after the segment
+ * @return true if the writing failed, false otherwise
+ */
+static bool WriteSegment(FILE *f, long start, Stack *s, size_t keep,
+                         long *end) {
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    if (fseek(f, start, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, f) != 1) {
+        return true;
+    }
+    for (size_t i = keep; i < Depth(s); i++) {
+        if (WriteEntry(s, i, f)) {
+            return true;
+        }
+    }
+    if (fflush(f) != 0 || (*end = ftell(f)) < 0) {
+        return true;
+    }
+    long payload = start + (long) sizeof(header);
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.keep = keep;
+    header.count = Depth(s) - keep;
+    header.length = (uint64_t) (*end - payload);
+    if (Checksum(f, payload, header.length, &header.checksum)) {
+        return true;
+    }
+    /* The polynomials have to be durable before the header marks them
+       as valid. */
+    return fsync(fileno(f)) != 0 || fseek(f, start, SEEK_SET) != 0 ||
+           fwrite(&header, sizeof(header), 1, f) != 1 || fflush(f) != 0 ||
+           fsync(fileno(f)) != 0;
+}
+
+/**
+ * Writes the whole stack to a new checkpoint file, which replaces the old
+ * one only when it is complete.
+ * @param cp
+ * @param s
+ * @param path
+ * @return true if the writing failed, false otherwise
+ */
+static bool WriteWhole(CheckpointFile *cp, Stack *s, const char *path) {
+    char *temp = malloc(strlen(path) + sizeof(CHECKPOINT_TEMP_SUFFIX));
+    assert(temp != NULL);
+    strcpy(temp, path);
+    strcat(temp, CHECKPOINT_TEMP_SUFFIX);
+    FILE *f = fopen(temp, "w+b");
+    long end = 0;
+    bool error = f == NULL || WriteSegment(f, 0, s, 0, &end);
+    if (f != NULL && fclose(f) != 0) {
+        error = true;
+    }
+    if (!error && rename(temp, path) != 0) {
+        error = true;
+    }
+    if (error && f != NULL) {
+        remove(temp);
+    }
+    free(temp);
+    if (error) {
+        return true;
+    }
+    free(cp->path);
+    cp->path = strdup(path);
+    assert(cp->path != NULL);
+    cp->end = end;
+    cp->segments = 1;
+    return false;
+}
+
+/**
+ * Appends the polynomials changed since the previous checkpoint to
+ * the checkpoint file. Removes the damaged segments after the last valid one.
+ * @param cp
+ * @param s
+ * @return true if the writing failed, false otherwise
+ */
+static bool WriteChanged(CheckpointFile *cp, Stack *s) {
+    FILE *f = fopen(cp->path, "r+b");
+    if (f == NULL) {
+        return true;
+    }
+    long end = 0;
+    bool error = ftruncate(fileno(f), cp->end) != 0 ||
+                 WriteSegment(f, cp->end, s, Clean(s), &end);
+    if (fclose(f) != 0 || error) {
+        return true;
+    }
+    cp->end = end;
+    cp->segments++;
+    return false;
+}
+
+void CheckpointInit(CheckpointFile *cp) {
+    cp->path = NULL;
+    cp->end = 0;
+    cp->segments = 0;
+}
+
+bool CheckpointWrite(CheckpointFile *cp, Stack *s, const char *path) {
+    bool append = cp->path != NULL && strcmp(cp->path, path) == 0 &&
+                  Clean(s) > 0 && cp->segments < CHECKPOINT_MAX_SEGMENTS;
+    if (append ? WriteChanged(cp, s) : WriteWhole(cp, s, path)) {
+        return true;
+    }
+    MarkClean(s);
+    return false;
+}
+
+/**
+ * Reads the polynomials of a valid segment and puts them on the stack
+ * instead of the polynomials over the kept ones.
+ * @param f : file positioned at the polynomials of the segment
+ * @param s
+ * @param header : header of the segment
+ * @return true if the polynomials couldn't be read or put on the stack,
+ * false otherwise
+ */
+static bool ReadSegment(FILE *f, Stack *s, const CheckpointHeader *header) {
+    while (Depth(s) > header->keep) {
+        Drop(s);
+    }
+    for (uint64_t i = 0; i < header->count; i++) {
+        Poly p;
+        if (PolyRead(f, &p)) {
+            return true;
+        }
+        if (Push(s, p)) {
+            PolyDestroy(&p);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CheckpointRestore(CheckpointFile *cp, Stack *s, const char *path) {
+    assert(Empty(s));
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return true;
+    }
+    long pos = 0;
+    unsigned segments = 0;
+    bool error = false;
+    CheckpointHeader header;
+    while (fseek(f, pos, SEEK_SET) == 0 &&
+           fread(&header, sizeof(header), 1, f) == 1) {
+        long payload = pos + (long) sizeof(header);
+        uint32_t crc;
+        if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != CHECKPOINT_VERSION || header.keep > Depth(s) ||
+            Checksum(f, payload, header.length, &crc) ||
+            crc != header.checksum) {
+            break;
+        }
+        if (fseek(f, payload, SEEK_SET) != 0 || ReadSegment(f, s, &header) ||
+            ftell(f) != payload + (long) header.length) {
+            error = true;
+            break;
+        }
+        pos = payload + (long) header.length;
+        segments++;
+    }
+    fclose(f);
+    if (error || segments == 0) {
+        while (!Empty(s)) {
+            Drop(s);
+        }
+        return true;
+    }
+    free(cp->path);
+    cp->path = strdup(path);
+    assert(cp->path != NULL);
+    cp->end = pos;
+    cp->segments = segments;
+    MarkClean(s);
+    return false;
+}
+
+void CheckpointFree(CheckpointFile *cp) {
+    free(cp->path);
+    CheckpointInit(cp);
+}
@@ -0,0 +1,65 @@
+/** @file
+   Interface of the checkpoints of the stack of polynomials
+
+   A checkpoint file is a sequence of segments. Every segment keeps some
+   polynomials from the bottom of the stack restored from the segments
+   before it and adds the polynomials which were changed since then,
+   so a checkpoint writes only the changed part of the stack.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-29
+*/
+
+#ifndef __CHECKPOINT_POLY_H__
+#define __CHECKPOINT_POLY_H__
+
+#include "stack_poly.h"
+
+/** version of the format of the checkpoint files */
+#define CHECKPOINT_VERSION 1
+
+/**
+ * Structure containing the state of the checkpoint file of the stack
+ */
+typedef struct checkpoint_file {
+    char *path; ///< path of the file written last or NULL
+    long end; ///< end of the last valid segment of the file
+    unsigned segments; ///< number of segments of the file
+} CheckpointFile;
+
+/**
+ * Initializes the state of the checkpoint file.
+ * @param[in] cp : state of the checkpoint file
+ */
+void CheckpointInit(CheckpointFile *cp);
+
+/**
+ * Writes the stack to a checkpoint file. Only the polynomials changed
+ * since the previous checkpoint are appended if it was written to
+ * the same file, otherwise the whole stack is written.
+ * @param[in] cp : state of the checkpoint file
+ * @param[in] s : stack
+ * @param[in] path : path of the file
+ * @return true if the writing failed, false otherwise
+ */
+bool CheckpointWrite(CheckpointFile *cp, Stack *s, const char *path);
+
+/**
+ * Puts the polynomials from a checkpoint file on the empty stack.
+ * A damaged segment at the end of the file, left by an interrupted
+ * checkpoint, and all segments after it are ignored.
+ * @param[in] cp : state of the checkpoint file
+ * @param[in] s : empty stack
+ * @param[in] path : path of the file
+ * @return true if the file couldn't be read, false otherwise
+ */
+bool CheckpointRestore(CheckpointFile *cp, Stack *s, const char *path);
+
+/**
+ * Frees the memory of the state of the checkpoint file.
+ * @param[in] cp : state of the checkpoint file
+ */
+void CheckpointFree(CheckpointFile *cp);
+
+#endif /* __CHECKPOINT_POLY_H__ */
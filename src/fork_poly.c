@@ -0,0 +1,287 @@
+/** @file
+   Implementation of the multiplication of polynomials by forked processes
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "fork_poly.h"
+#include "image_poly.h"
+
+/** number of the processes computing a product */
+static size_t processes = 1;
+
+/** smallest work of a product for which the processes are forked */
+static size_t minWork = FORK_MIN_WORK;
+
+/**
+ * Structure containing the exponents of the monomials of a factor and
+ * the sums of their sizes.
+ */
+typedef struct weights {
+    poly_exp_t *exps; ///< exponents of the monomials
+    double *sums; ///< numbers of the monomials on all levels of the first
+                  ///< monomials, up to and including the given one
+    unsigned count; ///< number of the monomials
+} Weights;
+
+/**
+ * Structure containing a band of a product.
+ */
+typedef struct band {
+    long lo; ///< lowest exponent of the band
+    long hi; ///< highest exponent of the band
+    pid_t pid; ///< process computing the band or 0
+    FILE *f; ///< file of the image of the band or NULL
+    Poly poly; ///< band
+} Band;
+
+void ForkMulSetProcesses(size_t count) {
+    assert(count > 0);
+    processes = count;
+}
+
+void ForkMulSetMinWork(size_t work) {
+    minWork = work;
+}
+
+/**
+ * Collects the exponents and the sizes of the monomials of a polynomial.
+ * @param p : polynomial, which isn't a constant
+ * @return weights
+ */
+static Weights WeightsOf(const Poly *p) {
+    Weights w = {.count = 0};
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        w.count++;
+    }
+    w.exps = calloc(w.count, sizeof(poly_exp_t));
+    w.sums = calloc(w.count, sizeof(double));
+    assert(w.exps != NULL && w.sums != NULL);
+    double sum = 0;
+    unsigned i = 0;
+    for (const Mono *m = p->list; m != NULL; m = m->next, i++) {
+        sum += PolyMemSize(&m->p) / sizeof(Mono) + 1;
+        w.exps[i] = m->exp;
+        w.sums[i] = sum;
+    }
+    return w;
+}
+
+/**
+ * Deletes the weights.
+ * @param w : weights
+ */
+static void WeightsDestroy(Weights *w) {
+    free(w->exps);
+    free(w->sums);
+}
+
+/**
+ * Returns the sum of the sizes of the monomials whose exponents don't
+ * exceed a given one.
+ * @param w : weights
+ * @param exp : exponent
+ * @return sum
+ */
+static double SumUpTo(const Weights *w, long exp) {
+    unsigned lo = 0, hi = w->count;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (w->exps[mid] <= exp) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo == 0 ? 0 : w->sums[lo - 1];
+}
+
+/**
+ * Estimates the work of the monomials of a product up to an exponent
+ * as the sum of the products of the sizes of the monomials of the factors.
+ * @param a : weights of a factor
+ * @param b : weights of the other factor
+ * @param exp : exponent
+ * @return work
+ */
+static double WorkUpTo(const Weights *a, const Weights *b, long exp) {
+    double work = 0, prev = 0;
+    for (unsigned i = 0; i < a->count; i++) {
+        work += (a->sums[i] - prev) * SumUpTo(b, exp - a->exps[i]);
+        prev = a->sums[i];
+    }
+    return work;
+}
+
+/**
+ * Splits the exponents of a product into bands of a similar work.
+ * Bands which would be empty are left empty.
+ * @param a : weights of a factor
+ * @param b : weights of the other factor
+ * @param bands : array of the bands
+ * @param count : number of the bands
+ * @return work of the product
+ */
+static double SplitBands(const Weights *a, const Weights *b, Band bands[],
+                         size_t count) {
+    long first = (long) a->exps[0] + b->exps[0],
+         last = (long) a->exps[a->count - 1] + b->exps[b->count - 1];
+    double total = WorkUpTo(a, b, last);
+    long cut = first - 1;
+    for (size_t k = 0; k < count; k++) {
+        long lo = cut, hi = last;
+        double target = total * (k + 1) / count;
+        /* The band ends at the first exponent reaching its share. */
+        while (k + 1 < count && lo < hi) {
+            long mid = lo + (hi - lo) / 2;
+            if (WorkUpTo(a, b, mid) >= target) {
+                hi = mid;
+            }
+            else {
+                lo = mid + 1;
+            }
+        }
+        bands[k] = (Band) {.lo = cut + 1, .hi = hi, .pid = 0, .f = NULL,
+                           .poly = PolyZero()};
+        cut = hi;
+    }
+    return total;
+}
+
+/**
+ * Starts a process computing a band of a product. The band is left to
+ * the calling process if the process can't be started.
+ * @param band : band
+ * @param index : index of the band
+ * @param p : polynomial
+ * @param q : polynomial
+ */
+static void StartBand(Band *band, size_t index, const Poly *p,
+                      const Poly *q) {
+    band->f = tmpfile();
+    if (band->f == NULL) {
+        return;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        char name[32];
+        snprintf(name, sizeof(name), "band %zu", index);
+        Poly r = PolyMulBand(p, q, (poly_exp_t) band->lo,
+                             (poly_exp_t) band->hi);
+        bool error = ImageWrite(band->f, name, &r) || fflush(band->f) != 0;
+        /* The buffers of the parent mustn't be flushed again. */
+        _exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+    if (pid < 0) {
+        fclose(band->f);
+        band->f = NULL;
+        return;
+    }
+    band->pid = pid;
+}
+
+/**
+ * Waits for the process of a band and copies the band from its image.
+ * @param band : band
+ * @return true if the band couldn't be read, false otherwise
+ */
+static bool FinishBand(Band *band) {
+    int status;
+    while (waitpid(band->pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return true;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        return true;
+    }
+    Poly r;
+    Image *image = ImageMap(fileno(band->f), 0, &r);
+    if (image == NULL) {
+        return true;
+    }
+    band->poly = PolyClone(&r);
+    ImageRelease(image);
+    return false;
+}
+
+/**
+ * Joins the bands of a product, taking their monomials.
+ * @param bands : bands in the order of exponents
+ * @param count : number of the bands
+ * @return product
+ */
+static Poly JoinBands(Band bands[], size_t count) {
+    Poly r = PolyZero();
+    Mono **tail = &r.list;
+    for (size_t k = 0; k < count; k++) {
+        Poly *b = &bands[k].poly;
+        if (PolyIsZero(b)) {
+            continue;
+        }
+        if (PolyIsCoeff(b)) {
+            Mono *m = malloc(sizeof(Mono));
+            assert(m != NULL);
+            *m = (Mono) {.p = *b, .exp = 0, .next = NULL};
+            *tail = m;
+        }
+        else {
+            *tail = b->list;
+        }
+        while (*tail != NULL) {
+            tail = &(*tail)->next;
+        }
+    }
+    Mono *m = r.list;
+    if (m != NULL && m->next == NULL && m->exp == 0 && PolyIsCoeff(&m->p)) {
+        r = m->p;
+        free(m);
+    }
+    return r;
+}
+
+Poly ForkMul(const Poly *p, const Poly *q) {
+    if (processes < 2 || PolyIsCoeff(p) || PolyIsCoeff(q)) {
+        return PolyMul(p, q);
+    }
+    Weights a = WeightsOf(p), b = WeightsOf(q);
+    Band *bands = calloc(processes, sizeof(Band));
+    assert(bands != NULL);
+    double work = SplitBands(a.count < b.count ? &a : &b,
+                             a.count < b.count ? &b : &a, bands, processes);
+    WeightsDestroy(&a);
+    WeightsDestroy(&b);
+    if (work < minWork) {
+        free(bands);
+        return PolyMul(p, q);
+    }
+    for (size_t k = 1; k < processes; k++) {
+        if (bands[k].lo <= bands[k].hi) {
+            StartBand(&bands[k], k, p, q);
+        }
+    }
+    /* The first band is computed while the processes compute theirs. */
+    for (size_t k = 0; k < processes; k++) {
+        if (bands[k].pid == 0 || FinishBand(&bands[k])) {
+            bands[k].poly = PolyMulBand(p, q, (poly_exp_t) bands[k].lo,
+                                        (poly_exp_t) bands[k].hi);
+        }
+        if (bands[k].f != NULL) {
+            fclose(bands[k].f);
+        }
+    }
+    Poly r = JoinBands(bands, processes);
+    free(bands);
+    return r;
+}
@@ -0,0 +1,53 @@
+/** @file
+   Interface of the multiplication of polynomials by forked processes
+
+   A large product is split into bands of the exponents of the main
+   variable with similar numbers of the products of the monomials. Each
+   band but the first is computed by a forked process, which sees
+   the factors as they were at the fork and doesn't share the allocator
+   with the others. A process writes its band as an image to a temporary
+   file, which is mapped by the parent and copied after the first band.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#ifndef __FORK_POLY_H__
+#define __FORK_POLY_H__
+
+#include <stddef.h>
+#include "poly.h"
+
+/** default smallest number of the products of the monomials of the factors,
+ * counted on all levels, for which the processes are forked */
+#define FORK_MIN_WORK 10000000
+
+/**
+ * Sets the number of the processes computing a large product, including
+ * the calling one. The products are computed by the calling process alone
+ * if it is 1, which is the default.
+ * @param[in] count : number of the processes, at least 1
+ */
+void ForkMulSetProcesses(size_t count);
+
+/**
+ * Sets the smallest number of the products of the monomials of the factors,
+ * counted on all levels, for which a product is split between
+ * the processes. Smaller products are computed by the calling process.
+ * It is FORK_MIN_WORK by default.
+ * @param[in] work : smallest work of a split product
+ */
+void ForkMulSetMinWork(size_t work);
+
+/**
+ * Multiplies two polynomials, splitting the product between the processes
+ * if it is large enough. A band whose process fails is computed by
+ * the calling one.
+ * @param[in] p : polynomial
+ * @param[in] q : polynomial
+ * @return `p * q`
+ */
+Poly ForkMul(const Poly *p, const Poly *q);
+
+#endif /* __FORK_POLY_H__ */
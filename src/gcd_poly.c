@@ -0,0 +1,1140 @@
+/** @file
+   Implementation of the greatest common divisor of polynomials
+
+   Modulo a prime the coefficients are kept as residues from 0 to
+   the prime minus 1. PolyAt can't be used for the evaluation, since its
+   powers overflow, so the polynomials are evaluated by Horner's scheme
+   modulo the prime.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gcd_poly.h"
+
+/** largest prime whose square fits in poly_coeff_t */
+#define GCD_FIRST_PRIME 3037000493U
+/** number of primes tried before the gcd is reported as too large */
+#define GCD_MAX_PRIMES 64
+/** multiplier spreading the first evaluation points of the primes */
+#define GCD_POINT_SPREAD 2654435761U
+/** maximal product of the degrees plus 1 in all variables times their sum,
+ * which bounds both the dense arrays of the coefficients and the time of
+ * the interpolation in all the variables */
+#define GCD_MAX_WORK (1L << 24)
+
+/**
+ * Adds numbers modulo a prime.
+ * @param a : residue
+ * @param b : residue
+ * @param mod : prime
+ * @return `a + b` modulo @p mod
+ */
+static inline uint64_t AddMod(uint64_t a, uint64_t b, uint64_t mod) {
+    return a + b >= mod ? a + b - mod : a + b;
+}
+
+/**
+ * Subtracts numbers modulo a prime.
+ * @param a : residue
+ * @param b : residue
+ * @param mod : prime
+ * @return `a - b` modulo @p mod
+ */
+static inline uint64_t SubMod(uint64_t a, uint64_t b, uint64_t mod) {
+    return a >= b ? a - b : a + mod - b;
+}
+
+/**
+ * Multiplies numbers modulo a prime. The product fits in 63 bits.
+ * @param a : residue
+ * @param b : residue
+ * @param mod : prime
+ * @return `a * b` modulo @p mod
+ */
+static inline uint64_t MulMod(uint64_t a, uint64_t b, uint64_t mod) {
+    return a * b % mod;
+}
+
+/**
+ * Computes the inverse modulo a prime by Fermat's little theorem.
+ * @param a : residue, which isn't zero
+ * @param mod : prime
+ * @return inverse of @p a
+ */
+static uint64_t InvMod(uint64_t a, uint64_t mod) {
+    uint64_t r = 1;
+    for (uint64_t e = mod - 2; e > 0; e /= 2) {
+        if (e % 2 == 1) {
+            r = MulMod(r, a, mod);
+        }
+        a = MulMod(a, a, mod);
+    }
+    return r;
+}
+
+/**
+ * Returns the residue of a coefficient modulo a prime.
+ * @param c : coefficient
+ * @param mod : prime
+ * @return residue
+ */
+static inline uint64_t Residue(poly_coeff_t c, uint64_t mod) {
+    poly_coeff_t r = c % (poly_coeff_t) mod;
+    return (uint64_t) (r < 0 ? r + (poly_coeff_t) mod : r);
+}
+
+/**
+ * Computes the gcd of numbers by Euclid's algorithm.
+ * @param a : number
+ * @param b : number
+ * @return gcd
+ */
+static uint64_t IntGcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/**
+ * Returns the absolute value of a coefficient.
+ * @param c : coefficient
+ * @return absolute value
+ */
+static inline uint64_t Abs(poly_coeff_t c) {
+    return c < 0 ? 0 - (uint64_t) c : (uint64_t) c;
+}
+
+/**
+ * Finds the largest prime smaller than a number.
+ * @param n : number
+ * @return prime
+ */
+static uint64_t PrevPrime(uint64_t n) {
+    for (n = n - 1 - n % 2; ; n -= 2) {
+        bool prime = true;
+        for (uint64_t d = 3; d * d <= n && prime; d += 2) {
+            prime = n % d != 0;
+        }
+        if (prime) {
+            return n;
+        }
+    }
+}
+
+/**
+ * Structure containing a polynomial of one variable modulo a prime.
+ */
+typedef struct Uni {
+    uint64_t *c; ///< coefficients from the exponent 0
+    long deg; ///< degree, -1 for zero
+} Uni;
+
+/**
+ * Creates a polynomial of one variable with zero coefficients.
+ * @param deg : degree to make room for
+ * @return polynomial
+ */
+static Uni UniNew(long deg) {
+    Uni u = {.c = calloc(deg + 2, sizeof(uint64_t)), .deg = deg};
+    assert(u.c != NULL);
+    return u;
+}
+
+/**
+ * Copies a polynomial of one variable.
+ * @param u : polynomial
+ * @return copy
+ */
+static Uni UniClone(const Uni *u) {
+    Uni r = UniNew(u->deg);
+    memcpy(r.c, u->c, (u->deg + 1) * sizeof(uint64_t));
+    return r;
+}
+
+/**
+ * Lowers the degree of a polynomial of one variable to its leading
+ * nonzero coefficient.
+ * @param u : polynomial
+ */
+static void UniTrim(Uni *u) {
+    while (u->deg >= 0 && u->c[u->deg] == 0) {
+        u->deg--;
+    }
+}
+
+/**
+ * Evaluates a polynomial of one variable.
+ * @param u : polynomial
+ * @param x : point
+ * @param mod : prime
+ * @return value
+ */
+static uint64_t UniEval(const Uni *u, uint64_t x, uint64_t mod) {
+    uint64_t r = 0;
+    for (long i = u->deg; i >= 0; i--) {
+        r = AddMod(MulMod(r, x, mod), u->c[i], mod);
+    }
+    return r;
+}
+
+/**
+ * Replaces a polynomial of one variable with the remainder of its
+ * division by another one.
+ * @param a : dividend
+ * @param b : divisor, which isn't zero
+ * @param mod : prime
+ */
+static void UniRem(Uni *a, const Uni *b, uint64_t mod) {
+    uint64_t inv = InvMod(b->c[b->deg], mod);
+    while (a->deg >= b->deg) {
+        uint64_t f = MulMod(a->c[a->deg], inv, mod);
+        long shift = a->deg - b->deg;
+        for (long i = 0; i <= b->deg; i++) {
+            a->c[shift + i] = SubMod(a->c[shift + i], MulMod(f, b->c[i], mod),
+                                     mod);
+        }
+        UniTrim(a);
+    }
+}
+
+/**
+ * Computes the monic gcd of polynomials of one variable by Euclid's
+ * algorithm.
+ * @param a : polynomial
+ * @param b : polynomial
+ * @param mod : prime
+ * @return gcd, zero if both polynomials are zero
+ */
+static Uni UniGcd(const Uni *a, const Uni *b, uint64_t mod) {
+    Uni x = UniClone(a), y = UniClone(b);
+    while (y.deg >= 0) {
+        UniRem(&x, &y, mod);
+        Uni t = x;
+        x = y;
+        y = t;
+    }
+    free(y.c);
+    if (x.deg >= 0) {
+        uint64_t inv = InvMod(x.c[x.deg], mod);
+        for (long i = 0; i <= x.deg; i++) {
+            x.c[i] = MulMod(x.c[i], inv, mod);
+        }
+    }
+    return x;
+}
+
+/**
+ * Multiplies a polynomial of one variable by `x - a`.
+ * @param u : polynomial
+ * @param a : residue
+ * @param mod : prime
+ * @return product
+ */
+static Uni UniMulLinear(const Uni *u, uint64_t a, uint64_t mod) {
+    Uni r = UniNew(u->deg + 1);
+    for (long i = 0; i <= u->deg; i++) {
+        r.c[i + 1] = AddMod(r.c[i + 1], u->c[i], mod);
+        r.c[i] = SubMod(r.c[i], MulMod(a, u->c[i], mod), mod);
+    }
+    return r;
+}
+
+/**
+ * Returns the number of variables of a polynomial.
+ * @param p : polynomial
+ * @return number of levels of its monomials
+ */
+static unsigned PolyVars(const Poly *p) {
+    unsigned vars = 0;
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        unsigned v = 1 + PolyVars(&m->p);
+        if (v > vars) {
+            vars = v;
+        }
+    }
+    return vars;
+}
+
+/**
+ * Raises the degrees of the variables to those of a polynomial.
+ * @param p : polynomial
+ * @param degs : degrees of the variables from the main one of @p p
+ */
+static void MaxDegs(const Poly *p, poly_exp_t degs[]) {
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        if (m->exp > degs[0]) {
+            degs[0] = m->exp;
+        }
+        MaxDegs(&m->p, degs + 1);
+    }
+}
+
+/**
+ * Checks if the gcd of polynomials takes at most GCD_MAX_WORK steps.
+ * The dense arrays have the product of the degrees plus 1 coefficients and
+ * the interpolation in each variable is quadratic in its degree.
+ * @param p : polynomial
+ * @param q : polynomial
+ * @param vars : number of variables of the polynomials
+ * @return whether they fit
+ */
+static bool DenseFits(const Poly *p, const Poly *q, unsigned vars) {
+    poly_exp_t *degs = calloc(vars + 1, sizeof(poly_exp_t));
+    assert(degs != NULL);
+    MaxDegs(p, degs);
+    MaxDegs(q, degs);
+    double size = 1, sum = 0;
+    for (unsigned i = 0; i < vars; i++) {
+        size *= degs[i] + 1.0;
+        sum += degs[i] + 1.0;
+    }
+    free(degs);
+    return size * sum <= GCD_MAX_WORK;
+}
+
+/**
+ * Brings a polynomial whose list was built to the normal form.
+ * @param p : polynomial
+ */
+static void Normalize(Poly *p) {
+    if (p->list == NULL) {
+        *p = PolyZero();
+    }
+    else if (p->list->next == NULL && p->list->exp == 0 &&
+             PolyIsCoeff(&p->list->p)) {
+        Mono *m = p->list;
+        *p = m->p;
+        free(m);
+    }
+}
+
+/**
+ * Adds a monomial at the end of a list which is built.
+ * @param link : place for the monomial, moved after it
+ * @param p : coefficient, the monomial is skipped if it is zero
+ * @param exp : exponent larger than the ones of the list
+ */
+static void Append(Mono ***link, Poly p, poly_exp_t exp) {
+    if (PolyIsZero(&p)) {
+        return;
+    }
+    Mono *m = malloc(sizeof(Mono));
+    assert(m != NULL);
+    *m = (Mono) {.p = p, .exp = exp, .next = NULL};
+    **link = m;
+    *link = &m->next;
+}
+
+/**
+ * Returns the monomials of a polynomial. A constant is given as a single
+ * monomial with the exponent 0, and zero as no monomials.
+ * @param p : polynomial
+ * @param single : room for the monomial of a constant
+ * @return list of monomials
+ */
+static const Mono *Monos(const Poly *p, Mono *single) {
+    if (!PolyIsCoeff(p)) {
+        return p->list;
+    }
+    if (PolyIsZero(p)) {
+        return NULL;
+    }
+    *single = (Mono) {.p = *p, .exp = 0, .next = NULL};
+    return single;
+}
+
+/**
+ * Structure describing how the coefficients of two polynomials are
+ * combined, either linearly modulo a prime or by the Chinese remainder
+ * theorem.
+ */
+typedef struct Combiner {
+    bool crt; ///< whether the Chinese remainder theorem is used
+    uint64_t mod; ///< prime
+    uint64_t s; ///< factor of the first polynomial of a linear combination
+    uint64_t t; ///< factor of the second polynomial of a linear combination
+    uint64_t m; ///< modulus of the first polynomial of the theorem
+    uint64_t inv; ///< inverse of @p m modulo the prime
+} Combiner;
+
+/**
+ * Combines two coefficients.
+ * @param op : way of combining
+ * @param x : coefficient of the first polynomial, from -m/2 to m/2
+ *            for the Chinese remainder theorem
+ * @param y : coefficient of the second polynomial
+ * @return combined coefficient, a residue for a linear combination and
+ *         a number from -m*mod/2 to m*mod/2 for the theorem
+ */
+static poly_coeff_t Combine(const Combiner *op, poly_coeff_t x,
+                            poly_coeff_t y) {
+    uint64_t mod = op->mod;
+    if (!op->crt) {
+        return (poly_coeff_t) AddMod(MulMod(op->s, Residue(x, mod), mod),
+                                     MulMod(op->t, Residue(y, mod), mod),
+                                     mod);
+    }
+    uint64_t h = x < 0 ? (uint64_t) (x + (poly_coeff_t) op->m) : (uint64_t) x;
+    uint64_t t = MulMod(SubMod(Residue(y, mod), h % mod, mod), op->inv, mod);
+    uint64_t u = h + op->m * t, all = op->m * mod;
+    return u > all / 2 ? (poly_coeff_t) u - (poly_coeff_t) all :
+                         (poly_coeff_t) u;
+}
+
+/**
+ * Combines the coefficients of the same monomials of two polynomials.
+ * The missing monomials have zero coefficients.
+ * @param p : polynomial
+ * @param q : polynomial
+ * @param op : way of combining
+ * @return polynomial of the combined coefficients
+ */
+static Poly Merge(const Poly *p, const Poly *q, const Combiner *op) {
+    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+        return PolyFromCoeff(Combine(op, p->coeff, q->coeff));
+    }
+    Mono singleP, singleQ;
+    const Mono *mp = Monos(p, &singleP), *mq = Monos(q, &singleQ);
+    Poly zero = PolyZero(), r = PolyZero();
+    Mono **link = &r.list;
+    while (mp != NULL || mq != NULL) {
+        if (mq == NULL || mp != NULL && mp->exp < mq->exp) {
+            Append(&link, Merge(&mp->p, &zero, op), mp->exp);
+            mp = mp->next;
+        }
+        else if (mp == NULL || mq->exp < mp->exp) {
+            Append(&link, Merge(&zero, &mq->p, op), mq->exp);
+            mq = mq->next;
+        }
+        else {
+            Append(&link, Merge(&mp->p, &mq->p, op), mp->exp);
+            mp = mp->next;
+            mq = mq->next;
+        }
+    }
+    Normalize(&r);
+    return r;
+}
+
+/**
+ * Computes a linear combination of polynomials modulo a prime.
+ * @param p : polynomial
+ * @param s : factor of @p p
+ * @param q : polynomial
+ * @param t : factor of @p q
+ * @param mod : prime
+ * @return `s * p + t * q` modulo @p mod
+ */
+static Poly ModLinear(const Poly *p, uint64_t s, const Poly *q, uint64_t t,
+                      uint64_t mod) {
+    Combiner op = {.crt = false, .mod = mod, .s = s, .t = t};
+    return Merge(p, q, &op);
+}
+
+/**
+ * Multiplies a polynomial by a number modulo a prime.
+ * @param p : polynomial
+ * @param s : factor
+ * @param mod : prime
+ * @return `s * p` modulo @p mod
+ */
+static Poly ModScale(const Poly *p, uint64_t s, uint64_t mod) {
+    Poly zero = PolyZero();
+    return ModLinear(p, s, &zero, 0, mod);
+}
+
+/**
+ * Adds a multiple of a polynomial to a polynomial modulo a prime.
+ * @param acc : polynomial, which is replaced with the sum
+ * @param q : polynomial
+ * @param t : factor of @p q
+ * @param mod : prime
+ */
+static void AddScaled(Poly *acc, const Poly *q, uint64_t t, uint64_t mod) {
+    Poly r = ModLinear(acc, 1, q, t, mod);
+    PolyDestroy(acc);
+    *acc = r;
+}
+
+/**
+ * Returns the last monomial of a polynomial, which isn't a constant.
+ * @param p : polynomial
+ * @return monomial with the largest exponent
+ */
+static const Mono *LastMono(const Poly *p) {
+    const Mono *m = p->list;
+    while (m->next != NULL) {
+        m = m->next;
+    }
+    return m;
+}
+
+/**
+ * Returns the coefficient of the leading monomial of a polynomial in
+ * the order of the variables from the main one.
+ * @param p : polynomial
+ * @return coefficient
+ */
+static poly_coeff_t LeadCoeff(const Poly *p) {
+    while (!PolyIsCoeff(p)) {
+        p = &LastMono(p)->p;
+    }
+    return p->coeff;
+}
+
+/**
+ * Returns the exponents of the leading monomial of a polynomial.
+ * @param p : polynomial
+ * @param exps : exponents of the variables
+ * @param vars : number of variables
+ */
+static void LeadExps(const Poly *p, poly_exp_t exps[], unsigned vars) {
+    for (unsigned i = 0; i < vars; i++) {
+        exps[i] = 0;
+        if (!PolyIsCoeff(p)) {
+            const Mono *m = LastMono(p);
+            exps[i] = m->exp;
+            p = &m->p;
+        }
+    }
+}
+
+/**
+ * Compares monomials in the order of the variables from the main one.
+ * @param a : exponents of a monomial
+ * @param b : exponents of a monomial
+ * @param vars : number of variables
+ * @return negative, zero or positive if @p a is smaller, equal or larger
+ */
+static int CmpExps(const poly_exp_t a[], const poly_exp_t b[],
+                   unsigned vars) {
+    for (unsigned i = 0; i < vars; i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the coefficient of a monomial of a polynomial.
+ * @param p : polynomial
+ * @param exps : exponents of the monomial
+ * @param vars : number of variables
+ * @return coefficient
+ */
+static poly_coeff_t CoeffAt(const Poly *p, const poly_exp_t exps[],
+                            unsigned vars) {
+    unsigned i = 0;
+    for (; i < vars && !PolyIsCoeff(p); i++) {
+        const Mono *m = p->list;
+        while (m != NULL && m->exp < exps[i]) {
+            m = m->next;
+        }
+        if (m == NULL || m->exp != exps[i]) {
+            return 0;
+        }
+        p = &m->p;
+    }
+    for (; i < vars; i++) {
+        if (exps[i] != 0) {
+            return 0;
+        }
+    }
+    return p->coeff;
+}
+
+/**
+ * Structure containing a polynomial as the array of the coefficients of
+ * the powers of its main variable, which are polynomials of the other
+ * variables.
+ */
+typedef struct Dense {
+    Poly *c; ///< coefficients from the exponent 0
+    long deg; ///< degree in the main variable, -1 for zero
+} Dense;
+
+/**
+ * Creates a polynomial with zero coefficients.
+ * @param deg : degree to make room for
+ * @return polynomial
+ */
+static Dense DenseNew(long deg) {
+    Dense d = {.c = calloc(deg + 2, sizeof(Poly)), .deg = deg};
+    assert(d.c != NULL);
+    for (long i = 0; i <= deg; i++) {
+        d.c[i] = PolyZero();
+    }
+    return d;
+}
+
+/**
+ * Releases a polynomial with its coefficients.
+ * @param d : polynomial
+ */
+static void DenseDestroy(Dense *d) {
+    for (long i = 0; i <= d->deg; i++) {
+        PolyDestroy(&d->c[i]);
+    }
+    free(d->c);
+}
+
+/**
+ * Splits a polynomial into the coefficients of its main variable.
+ * @param p : polynomial
+ * @return copy of the polynomial
+ */
+static Dense DenseOf(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        Dense d = DenseNew(PolyIsZero(p) ? -1 : 0);
+        if (d.deg == 0) {
+            d.c[0] = *p;
+        }
+        return d;
+    }
+    Dense d = DenseNew(LastMono(p)->exp);
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        d.c[m->exp] = PolyClone(&m->p);
+    }
+    return d;
+}
+
+/**
+ * Joins the coefficients of the main variable into a polynomial.
+ * @param d : polynomial, which is released
+ * @return polynomial
+ */
+static Poly DenseToPoly(Dense *d) {
+    Poly r = PolyZero();
+    Mono **link = &r.list;
+    for (long i = 0; i <= d->deg; i++) {
+        Append(&link, d->c[i], (poly_exp_t) i);
+    }
+    free(d->c);
+    Normalize(&r);
+    return r;
+}
+
+/**
+ * Lowers the degree of a polynomial to its leading nonzero coefficient.
+ * @param d : polynomial
+ */
+static void DenseTrim(Dense *d) {
+    while (d->deg >= 0 && PolyIsZero(&d->c[d->deg])) {
+        d->deg--;
+    }
+}
+
+/**
+ * Substitutes the main variable of a polynomial by Horner's scheme.
+ * @param d : polynomial
+ * @param x : point
+ * @param mod : prime
+ * @return polynomial of the other variables
+ */
+static Poly DenseEval(const Dense *d, uint64_t x, uint64_t mod) {
+    Poly r = PolyZero();
+    for (long i = d->deg; i >= 0; i--) {
+        Poly t = ModLinear(&r, x, &d->c[i], 1, mod);
+        PolyDestroy(&r);
+        r = t;
+    }
+    return r;
+}
+
+/**
+ * Returns the coefficient of a monomial of the other variables, which is
+ * a polynomial of the main one.
+ * @param d : polynomial
+ * @param exps : exponents of the other variables
+ * @param vars : number of the other variables
+ * @return coefficient
+ */
+static Uni CoeffUni(const Dense *d, const poly_exp_t exps[], unsigned vars) {
+    Uni u = UniNew(d->deg);
+    for (long i = 0; i <= d->deg; i++) {
+        u.c[i] = (uint64_t) CoeffAt(&d->c[i], exps, vars);
+    }
+    UniTrim(&u);
+    return u;
+}
+
+/**
+ * Adds the coefficients of the monomials of a coefficient of a polynomial
+ * to the gcd of the coefficients of the polynomial.
+ * @param d : polynomial
+ * @param p : coefficient of its main variable
+ * @param exps : exponents of the monomial which is built
+ * @param level : number of the exponents of the monomial which are set
+ * @param vars : number of the other variables
+ * @param cont : gcd of the coefficients
+ * @param mod : prime
+ * @return true if the gcd is 1, false otherwise
+ */
+static bool ContentWalk(const Dense *d, const Poly *p, poly_exp_t exps[],
+                        unsigned level, unsigned vars, Uni *cont,
+                        uint64_t mod) {
+    if (PolyIsCoeff(p)) {
+        if (PolyIsZero(p)) {
+            return false;
+        }
+        for (unsigned i = level; i < vars; i++) {
+            exps[i] = 0;
+        }
+        Uni u = CoeffUni(d, exps, vars), g = UniGcd(cont, &u, mod);
+        free(u.c);
+        free(cont->c);
+        *cont = g;
+        return g.deg == 0;
+    }
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        exps[level] = m->exp;
+        if (ContentWalk(d, &m->p, exps, level + 1, vars, cont, mod)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Computes the content of a polynomial as a polynomial of the other
+ * variables, which is the gcd of its coefficients. They are polynomials
+ * of the main variable.
+ * @param d : polynomial
+ * @param vars : number of the other variables
+ * @param mod : prime
+ * @return monic content
+ */
+static Uni Content(const Dense *d, unsigned vars, uint64_t mod) {
+    Uni cont = UniNew(-1);
+    poly_exp_t *exps = calloc(vars + 1, sizeof(poly_exp_t));
+    assert(exps != NULL);
+    for (long i = 0; i <= d->deg; i++) {
+        if (ContentWalk(d, &d->c[i], exps, 0, vars, &cont, mod)) {
+            break;
+        }
+    }
+    free(exps);
+    return cont;
+}
+
+/**
+ * Returns the leading coefficient of a polynomial as a polynomial of
+ * the other variables, which is a polynomial of the main one.
+ * @param d : polynomial, which isn't zero
+ * @param vars : number of the other variables
+ * @return coefficient
+ */
+static Uni LeadUni(const Dense *d, unsigned vars) {
+    poly_exp_t *lead = calloc(2 * vars + 1, sizeof(poly_exp_t));
+    assert(lead != NULL);
+    poly_exp_t *exps = lead + vars;
+    bool first = true;
+    for (long i = 0; i <= d->deg; i++) {
+        if (!PolyIsZero(&d->c[i])) {
+            LeadExps(&d->c[i], exps, vars);
+            if (first || CmpExps(exps, lead, vars) > 0) {
+                memcpy(lead, exps, vars * sizeof(poly_exp_t));
+            }
+            first = false;
+        }
+    }
+    Uni u = CoeffUni(d, lead, vars);
+    free(lead);
+    return u;
+}
+
+/**
+ * Divides a polynomial by a polynomial of the main variable, which
+ * divides it.
+ * @param a : polynomial
+ * @param b : polynomial of the main variable, which isn't zero
+ * @param mod : prime
+ * @return quotient
+ */
+static Dense DenseDivUni(const Dense *a, const Uni *b, uint64_t mod) {
+    Dense r = DenseNew(a->deg), q = DenseNew(a->deg - b->deg);
+    for (long i = 0; i <= a->deg; i++) {
+        r.c[i] = PolyClone(&a->c[i]);
+    }
+    uint64_t inv = InvMod(b->c[b->deg], mod);
+    for (long j = a->deg - b->deg; j >= 0; j--) {
+        q.c[j] = ModScale(&r.c[j + b->deg], inv, mod);
+        for (long k = 0; k <= b->deg; k++) {
+            if (b->c[k] != 0) {
+                AddScaled(&r.c[j + k], &q.c[j], mod - b->c[k], mod);
+            }
+        }
+    }
+    DenseDestroy(&r);
+    DenseTrim(&q);
+    return q;
+}
+
+/**
+ * Multiplies a polynomial by a polynomial of the main variable.
+ * @param a : polynomial of the main variable
+ * @param b : polynomial
+ * @param mod : prime
+ * @return product
+ */
+static Dense DenseMulUni(const Uni *a, const Dense *b, uint64_t mod) {
+    Dense r = DenseNew(a->deg + b->deg);
+    for (long i = 0; i <= a->deg; i++) {
+        for (long j = 0; j <= b->deg && a->c[i] != 0; j++) {
+            AddScaled(&r.c[i + j], &b->c[j], a->c[i], mod);
+        }
+    }
+    DenseTrim(&r);
+    return r;
+}
+
+/**
+ * Converts a polynomial of the main variable.
+ * @param p : polynomial with constant coefficients
+ * @return polynomial of one variable
+ */
+static Uni UniOf(const Poly *p) {
+    Mono single;
+    const Mono *m = Monos(p, &single);
+    Uni u = UniNew(m == NULL ? -1 : PolyIsCoeff(p) ? 0 : LastMono(p)->exp);
+    for (; m != NULL; m = m->next) {
+        u.c[m->exp] = (uint64_t) m->p.coeff;
+    }
+    return u;
+}
+
+/**
+ * Converts a polynomial of one variable.
+ * @param u : polynomial of one variable
+ * @return polynomial of the main variable
+ */
+static Poly UniToPoly(const Uni *u) {
+    Poly r = PolyZero();
+    Mono **link = &r.list;
+    for (long i = 0; i <= u->deg; i++) {
+        Append(&link, PolyFromCoeff((poly_coeff_t) u->c[i]), (poly_exp_t) i);
+    }
+    Normalize(&r);
+    return r;
+}
+
+/**
+ * Divides a polynomial by its leading coefficient modulo a prime.
+ * @param p : polynomial
+ * @param mod : prime
+ * @return monic polynomial, zero if @p p is zero
+ */
+static Poly ModMonic(const Poly *p, uint64_t mod) {
+    if (PolyIsZero(p)) {
+        return PolyZero();
+    }
+    return ModScale(p, InvMod((uint64_t) LeadCoeff(p), mod), mod);
+}
+
+static Poly ModGcd(const Poly *p, const Poly *q, unsigned vars,
+                   uint64_t mod);
+
+/**
+ * Computes the gcd of polynomials modulo a prime by Brown's algorithm.
+ * The polynomials are divided by their contents as polynomials of
+ * the other variables. Then the main variable is substituted with points,
+ * at which their leading coefficients don't vanish, and the gcds of
+ * the values, multiplied by the gcd of the leading
+ * coefficients at the point, are interpolated until the degree bound is
+ * passed. The values whose gcds have larger leading monomials are skipped,
+ * and a smaller one starts the interpolation again.
+ * @param p : polynomial, which isn't a constant
+ * @param q : polynomial, which isn't a constant
+ * @param vars : number of variables, at least 2
+ * @param mod : prime
+ * @return monic gcd
+ */
+static Poly ModGcdInterpolate(const Poly *p, const Poly *q, unsigned vars,
+                              uint64_t mod) {
+    unsigned rest = vars - 1;
+    Dense a = DenseOf(p), b = DenseOf(q);
+    Uni contA = Content(&a, rest, mod), contB = Content(&b, rest, mod);
+    Uni cont = UniGcd(&contA, &contB, mod);
+    Dense primA = DenseDivUni(&a, &contA, mod);
+    Dense primB = DenseDivUni(&b, &contB, mod);
+    DenseDestroy(&a);
+    DenseDestroy(&b);
+    free(contA.c);
+    free(contB.c);
+    Uni leadA = LeadUni(&primA, rest), leadB = LeadUni(&primB, rest);
+    Uni g = UniGcd(&leadA, &leadB, mod);
+    long bound = g.deg + (primA.deg < primB.deg ? primA.deg : primB.deg);
+    Dense h = DenseNew(bound);
+    Uni m = UniNew(0);
+    long points = 0;
+    poly_exp_t *lead = calloc(2 * rest + 1, sizeof(poly_exp_t));
+    assert(lead != NULL);
+    poly_exp_t *exps = lead + rest;
+    Poly r = PolyZero();
+    bool found = false;
+    /* An unlucky point may pass the degree bound alone, so every prime
+     * starts at another one and the next prime can correct it. */
+    uint64_t start = (GCD_FIRST_PRIME - mod + 1) * GCD_POINT_SPREAD % mod;
+    for (uint64_t k = 0; k < mod && !found; k++) {
+        uint64_t x = AddMod(start, k, mod);
+        /* The degrees of the values have to be the same as of
+         * the polynomials. */
+        if (UniEval(&leadA, x, mod) == 0 || UniEval(&leadB, x, mod) == 0) {
+            continue;
+        }
+        uint64_t gx = UniEval(&g, x, mod);
+        Poly valA = DenseEval(&primA, x, mod), valB = DenseEval(&primB, x, mod);
+        Poly c = ModGcd(&valA, &valB, rest, mod);
+        PolyDestroy(&valA);
+        PolyDestroy(&valB);
+        if (PolyIsCoeff(&c)) {
+            /* The primitive parts are coprime. */
+            r = UniToPoly(&cont);
+            found = true;
+            break;
+        }
+        LeadExps(&c, exps, rest);
+        int cmp = points == 0 ? -1 : CmpExps(exps, lead, rest);
+        if (cmp > 0) {
+            PolyDestroy(&c);
+            continue;
+        }
+        if (cmp < 0) {
+            DenseDestroy(&h);
+            h = DenseNew(bound);
+            free(m.c);
+            m = UniNew(0);
+            points = 0;
+            memcpy(lead, exps, rest * sizeof(poly_exp_t));
+        }
+        if (points == 0) {
+            m.c[0] = 1;
+        }
+        /* Newton's interpolation: h += (g(x) * c - h(x)) * m / m(x). */
+        Poly hx = DenseEval(&h, x, mod), e = ModLinear(&c, gx, &hx, mod - 1,
+                                                       mod);
+        uint64_t scale = InvMod(UniEval(&m, x, mod), mod);
+        for (long k = 0; k <= m.deg; k++) {
+            AddScaled(&h.c[k], &e, MulMod(m.c[k], scale, mod), mod);
+        }
+        PolyDestroy(&c);
+        PolyDestroy(&hx);
+        PolyDestroy(&e);
+        Uni next = UniMulLinear(&m, x, mod);
+        free(m.c);
+        m = next;
+        if (++points > bound) {
+            DenseTrim(&h);
+            Uni contH = Content(&h, rest, mod);
+            Dense primH = DenseDivUni(&h, &contH, mod);
+            Dense res = DenseMulUni(&cont, &primH, mod);
+            Poly t = DenseToPoly(&res);
+            r = ModMonic(&t, mod);
+            PolyDestroy(&t);
+            DenseDestroy(&primH);
+            free(contH.c);
+            found = true;
+        }
+    }
+    assert(found);
+    free(leadA.c);
+    free(leadB.c);
+    free(lead);
+    free(m.c);
+    free(g.c);
+    free(cont.c);
+    DenseDestroy(&h);
+    DenseDestroy(&primA);
+    DenseDestroy(&primB);
+    return r;
+}
+
+/**
+ * Computes the gcd of polynomials modulo a prime.
+ * @param p : polynomial
+ * @param q : polynomial
+ * @param vars : number of variables of the polynomials or larger
+ * @param mod : prime
+ * @return monic gcd, zero if both polynomials are zero
+ */
+static Poly ModGcd(const Poly *p, const Poly *q, unsigned vars,
+                   uint64_t mod) {
+    if (PolyIsZero(p)) {
+        return ModMonic(q, mod);
+    }
+    if (PolyIsZero(q)) {
+        return ModMonic(p, mod);
+    }
+    if (PolyIsCoeff(p) || PolyIsCoeff(q)) {
+        return PolyFromCoeff(1);
+    }
+    if (vars > 1) {
+        return ModGcdInterpolate(p, q, vars, mod);
+    }
+    Uni a = UniOf(p), b = UniOf(q), g = UniGcd(&a, &b, mod);
+    Poly r = UniToPoly(&g);
+    free(a.c);
+    free(b.c);
+    free(g.c);
+    return r;
+}
+
+/**
+ * Returns the gcd of the coefficients of a polynomial.
+ * @param p : polynomial
+ * @return gcd, zero for zero
+ */
+static uint64_t IntContent(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        return Abs(p->coeff);
+    }
+    uint64_t c = 0;
+    for (const Mono *m = p->list; m != NULL && c != 1; m = m->next) {
+        c = IntGcd(c, IntContent(&m->p));
+    }
+    return c;
+}
+
+/**
+ * Divides a polynomial by a number which divides all its coefficients,
+ * so that its leading coefficient is positive.
+ * @param p : polynomial, which isn't zero
+ * @param c : positive divisor
+ * @return quotient
+ */
+static Poly DivCoeff(const Poly *p, uint64_t c) {
+    Poly d = PolyFromCoeff(LeadCoeff(p) < 0 ? -(poly_coeff_t) c :
+                                              (poly_coeff_t) c), r;
+    bool exact = PolyDivExact(p, &d, &r);
+    assert(exact);
+    (void) exact;
+    return r;
+}
+
+/**
+ * Checks if a polynomial divides another one.
+ * @param p : polynomial
+ * @param q : polynomial, which isn't zero
+ * @return whether @p q divides @p p
+ */
+static bool Divides(const Poly *p, const Poly *q) {
+    Poly quot;
+    bool divisible = PolyDivExact(p, q, &quot);
+    PolyDestroy(&quot);
+    return divisible;
+}
+
+bool PolyGcd(const Poly *p, const Poly *q, Poly *gcd) {
+    if (PolyIsZero(p) || PolyIsZero(q)) {
+        const Poly *r = PolyIsZero(p) ? q : p;
+        *gcd = PolyIsZero(r) ? PolyZero() : LeadCoeff(r) < 0 ? PolyNeg(r) :
+                                                               PolyClone(r);
+        return false;
+    }
+    uint64_t contP = IntContent(p), contQ = IntContent(q);
+    poly_coeff_t c = (poly_coeff_t) IntGcd(contP, contQ);
+    if (PolyIsCoeff(p) || PolyIsCoeff(q)) {
+        *gcd = PolyFromCoeff(c);
+        return false;
+    }
+    unsigned vars = PolyVars(p) > PolyVars(q) ? PolyVars(p) : PolyVars(q);
+    if (!DenseFits(p, q, vars)) {
+        return true;
+    }
+    Poly a = DivCoeff(p, contP), b = DivCoeff(q, contQ);
+    bool byB = Divides(&a, &b);
+    if (byB || Divides(&b, &a)) {
+        Poly factor = PolyFromCoeff(c);
+        *gcd = PolyMul(byB ? &b : &a, &factor);
+        PolyDestroy(&a);
+        PolyDestroy(&b);
+        return false;
+    }
+    poly_coeff_t leadA = LeadCoeff(&a), leadB = LeadCoeff(&b);
+    uint64_t g = IntGcd(Abs(leadA), Abs(leadB));
+    poly_exp_t *lead = calloc(2 * vars, sizeof(poly_exp_t));
+    assert(lead != NULL);
+    poly_exp_t *exps = lead + vars;
+    /* The images modulo at most two primes are combined, since
+     * the product of three of them doesn't fit in 64 bits. */
+    Poly h = PolyZero(), r = PolyFromCoeff(c);
+    bool found = false;
+    unsigned images = 0;
+    uint64_t m = 1, mod = GCD_FIRST_PRIME;
+    for (unsigned i = 0; i < GCD_MAX_PRIMES; i++, mod = PrevPrime(mod)) {
+        if (Residue(leadA, mod) == 0 || Residue(leadB, mod) == 0) {
+            continue;
+        }
+        Poly zero = PolyZero();
+        Poly modA = ModLinear(&a, 1, &zero, 0, mod);
+        Poly modB = ModLinear(&b, 1, &zero, 0, mod);
+        Poly image = ModGcd(&modA, &modB, vars, mod);
+        PolyDestroy(&modA);
+        PolyDestroy(&modB);
+        if (PolyIsCoeff(&image)) {
+            found = true;
+            break;
+        }
+        LeadExps(&image, exps, vars);
+        int cmp = images == 0 ? -1 : CmpExps(exps, lead, vars);
+        if (cmp > 0) {
+            /* The prime is unlucky. */
+            PolyDestroy(&image);
+            continue;
+        }
+        if (cmp < 0) {
+            PolyDestroy(&h);
+            h = PolyZero();
+            images = 0;
+            m = 1;
+            memcpy(lead, exps, vars * sizeof(poly_exp_t));
+        }
+        Poly scaled = ModScale(&image, g % mod, mod);
+        Combiner op = {.crt = true, .mod = mod, .m = m,
+                       .inv = InvMod(m % mod, mod)};
+        Poly next = Merge(&h, &scaled, &op);
+        PolyDestroy(&image);
+        PolyDestroy(&scaled);
+        PolyDestroy(&h);
+        h = next;
+        m *= mod;
+        images++;
+        Poly candidate = DivCoeff(&h, IntContent(&h));
+        if (Divides(&a, &candidate) && Divides(&b, &candidate)) {
+            PolyDestroy(&r);
+            Poly factor = PolyFromCoeff(c);
+            r = PolyMul(&candidate, &factor);
+            PolyDestroy(&candidate);
+            found = true;
+            break;
+        }
+        PolyDestroy(&candidate);
+        if (images == 2) {
+            PolyDestroy(&h);
+            h = PolyZero();
+            images = 0;
+            m = 1;
+        }
+    }
+    free(lead);
+    PolyDestroy(&h);
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    if (!found) {
+        /* The coefficients of the gcd don't fit in the two primes. */
+        PolyDestroy(&r);
+        return true;
+    }
+    *gcd = r;
+    return false;
+}
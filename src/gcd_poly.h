@@ -0,0 +1,36 @@
+/** @file
+   Interface of the greatest common divisor of polynomials
+
+   The gcd is computed modulo primes by Brown's algorithm: the main variable
+   is substituted with points, the gcds of the values are computed
+   recursively and interpolated back. The images modulo two primes are
+   combined by the Chinese remainder theorem and the result is checked by
+   dividing the polynomials by it.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#ifndef __GCD_POLY_H__
+#define __GCD_POLY_H__
+
+#include "poly.h"
+
+/**
+ * Computes the greatest common divisor of two polynomials with integer
+ * coefficients. Its leading coefficient, in the order of the variables
+ * from the main one, is positive. Unless one of the polynomials divides
+ * the other one, the coefficients of the gcd have to fit in 62 bits.
+ * The polynomials are kept as dense arrays of the coefficients of all
+ * powers of their variables up to their degrees, so the gcd isn't computed
+ * if those would be too large.
+ * @param[in] p : polynomial
+ * @param[in] q : polynomial
+ * @param[out] gcd : gcd of @p p and @p q, zero if both of them are zero
+ * @return true if the degrees of the polynomials are too large or
+ *         the coefficients of the gcd don't fit, false otherwise
+ */
+bool PolyGcd(const Poly *p, const Poly *q, Poly *gcd);
+
+#endif /* __GCD_POLY_H__ */
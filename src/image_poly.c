@@ -0,0 +1,278 @@
+/** @file
+   Implementation of the binary images of polynomials
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-28
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image_poly.h"
+
+/** identifier at the beginning of every image */
+#define IMAGE_MAGIC "POLYIMG"
+/** lowest preferred address of an image */
+#define IMAGE_BASE_MIN ((uint64_t) 1 << 44)
+/** distance between preferred addresses of images */
+#define IMAGE_SLOT_SIZE ((uint64_t) 1 << 40)
+/** number of preferred addresses of images */
+#define IMAGE_SLOTS 64
+
+/**
+ * Structure containing the beginning of an image file
+ */
+typedef struct image_header {
+    char magic[8]; ///< IMAGE_MAGIC
+    uint32_t version; ///< IMAGE_VERSION
+    uint32_t monoSize; ///< size of a monomial of the image
+    uint64_t base; ///< address for which the pointers were written
+    uint64_t count; ///< number of monomials of the image
+    Poly root; ///< polynomial of the image
+} ImageHeader;
+
+/**
+ * Structure containing the state of writing an image
+ */
+typedef struct image_writer {
+    FILE *f; ///< image file
+    uint64_t base; ///< preferred address of the image
+    uint64_t count; ///< number of written monomials
+    bool error; ///< whether writing failed
+} ImageWriter;
+
+/**
+ * Chooses the preferred address of an image by the hash of its path,
+ * so different images are likely to be mapped at the same time in place.
+ * @param path
+ * @return
+ */
+static uint64_t PreferredBase(const char *path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *c = path; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+    return IMAGE_BASE_MIN + hash % IMAGE_SLOTS * IMAGE_SLOT_SIZE;
+}
+
+/**
+ * Counts the monomials of a polynomial on all levels.
+ * @param p
+ * @return number of monomials
+ */
+static uint64_t CountMonos(const Poly *p) {
+    uint64_t count = 0;
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        count += 1 + CountMonos(&m->p);
+    }
+    return count;
+}
+
+/**
+ * Writes the table of a polynomial which isn't constant before the tables
+ * of its coefficients, so that every pointer of an image points to
+ * a later monomial.
+ * @param w
+ * @param p
+ * @return address of the table in the image
+ */
+static uint64_t WriteTable(ImageWriter *w, const Poly *p) {
+    size_t count = 0;
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        count++;
+    }
+    /* Zeroed memory makes the padding of the monomials deterministic. */
+    Mono *table = calloc(count, sizeof(Mono));
+    assert(table != NULL);
+    uint64_t address = w->base + sizeof(ImageHeader) + w->count * sizeof(Mono);
+    /* The tables of the coefficients follow in the order of monomials. */
+    uint64_t next = w->count + count;
+    size_t i = 0;
+    for (const Mono *m = p->list; m != NULL; m = m->next, i++) {
+        table[i].exp = m->exp;
+        if (PolyIsCoeff(&m->p)) {
+            table[i].p.coeff = m->p.coeff;
+        }
+        else {
+            table[i].p.list = (Mono *) (uintptr_t)
+                (w->base + sizeof(ImageHeader) + next * sizeof(Mono));
+            next += CountMonos(&m->p);
+        }
+    }
+    for (i = 0; i + 1 < count; i++) {
+        table[i].next = (Mono *) (uintptr_t) (address + (i + 1) * sizeof(Mono));
+    }
+    if (fwrite(table, sizeof(Mono), count, w->f) != count) {
+        w->error = true;
+    }
+    w->count += count;
+    free(table);
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        if (!PolyIsCoeff(&m->p)) {
+            WriteTable(w, &m->p);
+        }
+    }
+    return address;
+}
+
+bool ImageWrite(FILE *f, const char *name, const Poly *p) {
+    ImageWriter w = {.f = f, .base = PreferredBase(name), .count = 0,
+                     .error = false};
+    long start = ftell(f);
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    /* The header is written again when the root table is known. */
+    if (start < 0 || fwrite(&header, sizeof(header), 1, f) != 1) {
+        return true;
+    }
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.monoSize = sizeof(Mono);
+    header.base = w.base;
+    if (PolyIsCoeff(p)) {
+        header.root.coeff = p->coeff;
+    }
+    else {
+        header.root.list = (Mono *) (uintptr_t) WriteTable(&w, p);
+    }
+    header.count = w.count;
+    return w.error || fseek(f, start, SEEK_SET) != 0 ||
+           fwrite(&header, sizeof(header), 1, f) != 1 ||
+           fseek(f, 0, SEEK_END) != 0;
+}
+
+bool ImageSave(const char *path, const Poly *p) {
+    /* An image of the old file may still be mapped, so the file is
+       replaced instead of truncated. */
+    unlink(path);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return true;
+    }
+    bool error = ImageWrite(f, path, p);
+    return fclose(f) != 0 || error;
+}
+
+/**
+ * Checks a pointer of an image and moves it if the image is mapped at
+ * a different address.
+ * @param ptr : pointer
+ * @param header : header of the image
+ * @param first : index of the first monomial it may point to
+ * @param delta : distance between the real and the preferred address
+ * @return true if the pointer doesn't point to a monomial from @p first,
+ *         false otherwise
+ */
+static bool CheckPointer(Mono **ptr, const ImageHeader *header,
+                         uint64_t first, uintptr_t delta) {
+    if (*ptr == NULL) {
+        return false;
+    }
+    uint64_t offset = (uintptr_t) *ptr - header->base;
+    if (offset < sizeof(ImageHeader) ||
+        (offset - sizeof(ImageHeader)) % sizeof(Mono) != 0 ||
+        (offset - sizeof(ImageHeader)) / sizeof(Mono) >= header->count ||
+        (offset - sizeof(ImageHeader)) / sizeof(Mono) < first) {
+        return true;
+    }
+    if (delta != 0) {
+        *ptr = (Mono *) ((uintptr_t) *ptr + delta);
+    }
+    return false;
+}
+
+/**
+ * Checks all pointers of an image and moves them if it is mapped at
+ * a different address. Every pointer has to point to a later monomial,
+ * so the lists of an image can't form cycles.
+ * @param map : mapped image
+ * @param length : length of the image
+ * @return true if the image is incorrect, false otherwise
+ */
+static bool CheckPointers(void *map, size_t length) {
+    ImageHeader *header = map;
+    Mono *table = (Mono *) (header + 1);
+    uintptr_t delta = (uintptr_t) map - header->base;
+    if (delta != 0 && mprotect(map, length, PROT_READ | PROT_WRITE) != 0) {
+        return true;
+    }
+    /* Pointers which aren't moved are only read. */
+    bool error = CheckPointer(&header->root.list, header, 0, delta);
+    for (uint64_t i = 0; i < header->count && !error; i++) {
+        error = CheckPointer(&table[i].p.list, header, i + 1, delta) ||
+                CheckPointer(&table[i].next, header, i + 1, delta);
+    }
+    return delta != 0 && mprotect(map, length, PROT_READ) != 0 || error;
+}
+
+Image *ImageMap(int fd, off_t offset, Poly *p) {
+    struct stat st;
+    ImageHeader header;
+    if (fstat(fd, &st) != 0 || st.st_size - offset < (off_t) sizeof(header) ||
+        pread(fd, &header, sizeof(header), offset) != sizeof(header) ||
+        memcmp(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+        header.version != IMAGE_VERSION || header.monoSize != sizeof(Mono) ||
+        header.count > (SIZE_MAX - sizeof(header)) / sizeof(Mono) ||
+        (uint64_t) (st.st_size - offset) !=
+        sizeof(header) + header.count * sizeof(Mono)) {
+        return NULL;
+    }
+    size_t length = st.st_size - offset;
+    /* The preferred address is only a hint, a taken one isn't replaced. */
+    void *map = mmap((void *) (uintptr_t) header.base, length, PROT_READ,
+                     MAP_PRIVATE, fd, offset);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    if (CheckPointers(map, length)) {
+        munmap(map, length);
+        return NULL;
+    }
+    Image *image = malloc(sizeof(Image));
+    assert(image != NULL);
+    *image = (Image) {.map = map, .length = length, .refs = 1,
+                      .poly = PolyZero()};
+    *p = ((ImageHeader *) map)->root;
+    return image;
+}
+
+Image *ImageLoad(const char *path, Poly *p) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    Image *image = ImageMap(fd, 0, p);
+    close(fd);
+    return image;
+}
+
+Image *ImageFromPoly(Poly p) {
+    Image *image = malloc(sizeof(Image));
+    assert(image != NULL);
+    *image = (Image) {.map = NULL, .length = 0, .refs = 1, .poly = p};
+    return image;
+}
+
+void ImageRetain(Image *image) {
+    atomic_fetch_add_explicit(&image->refs, 1, memory_order_relaxed);
+}
+
+void ImageRelease(Image *image) {
+    if (atomic_fetch_sub_explicit(&image->refs, 1,
+                                  memory_order_acq_rel) == 1) {
+        if (image->map != NULL) {
+            munmap(image->map, image->length);
+        }
+        else {
+            PolyDestroy(&image->poly);
+        }
+        free(image);
+    }
+}
@@ -0,0 +1,105 @@
+/** @file
+   Interface of the binary images of polynomials
+
+   An image is a file holding a polynomial as a flat table of monomials.
+   Monomials of every polynomial which isn't constant take consecutive
+   entries of the table and their coefficients which aren't constant point
+   to their own entries, which follow them, so every pointer points to
+   a later entry. The pointers are written for a preferred address
+   of the image. A loaded image is mapped to memory, at the preferred address
+   if it is free, and its polynomial is used in place without copying.
+   Otherwise the pointers are moved once when the image is loaded.
+   The pointers are checked whenever an image is loaded.
+
+   Polynomials of an image are read only. They can be shared, but never
+   destroyed with PolyDestroy. The image is released instead.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-28
+*/
+
+#ifndef __IMAGE_POLY_H__
+#define __IMAGE_POLY_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <stdatomic.h>
+#include "poly.h"
+
+/** version of the format of the images */
+#define IMAGE_VERSION 2
+
+/**
+ * Structure containing a loaded image. An image shares a polynomial which
+ * is never changed, held either by a memory mapped file or in memory.
+ */
+typedef struct image {
+    void *map; ///< memory mapped file or NULL
+    size_t length; ///< length of the file
+    atomic_ulong refs; ///< number of references to the image, which may be
+                       ///< shared by threads
+    Poly poly; ///< polynomial held in memory if there is no mapped file
+} Image;
+
+/**
+ * Writes a polynomial to an image file.
+ * @param[in] path : path of the file
+ * @param[in] p : polynomial
+ * @return true if the file couldn't be written, false otherwise
+ */
+bool ImageSave(const char *path, const Poly *p);
+
+/**
+ * Writes an image of a polynomial at the end of a binary stream, so it can
+ * be mapped from a file holding also other data.
+ * @param[in] f : stream, positioned at its end
+ * @param[in] name : name by which the preferred address is chosen
+ * @param[in] p : polynomial
+ * @return true if the image couldn't be written, false otherwise
+ */
+bool ImageWrite(FILE *f, const char *name, const Poly *p);
+
+/**
+ * Loads an image file. The returned image has one reference.
+ * The pointers of the image are checked, also if they aren't moved.
+ * @param[in] path : path of the file
+ * @param[out] p : polynomial held by the image
+ * @return image or NULL if the file isn't a correct image
+ */
+Image *ImageLoad(const char *path, Poly *p);
+
+/**
+ * Maps an image which takes the end of a file from a given offset.
+ * @param[in] fd : descriptor of the file
+ * @param[in] offset : offset of the image, a multiple of the page size
+ * @param[out] p : polynomial held by the image
+ * @return image or NULL if the file doesn't end with a correct image
+ */
+Image *ImageMap(int fd, off_t offset, Poly *p);
+
+/**
+ * Makes an image holding a polynomial in memory, so it can be shared.
+ * Takes ownership of the polynomial @p p. The returned image has
+ * one reference.
+ * @param[in] p : polynomial
+ * @return image
+ */
+Image *ImageFromPoly(Poly p);
+
+/**
+ * Adds a reference to the image.
+ * @param[in] image : image
+ */
+void ImageRetain(Image *image);
+
+/**
+ * Removes a reference to the image. Unmaps it or deletes its polynomial
+ * when it was the last one.
+ * @param[in] image : image
+ */
+void ImageRelease(Image *image);
+
+#endif /* __IMAGE_POLY_H__ */
@@ -0,0 +1,229 @@
+/** @file
+   Implementation of the buffered input of the polynomial calculator
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-25
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input_poly.h"
+#include "utils.h"
+
+_Thread_local Input calcInput;
+
+void InputOpen(int fd) {
+    calcInput = (Input) {.cur = NULL, .end = NULL, .buf = NULL, .map = NULL,
+                         .mapLength = 0, .fd = fd, .eof = false,
+                         .idle = NULL};
+#ifndef UNIT_TESTING
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            calcInput.map = map;
+            calcInput.mapLength = st.st_size;
+            calcInput.cur = map;
+            calcInput.end = calcInput.cur + st.st_size;
+            calcInput.eof = true;
+            return;
+        }
+    }
+#endif /* UNIT_TESTING */
+    calcInput.buf = malloc(INPUT_LOOKBEHIND + INPUT_BLOCK_SIZE);
+    assert(calcInput.buf != NULL);
+    calcInput.cur = calcInput.end = calcInput.buf + INPUT_LOOKBEHIND;
+}
+
+void InputOpenMemory(const char *text, size_t length) {
+    calcInput = (Input) {.cur = text, .end = text + length, .buf = NULL,
+                         .map = NULL, .mapLength = 0, .fd = -1, .eof = true,
+                         .idle = NULL};
+}
+
+void InputSetIdle(void (*idle)(void)) {
+    calcInput.idle = idle;
+}
+
+void InputClose() {
+    if (calcInput.map != NULL) {
+        munmap(calcInput.map, calcInput.mapLength);
+    }
+    free(calcInput.buf);
+    calcInput.map = calcInput.buf = NULL;
+    calcInput.cur = calcInput.end = NULL;
+}
+
+/**
+ * Reads at most @p count characters of the input.
+ * @param dest
+ * @param count
+ * @return number of read characters, 0 at the end of the input
+ */
+static size_t ReadBlock(char *dest, size_t count) {
+#ifdef UNIT_TESTING
+    /* The mocked standard input is read by getchar. */
+    size_t n = 0;
+    int c;
+    while (n < count && (c = getchar()) != EOF) {
+        dest[n++] = c;
+    }
+    return n;
+#else
+    ssize_t n;
+    if (calcInput.idle != NULL) {
+        /* Checks the input without waiting first, so the idle function
+         * is called only if there is nothing to read. */
+        struct pollfd pfd = {.fd = calcInput.fd, .events = POLLIN};
+        int ready;
+        do {
+            ready = poll(&pfd, 1, 0);
+        } while (ready < 0 && errno == EINTR);
+        if (ready == 0) {
+            calcInput.idle();
+        }
+    }
+    do {
+        n = read(calcInput.fd, dest, count);
+    } while (n < 0 && errno == EINTR);
+    return n > 0 ? n : 0;
+#endif /* UNIT_TESTING */
+}
+
+int InputRefill() {
+    if (calcInput.eof) {
+        return EOF;
+    }
+    /* Keeps the last characters so they can still be given back. */
+    size_t kept = calcInput.end - calcInput.buf;
+    if (kept > INPUT_LOOKBEHIND) {
+        kept = INPUT_LOOKBEHIND;
+    }
+    memmove(calcInput.buf + INPUT_LOOKBEHIND - kept, calcInput.end - kept,
+            kept);
+    char *block = calcInput.buf + INPUT_LOOKBEHIND;
+    size_t n = ReadBlock(block, INPUT_BLOCK_SIZE);
+    calcInput.cur = block;
+    calcInput.end = block + n;
+    if (n == 0) {
+        calcInput.eof = true;
+        return EOF;
+    }
+    return (unsigned char) *calcInput.cur++;
+}
+
+size_t InputEnsure(size_t n) {
+    assert(n <= INPUT_BLOCK_SIZE);
+    while ((size_t) (calcInput.end - calcInput.cur) < n && !calcInput.eof &&
+           (calcInput.cur == calcInput.end ||
+            memchr(calcInput.cur, '\n', calcInput.end - calcInput.cur) == NULL)) {
+        /* Moves the unread characters, with the ones which can still be
+         * given back, to the beginning of the buffer. */
+        size_t behind = calcInput.cur - calcInput.buf;
+        if (behind > INPUT_LOOKBEHIND) {
+            behind = INPUT_LOOKBEHIND;
+        }
+        size_t unread = calcInput.end - calcInput.cur;
+        char *cur = calcInput.buf + INPUT_LOOKBEHIND;
+        memmove(cur - behind, calcInput.cur - behind, behind + unread);
+        size_t read = ReadBlock(cur + unread, INPUT_BLOCK_SIZE - unread);
+        calcInput.cur = cur;
+        calcInput.end = cur + unread + read;
+        if (read == 0) {
+            calcInput.eof = true;
+        }
+    }
+    return calcInput.end - calcInput.cur;
+}
+
+void InputSkipLine() {
+    int c;
+    do {
+        const char *nl = memchr(calcInput.cur, '\n',
+                                calcInput.end - calcInput.cur);
+        if (nl != NULL) {
+            calcInput.cur = nl;
+            return;
+        }
+        calcInput.cur = calcInput.end;
+        c = InputRefill();
+    } while (c != EOF && c != '\n');
+    InputUngetc(c);
+}
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+/** eight bytes with the same value */
+#define REPEAT_BYTE(b) (0x0101010101010101ULL * (b))
+
+/**
+ * Powers of ten by the number of digits in a word.
+ */
+static const uint64_t powersOfTen[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL
+};
+
+/**
+ * Evaluates eight digits, the first one in the lowest byte.
+ * @param d : values of the digits
+ * @return
+ */
+static inline uint64_t EightDigits(uint64_t d) {
+    d = (d * 10) + (d >> 8);
+    d = ((d & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)) +
+         ((d >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))) >> 32;
+    return d;
+}
+
+int InputDigits(uint64_t max, uint64_t *value) {
+    if (calcInput.end - calcInput.cur < INPUT_DIGITS_WINDOW) {
+        return 0;
+    }
+    uint64_t number = 0;
+    int count = 0;
+    for (int i = 0; i < INPUT_DIGITS_WINDOW; i += 8) {
+        uint64_t word;
+        memcpy(&word, calcInput.cur + i, sizeof(word));
+        /* Digits become bytes smaller than 10, the high bit of a byte in
+         * the mask is set for the other ones. A carry can spoil only
+         * bytes after the first character which isn't a digit. */
+        uint64_t d = word ^ REPEAT_BYTE('0');
+        uint64_t mask = ((d + REPEAT_BYTE(0x76)) | d) & REPEAT_BYTE(0x80);
+        int digits = mask == 0 ? 8 : __builtin_ctzll(mask) / 8;
+        if (digits > 0) {
+            /* Shifted digits are preceded by zeros. */
+            number = number * powersOfTen[digits] +
+                     EightDigits(d << (8 * (8 - digits)));
+            count += digits;
+        }
+        if (digits < 8) {
+            if (count > INPUT_MAX_DIGITS || number > max) {
+                return 0;
+            }
+            calcInput.cur += count;
+            *value = number;
+            return count;
+        }
+    }
+    return 0;
+}
+
+#else
+
+int InputDigits(uint64_t max, uint64_t *value) {
+    (void) max;
+    (void) value;
+    return 0;
+}
+
+#endif /* __BYTE_ORDER__ */
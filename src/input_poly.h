@@ -0,0 +1,126 @@
+/** @file
+   Interface of the buffered input of the polynomial calculator
+
+   The input is read in large blocks, or mapped to memory if it is a regular
+   file, and the parser scans it with a cursor. At least
+   INPUT_LOOKBEHIND characters can always be given back.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-25
+*/
+
+#ifndef __INPUT_POLY_H__
+#define __INPUT_POLY_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** size of the blocks read from the input */
+#define INPUT_BLOCK_SIZE (1 << 16)
+/** number of characters which can be always given back to the input */
+#define INPUT_LOOKBEHIND 16
+/** maximal number of digits read at once, which always fit in 64 bits */
+#define INPUT_MAX_DIGITS 19
+/** number of characters examined at once when looking for digits */
+#define INPUT_DIGITS_WINDOW 24
+
+/**
+ * Structure containing the state of the input
+ */
+typedef struct input {
+    const char *cur; ///< next character to read
+    const char *end; ///< end of the available characters
+    char *buf; ///< buffer for the blocks read from the file
+    void *map; ///< memory mapped file or NULL
+    size_t mapLength; ///< length of the memory mapped file
+    int fd; ///< file descriptor of the input
+    bool eof; ///< whether the end of the input was reached
+    void (*idle)(void); ///< called before waiting for more input or NULL
+} Input;
+
+/** Input of the calculator, separate in every thread. */
+extern _Thread_local Input calcInput;
+
+/**
+ * Starts reading the input from a file descriptor.
+ * @param[in] fd : file descriptor
+ */
+void InputOpen(int fd);
+
+/**
+ * Sets the function called before the input waits for more characters,
+ * which lets the answers to the read lines be sent.
+ * @param[in] idle : function or NULL
+ */
+void InputSetIdle(void (*idle)(void));
+
+/**
+ * Starts reading the input from memory, which isn't copied.
+ * @param[in] text : characters of the input
+ * @param[in] length : number of characters
+ */
+void InputOpenMemory(const char *text, size_t length);
+
+/**
+ * Releases the resources of the input.
+ */
+void InputClose();
+
+/**
+ * Reads the next block of the input.
+ * @return next character or EOF
+ */
+int InputRefill();
+
+/**
+ * Reads the next character of the input.
+ * @return character or EOF
+ */
+static inline int InputGetc() {
+    if (calcInput.cur < calcInput.end) {
+        return (unsigned char) *calcInput.cur++;
+    }
+    return InputRefill();
+}
+
+/**
+ * Gives back the last read character to the input.
+ * @param[in] c : character or EOF, which isn't given back
+ */
+static inline void InputUngetc(int c) {
+    if (c != EOF) {
+        calcInput.cur--;
+    }
+}
+
+/**
+ * Makes at least @p n characters available directly in the buffer,
+ * starting at the cursor, unless the input or the current line ends before.
+ * The next lines aren't waited for, so an interactive client gets
+ * the answer before it sends them.
+ * @param[in] n : number of characters, at most INPUT_BLOCK_SIZE
+ * @return number of available characters
+ */
+size_t InputEnsure(size_t n);
+
+/**
+ * Skips the characters until the end of line, which isn't read.
+ */
+void InputSkipLine();
+
+/**
+ * Reads a whole run of decimal digits at once, eight digits in a step.
+ * Nothing is read if the run doesn't end within the next
+ * INPUT_DIGITS_WINDOW available characters, if it has more than
+ * INPUT_MAX_DIGITS digits or if its value exceeds @p max. The caller then
+ * has to read the digits one by one.
+ * @param[in] max : maximal accepted value
+ * @param[out] value : value of the digits
+ * @return number of read digits
+ */
+int InputDigits(uint64_t max, uint64_t *value);
+
+#endif /* __INPUT_POLY_H__ */
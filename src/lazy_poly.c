@@ -0,0 +1,658 @@
+/** @file
+   Implementation of the lazy expressions of polynomials
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <pthread.h>
+#include "lazy_poly.h"
+
+/** starting number of elements of the work lists */
+#define LIST_STARTING_SIZE 16
+
+/**
+ * Structure containing a node waiting to be visited.
+ */
+typedef struct work_item {
+    Node *node; ///< node
+    bool negative; ///< whether the node is subtracted
+} WorkItem;
+
+/**
+ * Structure containing a list of nodes waiting to be visited.
+ */
+typedef struct work_list {
+    WorkItem *arr; ///< nodes
+    size_t count; ///< number of nodes
+    size_t size; ///< number of allocated nodes
+} WorkList;
+
+/**
+ * Structure containing the monomials of the terms of a sum.
+ */
+typedef struct mono_buffer {
+    Mono *arr; ///< monomials
+    size_t count; ///< number of monomials
+    size_t size; ///< number of allocated monomials
+} MonoBuffer;
+
+/**
+ * Structure containing the worker threads and the queue of the nodes
+ * which they evaluate.
+ */
+typedef struct workers {
+    pthread_t *threads; ///< threads
+    size_t count; ///< number of threads
+    Node **queue; ///< nodes waiting to be evaluated, each with a reference
+    size_t head; ///< index of the first node in the queue
+    size_t length; ///< number of nodes in the queue
+    size_t size; ///< number of allocated nodes of the queue
+    bool stopping; ///< whether the threads should quit
+    pthread_mutex_t lock; ///< lock of the queue and the states of the nodes
+    pthread_cond_t notEmpty; ///< signalled when a node is queued
+    pthread_cond_t done; ///< broadcast when a node is evaluated
+} Workers;
+
+/** worker threads */
+static Workers workers;
+/** whether the worker threads are running */
+static bool parallel = false;
+/** largest number of the monomials of a value with products */
+static size_t maxTerms = SIZE_MAX;
+
+/**
+ * Locks the states of the nodes if the worker threads are running.
+ */
+static void Lock() {
+    if (parallel) {
+        pthread_mutex_lock(&workers.lock);
+    }
+}
+
+/**
+ * Unlocks the states of the nodes if the worker threads are running.
+ */
+static void Unlock() {
+    if (parallel) {
+        pthread_mutex_unlock(&workers.lock);
+    }
+}
+
+/**
+ * Checks if a node is evaluated.
+ * @param n
+ * @return
+ */
+static bool IsDone(const Node *n) {
+    return atomic_load_explicit(&n->state, memory_order_acquire) ==
+           NODE_DONE;
+}
+
+/**
+ * Adds a node to the work list.
+ * @param list
+ * @param node
+ * @param negative
+ */
+static void PushWork(WorkList *list, Node *node, bool negative) {
+    if (list->count == list->size) {
+        list->size = list->size == 0 ? LIST_STARTING_SIZE : 2 * list->size;
+        list->arr = realloc(list->arr, list->size * sizeof(WorkItem));
+        assert(list->arr != NULL);
+    }
+    list->arr[list->count++] = (WorkItem) {.node = node,
+                                           .negative = negative};
+}
+
+/**
+ * Adds a monomial to the buffer unless its coefficient is zero.
+ * Takes ownership of the polynomial @p p.
+ * @param b
+ * @param p : coefficient
+ * @param exp : exponent
+ */
+static void Append(MonoBuffer *b, Poly p, poly_exp_t exp) {
+    if (PolyIsZero(&p)) {
+        return;
+    }
+    if (b->count == b->size) {
+        b->size = b->size == 0 ? LIST_STARTING_SIZE : 2 * b->size;
+        b->arr = realloc(b->arr, b->size * sizeof(Mono));
+        assert(b->arr != NULL);
+    }
+    b->arr[b->count++] = (Mono) {.p = p, .exp = exp, .next = NULL};
+}
+
+/**
+ * Adds the monomials of a polynomial to the buffer.
+ * Takes ownership of the polynomial @p p.
+ * @param b
+ * @param p
+ */
+static void AppendPoly(MonoBuffer *b, Poly p) {
+    if (PolyIsCoeff(&p)) {
+        Append(b, p, 0);
+        return;
+    }
+    Mono *m = p.list;
+    while (m != NULL) {
+        Mono *next = m->next;
+        Append(b, m->p, m->exp);
+        free(m);
+        m = next;
+    }
+}
+
+/**
+ * Adds a product to a polynomial in place.
+ * @param acc : polynomial
+ * @param p
+ * @param q
+ * @param negative : whether the product is subtracted
+ */
+static void AddProduct(Poly *acc, const Poly *p, const Poly *q,
+                       bool negative) {
+    if (!negative) {
+        PolyMulAdd(acc, p, q);
+        return;
+    }
+    Poly neg = PolyNeg(p);
+    PolyMulAdd(acc, &neg, q);
+    PolyDestroy(&neg);
+}
+
+/**
+ * Adds the monomials of the value of a node to the buffer. The value is
+ * moved if nothing else can use it.
+ * @param b
+ * @param n : node referenced only by the evaluated sum or shared
+ * @param negative : whether the value is subtracted
+ */
+static void AppendValue(MonoBuffer *b, Node *n, bool negative) {
+    const Poly *v = NodeEval(n);
+    if (negative) {
+        AppendPoly(b, PolyNeg(v));
+    }
+    else if (n->refs == 1 && n->image == NULL) {
+        AppendPoly(b, n->value);
+        n->value = PolyZero();
+    }
+    else {
+        AppendPoly(b, PolyClone(v));
+    }
+}
+
+/**
+ * Splits a node into the terms of a sum. The nodes of additions,
+ * subtractions and negations which aren't shared nor evaluated are split
+ * further. A term is either a product of two nodes, given by its node
+ * which isn't shared nor evaluated, or a value of a node. Nothing is
+ * split while the worker threads are running, so that they evaluate every
+ * node on its own.
+ * @param n : node of NODE_ADD, NODE_SUB, NODE_NEG or NODE_MUL
+ * @param terms : list to which the terms are added
+ */
+static void SplitSum(Node *n, WorkList *terms) {
+    WorkList work = {.arr = NULL, .count = 0, .size = 0};
+    PushWork(&work, n, false);
+    while (work.count > 0) {
+        WorkItem item = work.arr[--work.count];
+        Node *m = item.node;
+        if (m != n && (parallel || IsDone(m) || m->refs > 1 ||
+                       m->op == NODE_AT) ||
+            m->op == NODE_MUL) {
+            PushWork(terms, m, item.negative);
+        }
+        else if (m->op == NODE_NEG) {
+            PushWork(&work, m->args[0], !item.negative);
+        }
+        else {
+            assert(m->op == NODE_ADD || m->op == NODE_SUB);
+            PushWork(&work, m->args[0], item.negative);
+            PushWork(&work, m->args[1], item.negative != (m->op == NODE_SUB));
+        }
+    }
+    free(work.arr);
+}
+
+/**
+ * Checks if a term given by SplitSum is a product. Only the evaluated node
+ * itself is a product while the worker threads are running, the others
+ * may be evaluated by them meanwhile.
+ * @param n : split node
+ * @param term
+ * @return
+ */
+static bool IsProduct(const Node *n, const Node *term) {
+    return term->op == NODE_MUL && !IsDone(term) && (term == n || !parallel);
+}
+
+/**
+ * Finds the nodes whose values are needed to evaluate a node.
+ * @param n : node which isn't evaluated
+ * @param needed : list to which the nodes are added
+ */
+static void Needed(Node *n, WorkList *needed) {
+    if (n->op == NODE_AT) {
+        PushWork(needed, n->args[0], false);
+        return;
+    }
+    WorkList terms = {.arr = NULL, .count = 0, .size = 0};
+    SplitSum(n, &terms);
+    for (size_t i = 0; i < terms.count; i++) {
+        Node *term = terms.arr[i].node;
+        if (IsProduct(n, term)) {
+            PushWork(needed, term->args[0], false);
+            PushWork(needed, term->args[1], false);
+        }
+        else {
+            PushWork(needed, term, false);
+        }
+    }
+    free(terms.arr);
+}
+
+/**
+ * Checks if the value of a sum is too large, because the value of one of
+ * its terms was or it has products and could have more than maxTerms
+ * monomials.
+ * @param n : split node
+ * @param terms : terms given by SplitSum, which are evaluated
+ * @return
+ */
+static bool SumTooLarge(const Node *n, const WorkList *terms) {
+    size_t bound = 0;
+    bool products = false;
+    for (size_t i = 0; i < terms->count; i++) {
+        const Node *term = terms->arr[i].node;
+        size_t size;
+        if (IsProduct(n, term)) {
+            if (term->args[0]->tooLarge || term->args[1]->tooLarge) {
+                return true;
+            }
+            size = PolyMulTermsBound(&term->args[0]->value,
+                                     &term->args[1]->value);
+            products = true;
+        }
+        else {
+            if (term->tooLarge) {
+                return true;
+            }
+            size = PolyMemSize(&term->value) / sizeof(Mono);
+        }
+        bound = size > SIZE_MAX - bound ? SIZE_MAX : bound + size;
+    }
+    return products && bound > maxTerms;
+}
+
+/**
+ * Evaluates a node whose needed nodes are evaluated. The monomials of
+ * the values in a sum are merged together at once and then the products
+ * are added to them in place.
+ * @param n : node which isn't evaluated
+ * @param value : value of the node, zero if it is too large
+ * @return whether the value is too large
+ */
+static bool Evaluate(Node *n, Poly *value) {
+    *value = PolyZero();
+    if (n->op == NODE_AT) {
+        if (n->args[0]->tooLarge) {
+            return true;
+        }
+        *value = PolyAt(&n->args[0]->value, n->x);
+        return false;
+    }
+    MonoBuffer b = {.arr = NULL, .count = 0, .size = 0};
+    WorkList terms = {.arr = NULL, .count = 0, .size = 0};
+    SplitSum(n, &terms);
+    if (SumTooLarge(n, &terms)) {
+        free(terms.arr);
+        return true;
+    }
+    for (size_t i = 0; i < terms.count; i++) {
+        if (!IsProduct(n, terms.arr[i].node)) {
+            AppendValue(&b, terms.arr[i].node, terms.arr[i].negative);
+        }
+    }
+    assert(b.count <= UINT_MAX);
+    Poly r = b.count == 0 ? PolyZero() : PolyAddMonos(b.count, b.arr);
+    free(b.arr);
+    for (size_t i = 0; i < terms.count; i++) {
+        Node *term = terms.arr[i].node;
+        if (IsProduct(n, term)) {
+            AddProduct(&r, &term->args[0]->value, &term->args[1]->value,
+                       terms.arr[i].negative);
+        }
+    }
+    free(terms.arr);
+    *value = r;
+    return false;
+}
+
+/**
+ * Allocates a node.
+ * @param op
+ * @param a
+ * @param b
+ * @param x
+ * @return node with one reference
+ */
+static Node *NewNode(NodeOp op, Node *a, Node *b, poly_coeff_t x) {
+    Node *n = malloc(sizeof(Node));
+    assert(n != NULL);
+    *n = (Node) {.op = op, .refs = 1, .args = {a, b}, .x = x,
+                 .state = NODE_PENDING, .value = PolyZero(), .tooLarge = false,
+                 .image = NULL};
+    return n;
+}
+
+Node *NodeFromPoly(Poly p) {
+    Node *n = NewNode(NODE_VALUE, NULL, NULL, 0);
+    n->state = NODE_DONE;
+    n->value = p;
+    return n;
+}
+
+Node *NodeFromImage(Poly p, Image *image) {
+    Node *n = NodeFromPoly(p);
+    n->image = image;
+    return n;
+}
+
+/**
+ * Checks if a node is known to be equal to a coefficient.
+ * @param n
+ * @param c
+ * @return
+ */
+static bool IsKnownCoeff(const Node *n, poly_coeff_t c) {
+    return IsDone(n) && !n->tooLarge && PolyIsCoeff(&n->value) &&
+           n->value.coeff == c;
+}
+
+/**
+ * Checks if a node is known to be a constant.
+ * @param n
+ * @return
+ */
+static bool IsKnownConst(const Node *n) {
+    return n == NULL || IsDone(n) && !n->tooLarge && PolyIsCoeff(&n->value);
+}
+
+/**
+ * Adds a node to the queue of the worker threads.
+ * @param n
+ */
+static void Enqueue(Node *n) {
+    NodeRetain(n);
+    pthread_mutex_lock(&workers.lock);
+    if (workers.length == workers.size) {
+        size_t size = workers.size == 0 ? LIST_STARTING_SIZE :
+                      2 * workers.size;
+        Node **queue = malloc(size * sizeof(Node *));
+        assert(queue != NULL);
+        for (size_t i = 0; i < workers.length; i++) {
+            queue[i] = workers.queue[(workers.head + i) % workers.size];
+        }
+        free(workers.queue);
+        workers.queue = queue;
+        workers.head = 0;
+        workers.size = size;
+    }
+    workers.queue[(workers.head + workers.length++) % workers.size] = n;
+    pthread_cond_signal(&workers.notEmpty);
+    pthread_mutex_unlock(&workers.lock);
+}
+
+Node *NodeMake(NodeOp op, Node *a, Node *b, poly_coeff_t x) {
+    assert(op != NODE_VALUE);
+    if ((op == NODE_ADD || op == NODE_SUB) && IsKnownCoeff(b, 0) ||
+        op == NODE_NEG && IsKnownCoeff(a, 0) ||
+        op == NODE_MUL && IsKnownCoeff(b, 1)) {
+        if (b != NULL) {
+            NodeRelease(b);
+        }
+        return a;
+    }
+    if (op == NODE_ADD && IsKnownCoeff(a, 0) ||
+        op == NODE_MUL && IsKnownCoeff(a, 1)) {
+        NodeRelease(a);
+        return b;
+    }
+    if (op == NODE_MUL && (IsKnownCoeff(a, 0) || IsKnownCoeff(b, 0))) {
+        /* The other factor is never evaluated. */
+        NodeRelease(a);
+        NodeRelease(b);
+        return NodeFromPoly(PolyZero());
+    }
+    Node *n = NewNode(op, a, b, x);
+    if (IsKnownConst(a) && IsKnownConst(b)) {
+        NodeEval(n);
+    }
+    else if (parallel) {
+        Enqueue(n);
+    }
+    return n;
+}
+
+void NodeRetain(Node *n) {
+    atomic_fetch_add_explicit(&n->refs, 1, memory_order_relaxed);
+}
+
+/**
+ * Deletes the value of a node.
+ * @param n
+ */
+static void FreeValue(Node *n) {
+    if (n->image != NULL) {
+        ImageRelease(n->image);
+        n->image = NULL;
+    }
+    else {
+        PolyDestroy(&n->value);
+    }
+}
+
+void NodeRelease(Node *n) {
+    /* A long chain of nodes would overflow the call stack if it was
+       released recursively. */
+    WorkList work = {.arr = NULL, .count = 0, .size = 0};
+    PushWork(&work, n, false);
+    while (work.count > 0) {
+        Node *m = work.arr[--work.count].node;
+        if (atomic_fetch_sub_explicit(&m->refs, 1,
+                                      memory_order_acq_rel) > 1) {
+            continue;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (m->args[i] != NULL) {
+                PushWork(&work, m->args[i], false);
+            }
+        }
+        FreeValue(m);
+        free(m);
+    }
+    free(work.arr);
+}
+
+void NodeSetMaxTerms(size_t terms) {
+    maxTerms = terms;
+}
+
+/**
+ * Sets the value of a node which was claimed for evaluation and releases
+ * its arguments.
+ * @param n
+ * @param value
+ * @param tooLarge : whether the value was too large
+ */
+static void Finish(Node *n, Poly value, bool tooLarge) {
+    Node *args[2] = {n->args[0], n->args[1]};
+    Lock();
+    n->value = value;
+    n->tooLarge = tooLarge;
+    n->args[0] = n->args[1] = NULL;
+    atomic_store_explicit(&n->state, NODE_DONE, memory_order_release);
+    if (parallel) {
+        pthread_cond_broadcast(&workers.done);
+    }
+    Unlock();
+    for (int i = 0; i < 2; i++) {
+        if (args[i] != NULL) {
+            NodeRelease(args[i]);
+        }
+    }
+}
+
+const Poly *NodeEval(Node *n) {
+    if (IsDone(n)) {
+        return n->tooLarge ? NULL : &n->value;
+    }
+    /* The needed nodes are evaluated first, without recursion, because
+       the expressions may be very deep. A node evaluated by another thread
+       is waited for. The nodes on the work list are referenced by it, as
+       another thread may release them meanwhile. */
+    WorkList work = {.arr = NULL, .count = 0, .size = 0};
+    WorkList needed = {.arr = NULL, .count = 0, .size = 0};
+    NodeRetain(n);
+    PushWork(&work, n, false);
+    while (work.count > 0) {
+        Node *m = work.arr[work.count - 1].node;
+        Lock();
+        while (atomic_load_explicit(&m->state, memory_order_acquire) ==
+               NODE_RUNNING) {
+            pthread_cond_wait(&workers.done, &workers.lock);
+        }
+        if (IsDone(m)) {
+            Unlock();
+            work.count--;
+            NodeRelease(m);
+            continue;
+        }
+        bool ready = true;
+        needed.count = 0;
+        Needed(m, &needed);
+        for (size_t i = 0; i < needed.count; i++) {
+            if (!IsDone(needed.arr[i].node)) {
+                NodeRetain(needed.arr[i].node);
+                PushWork(&work, needed.arr[i].node, false);
+                ready = false;
+            }
+        }
+        if (ready) {
+            atomic_store_explicit(&m->state, NODE_RUNNING,
+                                  memory_order_relaxed);
+        }
+        Unlock();
+        if (ready) {
+            work.count--;
+            Poly value;
+            bool tooLarge = Evaluate(m, &value);
+            Finish(m, value, tooLarge);
+            NodeRelease(m);
+        }
+    }
+    free(work.arr);
+    free(needed.arr);
+    return n->tooLarge ? NULL : &n->value;
+}
+
+bool NodeTooLarge(const Node *n) {
+    return IsDone(n) && n->tooLarge;
+}
+
+Poly NodeTake(Node *n) {
+    const Poly *v = NodeEval(n);
+    assert(v != NULL);
+    (void) v;
+    Poly p;
+    if (n->refs == 1 && n->image == NULL) {
+        p = n->value;
+        n->value = PolyZero();
+    }
+    else {
+        p = PolyClone(&n->value);
+    }
+    NodeRelease(n);
+    return p;
+}
+
+/**
+ * Evaluates the queued nodes until the worker threads are stopped.
+ * @param arg : unused
+ * @return NULL
+ */
+static void *Work(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&workers.lock);
+    for (;;) {
+        while (workers.length == 0 && !workers.stopping) {
+            pthread_cond_wait(&workers.notEmpty, &workers.lock);
+        }
+        if (workers.stopping) {
+            break;
+        }
+        Node *n = workers.queue[workers.head];
+        workers.head = (workers.head + 1) % workers.size;
+        workers.length--;
+        pthread_mutex_unlock(&workers.lock);
+        /* A node referenced only by the queue isn't needed any more. */
+        if (atomic_load_explicit(&n->refs, memory_order_acquire) > 1) {
+            NodeEval(n);
+        }
+        NodeRelease(n);
+        pthread_mutex_lock(&workers.lock);
+    }
+    pthread_mutex_unlock(&workers.lock);
+    return NULL;
+}
+
+bool NodeStartWorkers(size_t threads) {
+    assert(!parallel && threads > 0);
+    workers = (Workers) {.threads = malloc(threads * sizeof(pthread_t)),
+                         .count = 0, .queue = NULL, .head = 0, .length = 0,
+                         .size = 0, .stopping = false};
+    assert(workers.threads != NULL);
+    pthread_mutex_init(&workers.lock, NULL);
+    pthread_cond_init(&workers.notEmpty, NULL);
+    pthread_cond_init(&workers.done, NULL);
+    parallel = true;
+    while (workers.count < threads) {
+        if (pthread_create(&workers.threads[workers.count], NULL, Work,
+                           NULL) != 0) {
+            NodeStopWorkers();
+            return true;
+        }
+        workers.count++;
+    }
+    return false;
+}
+
+void NodeStopWorkers() {
+    if (!parallel) {
+        return;
+    }
+    pthread_mutex_lock(&workers.lock);
+    workers.stopping = true;
+    pthread_cond_broadcast(&workers.notEmpty);
+    pthread_mutex_unlock(&workers.lock);
+    for (size_t i = 0; i < workers.count; i++) {
+        pthread_join(workers.threads[i], NULL);
+    }
+    parallel = false;
+    for (; workers.length > 0; workers.length--) {
+        NodeRelease(workers.queue[workers.head]);
+        workers.head = (workers.head + 1) % workers.size;
+    }
+    free(workers.queue);
+    free(workers.threads);
+    pthread_cond_destroy(&workers.done);
+    pthread_cond_destroy(&workers.notEmpty);
+    pthread_mutex_destroy(&workers.lock);
+}
@@ -0,0 +1,150 @@
+/** @file
+   Interface of the lazy expressions of polynomials
+
+   An expression is a directed acyclic graph of nodes, which are evaluated
+   only when their value is needed and at most once. Nodes which are
+   deleted before that are never evaluated. A sum of nodes which aren't
+   shared, with products among its terms, is evaluated at once: the
+   monomials of the terms are merged together and the products are added
+   to them in place, without building the intermediate polynomials.
+   Operations with constant arguments are folded when the node is made.
+
+   The nodes can also be evaluated by worker threads, as soon as they are
+   made and their arguments are evaluated, so the independent nodes are
+   evaluated in parallel. Every node is evaluated on its own then.
+
+   The size of a value with products is bounded once its arguments are
+   evaluated. A value which could be too large isn't computed, and neither
+   are the values of the nodes using it.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#ifndef __LAZY_POLY_H__
+#define __LAZY_POLY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "poly.h"
+#include "image_poly.h"
+
+/**
+ * Enumerates operations of the nodes.
+ */
+typedef enum node_op {
+    NODE_VALUE, NODE_ADD, NODE_SUB, NODE_MUL, NODE_NEG, NODE_AT
+} NodeOp;
+
+/**
+ * Enumerates states of the evaluation of the nodes.
+ */
+typedef enum node_state {
+    NODE_PENDING, NODE_RUNNING, NODE_DONE
+} NodeState;
+
+/**
+ * Structure containing a node of an expression.
+ */
+typedef struct node {
+    NodeOp op; ///< operation
+    atomic_ulong refs; ///< number of references to the node, which may be
+                       ///< changed by the worker threads
+    struct node *args[2]; ///< arguments, NULL if there are fewer of them
+    poly_coeff_t x; ///< point of NODE_AT
+    atomic_int state; ///< NodeState, the arguments are released when
+                      ///< the node is done
+    Poly value; ///< value, valid if the node is done
+    bool tooLarge; ///< whether the value was too large to be computed,
+                   ///< valid if the node is done
+    Image *image; ///< image holding the value or NULL if it is owned
+} Node;
+
+/**
+ * Makes an evaluated node. Takes ownership of the polynomial @p p.
+ * The returned node has one reference.
+ * @param[in] p : polynomial
+ * @return node
+ */
+Node *NodeFromPoly(Poly p);
+
+/**
+ * Makes an evaluated node with a polynomial held by an image.
+ * Takes the reference to the image. The returned node has one reference.
+ * @param[in] p : polynomial held by the image
+ * @param[in] image : image
+ * @return node
+ */
+Node *NodeFromImage(Poly p, Image *image);
+
+/**
+ * Makes a node of an operation. Takes the references to the arguments.
+ * The returned node has one reference.
+ * @param[in] op : operation other than NODE_VALUE
+ * @param[in] a : first argument
+ * @param[in] b : second argument or NULL for NODE_NEG and NODE_AT
+ * @param[in] x : point of NODE_AT
+ * @return node
+ */
+Node *NodeMake(NodeOp op, Node *a, Node *b, poly_coeff_t x);
+
+/**
+ * Adds a reference to the node.
+ * @param[in] n : node
+ */
+void NodeRetain(Node *n);
+
+/**
+ * Removes a reference to the node. Deletes it with the nodes which aren't
+ * referenced any more when it was the last one.
+ * @param[in] n : node
+ */
+void NodeRelease(Node *n);
+
+/**
+ * Sets the largest number of the monomials of a value with products,
+ * bounded as by PolyMulTermsBound. It is SIZE_MAX by default, which
+ * doesn't bound the values.
+ * @param[in] terms : largest number of the monomials
+ */
+void NodeSetMaxTerms(size_t terms);
+
+/**
+ * Evaluates the node if it isn't evaluated yet.
+ * @param[in] n : node
+ * @return value of the node, valid as long as the node, NULL if it was
+ *         too large
+ */
+const Poly *NodeEval(Node *n);
+
+/**
+ * Checks if the node is evaluated and its value was too large.
+ * @param[in] n : node
+ * @return whether the value of the node wasn't computed
+ */
+bool NodeTooLarge(const Node *n);
+
+/**
+ * Evaluates the node and removes a reference to it.
+ * The value is moved out of the node if it was the last reference.
+ * @param[in] n : node whose value isn't too large
+ * @return value of the node
+ */
+Poly NodeTake(Node *n);
+
+/**
+ * Starts the worker threads which evaluate every node made afterwards.
+ * @param[in] threads : number of threads
+ * @return true if the threads couldn't be started, false otherwise
+ */
+bool NodeStartWorkers(size_t threads);
+
+/**
+ * Stops the worker threads. The nodes which they didn't evaluate are
+ * evaluated when their value is needed.
+ */
+void NodeStopWorkers();
+
+#endif /* __LAZY_POLY_H__ */
@@ -0,0 +1,134 @@
+/** @file
+   Implementation of the buffered output of the polynomial calculator
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-27
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include "output_poly.h"
+#include "parse_poly.h"
+#include "utils.h"
+
+_Thread_local Output calcOutput;
+
+/**
+ * Decimal notation of all numbers with two digits.
+ */
+static const char twoDigits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+void OutputOpen(int fd) {
+    calcOutput.buf = malloc(OUTPUT_BUFFER_SIZE);
+    assert(calcOutput.buf != NULL);
+    calcOutput.length = 0;
+    calcOutput.fd = fd;
+    calcOutput.lineBuffered = isatty(fd);
+}
+
+void OutputClose() {
+    OutputFlush();
+    free(calcOutput.buf);
+    calcOutput.buf = NULL;
+}
+
+void OutputFlush() {
+#ifdef UNIT_TESTING
+    /* The standard output is mocked by printf. */
+    if (calcOutput.length > 0) {
+        printf("%.*s", (int) calcOutput.length, calcOutput.buf);
+    }
+#else
+    const char *data = calcOutput.buf;
+    size_t left = calcOutput.length;
+    while (left > 0) {
+        ssize_t n = write(calcOutput.fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* Nobody reads the output anymore. */
+            break;
+        }
+        data += n;
+        left -= n;
+    }
+#endif /* UNIT_TESTING */
+    calcOutput.length = 0;
+}
+
+void OutputString(const char *s) {
+    for (; *s != '\0'; s++) {
+        OutputPutc(*s);
+    }
+}
+
+void OutputUnsigned(unsigned long n) {
+    if (OUTPUT_BUFFER_SIZE - calcOutput.length < OUTPUT_MAX_NUMBER_LENGTH) {
+        OutputFlush();
+    }
+    char digits[OUTPUT_MAX_NUMBER_LENGTH];
+    char *d = digits + OUTPUT_MAX_NUMBER_LENGTH;
+    while (n >= 100) {
+        d -= 2;
+        memcpy(d, &twoDigits[2 * (n % 100)], 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        d -= 2;
+        memcpy(d, &twoDigits[2 * n], 2);
+    }
+    else {
+        *--d = '0' + n;
+    }
+    size_t length = digits + OUTPUT_MAX_NUMBER_LENGTH - d;
+    memcpy(calcOutput.buf + calcOutput.length, d, length);
+    calcOutput.length += length;
+}
+
+void OutputLong(long n) {
+    if (n < 0) {
+        OutputPutc('-');
+        /* The magnitude of LONG_MIN doesn't fit in long. */
+        OutputUnsigned(-(unsigned long) n);
+    }
+    else {
+        OutputUnsigned(n);
+    }
+}
+
+void OutputPoly(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        OutputLong(p->coeff);
+        return;
+    }
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        if (m != p->list) {
+            OutputPutc(POLY_MONO_SEPARATOR);
+        }
+        OutputMono(m);
+    }
+}
+
+void OutputMono(const Mono *m) {
+    OutputPutc(POLY_OPENING_SEPARATOR);
+    OutputPoly(&m->p);
+    OutputPutc(POLY_COEFF_EXP_SEPARATOR);
+    OutputLong(m->exp);
+    OutputPutc(POLY_CLOSING_SEPARATOR);
+}
+
+void OutputEndLine() {
+    OutputPutc('\n');
+    if (calcOutput.lineBuffered) {
+        OutputFlush();
+    }
+}
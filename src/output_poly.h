@@ -0,0 +1,99 @@
+/** @file
+   Interface of the buffered output of the polynomial calculator
+
+   The output is collected in a large buffer and written in big blocks.
+   If the output is a terminal, it is written at the end of every line.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-27
+*/
+
+#ifndef __OUTPUT_POLY_H__
+#define __OUTPUT_POLY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "poly.h"
+
+/** size of the output buffer */
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+/** maximal number of characters of a printed integer */
+#define OUTPUT_MAX_NUMBER_LENGTH 20
+
+/**
+ * Structure containing the state of the output
+ */
+typedef struct output {
+    char *buf; ///< characters which aren't written yet
+    size_t length; ///< number of characters in the buffer
+    int fd; ///< file descriptor of the output
+    bool lineBuffered; ///< whether every line is written at once
+} Output;
+
+/** Output of the calculator, separate in every thread. */
+extern _Thread_local Output calcOutput;
+
+/**
+ * Starts writing the output to a file descriptor.
+ * @param[in] fd : file descriptor
+ */
+void OutputOpen(int fd);
+
+/**
+ * Writes the rest of the output and releases its resources.
+ */
+void OutputClose();
+
+/**
+ * Writes the characters collected in the buffer.
+ */
+void OutputFlush();
+
+/**
+ * Adds a character to the output.
+ * @param[in] c : character
+ */
+static inline void OutputPutc(char c) {
+    if (calcOutput.length == OUTPUT_BUFFER_SIZE) {
+        OutputFlush();
+    }
+    calcOutput.buf[calcOutput.length++] = c;
+}
+
+/**
+ * Adds a string to the output.
+ * @param[in] s : string
+ */
+void OutputString(const char *s);
+
+/**
+ * Adds an integer in the decimal notation to the output.
+ * @param[in] n : integer
+ */
+void OutputLong(long n);
+
+/**
+ * Adds an unsigned integer in the decimal notation to the output.
+ * @param[in] n : integer
+ */
+void OutputUnsigned(unsigned long n);
+
+/**
+ * Adds a polynomial in the notation of the calculator to the output.
+ * @param[in] p : polynomial
+ */
+void OutputPoly(const Poly *p);
+
+/**
+ * Adds a monomial in the notation of the calculator to the output.
+ * @param[in] m : monomial
+ */
+void OutputMono(const Mono *m);
+
+/**
+ * Ends the line of the output.
+ */
+void OutputEndLine();
+
+#endif /* __OUTPUT_POLY_H__ */
@@ -0,0 +1,463 @@
+/** @file
+   Implementation of the packed files of polynomials
+
+   A polynomial is written in prefix order: the number of its monomials
+   followed either by the coefficient (if there are no monomials) or by
+   the difference of the exponent from the previous one, decreased by one,
+   and the coefficient polynomial of every monomial. All numbers are varints
+   of 7 bits per byte, the coefficients are zig-zag encoded first.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-30
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "pack_poly.h"
+
+/** identifier at the beginning of every packed file */
+#define PACK_MAGIC "POLYPAK"
+/** flag of a packed file compressed with zlib */
+#define PACK_FLAG_ZLIB 1u
+/** size of the blocks of encoded and compressed bytes */
+#define PACK_BLOCK_SIZE (1 << 16)
+/** maximal number of bytes of a varint */
+#define PACK_MAX_VARINT 10
+/** maximal depth of the nested polynomials of a read file */
+#define PACK_MAX_DEPTH 4096
+
+/**
+ * Structure containing the beginning of a packed file
+ */
+typedef struct pack_header {
+    char magic[8]; ///< PACK_MAGIC
+    uint32_t version; ///< PACK_VERSION
+    uint32_t flags; ///< PACK_FLAG_ZLIB or 0
+} PackHeader;
+
+/**
+ * Structure containing the state of writing a packed file
+ */
+typedef struct pack_writer {
+    FILE *f; ///< packed file
+    unsigned char *buf; ///< block of encoded bytes
+    size_t length; ///< number of bytes in the block
+    bool compress; ///< whether the blocks are compressed
+    bool error; ///< whether writing failed
+#ifdef HAVE_ZLIB
+    z_stream z; ///< state of the compression
+    unsigned char *out; ///< block of compressed bytes
+#endif
+} PackWriter;
+
+/**
+ * Structure containing the state of reading a packed file
+ */
+typedef struct pack_reader {
+    FILE *f; ///< packed file
+    unsigned char *buf; ///< block of encoded bytes
+    size_t pos; ///< position of the next byte in the block
+    size_t length; ///< number of bytes in the block
+    bool compress; ///< whether the blocks are compressed
+    bool end; ///< whether the end of the compressed stream was read
+#ifdef HAVE_ZLIB
+    z_stream z; ///< state of the decompression
+    unsigned char *in; ///< block of compressed bytes
+#endif
+} PackReader;
+
+/**
+ * Maps a signed coefficient to an unsigned number, so the numbers
+ * of small absolute values are small.
+ * @param c
+ * @return
+ */
+static inline uint64_t ZigZag(poly_coeff_t c) {
+    return (uint64_t) c << 1 ^ (c < 0 ? UINT64_MAX : 0);
+}
+
+/**
+ * Reverses ZigZag.
+ * @param u
+ * @return
+ */
+static inline poly_coeff_t UnZigZag(uint64_t u) {
+    return (poly_coeff_t) (u >> 1 ^ (u & 1 ? UINT64_MAX : 0));
+}
+
+bool PackCanCompress(void) {
+#ifdef HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Writes the block of encoded bytes to the file.
+ * @param w
+ * @param finish : whether it is the last block
+ */
+static void WriteBlock(PackWriter *w, bool finish) {
+    if (!w->compress) {
+        if (fwrite(w->buf, 1, w->length, w->f) != w->length) {
+            w->error = true;
+        }
+        w->length = 0;
+        return;
+    }
+#ifdef HAVE_ZLIB
+    w->z.next_in = w->buf;
+    w->z.avail_in = w->length;
+    int ret;
+    do {
+        w->z.next_out = w->out;
+        w->z.avail_out = PACK_BLOCK_SIZE;
+        ret = deflate(&w->z, finish ? Z_FINISH : Z_NO_FLUSH);
+        size_t length = PACK_BLOCK_SIZE - w->z.avail_out;
+        if (ret == Z_STREAM_ERROR ||
+            fwrite(w->out, 1, length, w->f) != length) {
+            w->error = true;
+            break;
+        }
+    } while (w->z.avail_out == 0 || finish && ret != Z_STREAM_END);
+#else
+    (void) finish;
+#endif
+    w->length = 0;
+}
+
+/**
+ * Writes a varint.
+ * @param w
+ * @param value
+ */
+static inline void WriteVarint(PackWriter *w, uint64_t value) {
+    if (w->length + PACK_MAX_VARINT > PACK_BLOCK_SIZE) {
+        WriteBlock(w, false);
+    }
+    while (value >= 0x80) {
+        w->buf[w->length++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    w->buf[w->length++] = (unsigned char) value;
+}
+
+/**
+ * Writes a polynomial.
+ * @param w
+ * @param p
+ */
+static void WritePoly(PackWriter *w, const Poly *p) {
+    uint64_t count = 0;
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        count++;
+    }
+    WriteVarint(w, count);
+    if (count == 0) {
+        WriteVarint(w, ZigZag(p->coeff));
+        return;
+    }
+    int64_t last = -1;
+    for (const Mono *m = p->list; m != NULL; m = m->next) {
+        WriteVarint(w, (uint64_t) (m->exp - last - 1));
+        last = m->exp;
+        WritePoly(w, &m->p);
+    }
+}
+
+/**
+ * Creates a packed file and writes its header.
+ * @param w : state of writing, initialized by the function
+ * @param path
+ * @param compress
+ * @return true if the file couldn't be created, false otherwise
+ */
+static bool PackOpen(PackWriter *w, const char *path, bool compress) {
+    if (compress && !PackCanCompress()) {
+        return true;
+    }
+    /* The old file may be a loaded image, which can't be truncated. */
+    unlink(path);
+    *w = (PackWriter) {.f = fopen(path, "wb"), .length = 0,
+                       .compress = compress, .error = false};
+    if (w->f == NULL) {
+        return true;
+    }
+    PackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.flags = compress ? PACK_FLAG_ZLIB : 0;
+    if (fwrite(&header, sizeof(header), 1, w->f) != 1) {
+        w->error = true;
+    }
+    w->buf = malloc(PACK_BLOCK_SIZE);
+    assert(w->buf != NULL);
+#ifdef HAVE_ZLIB
+    if (compress) {
+        memset(&w->z, 0, sizeof(w->z));
+        bool error = deflateInit(&w->z, Z_DEFAULT_COMPRESSION) != Z_OK;
+        assert(!error);
+        (void) error;
+        w->out = malloc(PACK_BLOCK_SIZE);
+        assert(w->out != NULL);
+    }
+#endif
+    return false;
+}
+
+/**
+ * Writes the last block of a packed file and closes it.
+ * @param w
+ * @return true if the file couldn't be written, false otherwise
+ */
+static bool PackClose(PackWriter *w) {
+    WriteBlock(w, true);
+#ifdef HAVE_ZLIB
+    if (w->compress) {
+        deflateEnd(&w->z);
+        free(w->out);
+    }
+#endif
+    free(w->buf);
+    if (fclose(w->f) != 0) {
+        w->error = true;
+    }
+    return w->error;
+}
+
+bool PackSave(const char *path, const Poly *p, bool compress) {
+    PackWriter w;
+    if (PackOpen(&w, path, compress)) {
+        return true;
+    }
+    WritePoly(&w, p);
+    return PackClose(&w);
+}
+
+bool PackSaveProduct(const char *path, const Poly *p, const Poly *q,
+                     bool compress) {
+    PolyProductIter it;
+    Mono m;
+    uint64_t count = 0;
+    Poly constant = PolyZero();
+    PolyProductBegin(&it, p, q);
+    while (PolyProductNext(&it, &m)) {
+        if (count++ == 0 && m.exp == 0 && PolyIsCoeff(&m.p)) {
+            constant = m.p;
+        }
+        PolyDestroy(&m.p);
+    }
+    PolyProductEnd(&it);
+    /* A product with one monomial of the exponent 0 may be a constant. */
+    if (count == 0 || count == 1 && !PolyIsZero(&constant)) {
+        return PackSave(path, &constant, compress);
+    }
+    PackWriter w;
+    if (PackOpen(&w, path, compress)) {
+        return true;
+    }
+    WriteVarint(&w, count);
+    int64_t last = -1;
+    PolyProductBegin(&it, p, q);
+    while (PolyProductNext(&it, &m)) {
+        WriteVarint(&w, (uint64_t) (m.exp - last - 1));
+        last = m.exp;
+        WritePoly(&w, &m.p);
+        PolyDestroy(&m.p);
+    }
+    PolyProductEnd(&it);
+    return PackClose(&w);
+}
+
+/**
+ * Reads the next block of encoded bytes from the file.
+ * @param r
+ * @return true if there are no more bytes, false otherwise
+ */
+static bool ReadBlock(PackReader *r) {
+    r->pos = 0;
+    if (!r->compress) {
+        r->length = fread(r->buf, 1, PACK_BLOCK_SIZE, r->f);
+        return r->length == 0;
+    }
+#ifdef HAVE_ZLIB
+    r->z.next_out = r->buf;
+    r->z.avail_out = PACK_BLOCK_SIZE;
+    while (r->z.avail_out == PACK_BLOCK_SIZE && !r->end) {
+        if (r->z.avail_in == 0) {
+            r->z.next_in = r->in;
+            r->z.avail_in = fread(r->in, 1, PACK_BLOCK_SIZE, r->f);
+            if (r->z.avail_in == 0) {
+                break;
+            }
+        }
+        int ret = inflate(&r->z, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            r->end = true;
+        }
+        else if (ret != Z_OK) {
+            break;
+        }
+    }
+    r->length = PACK_BLOCK_SIZE - r->z.avail_out;
+#else
+    r->length = 0;
+#endif
+    return r->length == 0;
+}
+
+/**
+ * Reads the next encoded byte.
+ * @param r
+ * @return byte or EOF if there are no more bytes
+ */
+static inline int ReadByte(PackReader *r) {
+    if (r->pos == r->length && ReadBlock(r)) {
+        return EOF;
+    }
+    return r->buf[r->pos++];
+}
+
+/**
+ * Reads a varint.
+ * @param r
+ * @param value
+ * @return true if there is no correct varint, false otherwise
+ */
+static bool ReadVarint(PackReader *r, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 7 * PACK_MAX_VARINT; shift += 7) {
+        int c = ReadByte(r);
+        if (c == EOF || shift == 7 * (PACK_MAX_VARINT - 1) && c > 1) {
+            return true;
+        }
+        *value |= (uint64_t) (c & 0x7F) << shift;
+        if (c < 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads a polynomial and checks that it is in the canonical form.
+ * @param r
+ * @param p
+ * @param depth : number of the polynomials containing the read one
+ * @return true if there is no correct polynomial or it is nested too deep,
+ * false otherwise
+ */
+static bool ReadPoly(PackReader *r, Poly *p, unsigned depth) {
+    uint64_t count, value;
+    *p = PolyZero();
+    if (ReadVarint(r, &count) || count > 0 && depth == PACK_MAX_DEPTH) {
+        return true;
+    }
+    if (count == 0) {
+        if (ReadVarint(r, &value)) {
+            return true;
+        }
+        p->coeff = UnZigZag(value);
+        return false;
+    }
+    Mono **last = &p->list;
+    int64_t exp = -1;
+    for (uint64_t i = 0; i < count; i++) {
+        if (ReadVarint(r, &value) || value > INT_MAX ||
+            exp + 1 + (int64_t) value > INT_MAX) {
+            PolyDestroy(p);
+            return true;
+        }
+        exp += 1 + (int64_t) value;
+        Mono *m = malloc(sizeof(Mono));
+        assert(m != NULL);
+        *m = (Mono) {.p = PolyZero(), .exp = exp, .next = NULL};
+        *last = m;
+        last = &m->next;
+        if (ReadPoly(r, &m->p, depth + 1) || PolyIsZero(&m->p)) {
+            PolyDestroy(p);
+            return true;
+        }
+    }
+    if (count == 1 && exp == 0 && PolyIsCoeff(&p->list->p)) {
+        PolyDestroy(p);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Reads the header of a packed file.
+ * @param f
+ * @param header
+ * @return true if the file doesn't start like a packed file, false otherwise
+ */
+static bool ReadHeader(FILE *f, PackHeader *header) {
+    return fread(header, sizeof(*header), 1, f) != 1 ||
+           memcmp(header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0;
+}
+
+bool PackIsPacked(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    PackHeader header;
+    bool packed = !ReadHeader(f, &header);
+    fclose(f);
+    return packed;
+}
+
+bool PackLoad(const char *path, Poly *p) {
+    PackReader r = {.f = fopen(path, "rb"), .pos = 0, .length = 0,
+                    .end = false};
+    if (r.f == NULL) {
+        return true;
+    }
+    PackHeader header;
+    if (ReadHeader(r.f, &header) || header.version != PACK_VERSION ||
+        (header.flags & ~PACK_FLAG_ZLIB) != 0 ||
+        (header.flags & PACK_FLAG_ZLIB) != 0 && !PackCanCompress()) {
+        fclose(r.f);
+        return true;
+    }
+    r.compress = (header.flags & PACK_FLAG_ZLIB) != 0;
+    r.buf = malloc(PACK_BLOCK_SIZE);
+    assert(r.buf != NULL);
+#ifdef HAVE_ZLIB
+    if (r.compress) {
+        memset(&r.z, 0, sizeof(r.z));
+        bool error = inflateInit(&r.z) != Z_OK;
+        assert(!error);
+        (void) error;
+        r.in = malloc(PACK_BLOCK_SIZE);
+        assert(r.in != NULL);
+    }
+#endif
+    bool error = ReadPoly(&r, p, 0);
+    /* The polynomial has to take the whole file. */
+    if (!error && (ReadByte(&r) != EOF || r.compress && !r.end)) {
+        PolyDestroy(p);
+        error = true;
+    }
+#ifdef HAVE_ZLIB
+    if (r.compress) {
+        inflateEnd(&r.z);
+        free(r.in);
+    }
+#endif
+    free(r.buf);
+    fclose(r.f);
+    return error;
+}
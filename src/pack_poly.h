@@ -0,0 +1,65 @@
+/** @file
+   Interface of the packed files of polynomials
+
+   A packed file stores the exponents of every polynomial as the differences
+   between consecutive exponents and the coefficients as zig-zag varints.
+   The encoded bytes may be compressed with zlib in blocks.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-30
+*/
+
+#ifndef __PACK_POLY_H__
+#define __PACK_POLY_H__
+
+#include <stdbool.h>
+#include "poly.h"
+
+/** version of the format of the packed files */
+#define PACK_VERSION 1
+
+/**
+ * Checks if the compression of the packed files is available.
+ * @return true if the program was built with zlib, false otherwise
+ */
+bool PackCanCompress(void);
+
+/**
+ * Writes a polynomial to a packed file.
+ * @param[in] path : path of the file
+ * @param[in] p : polynomial
+ * @param[in] compress : whether the file is compressed
+ * @return true if the file couldn't be written, false otherwise
+ */
+bool PackSave(const char *path, const Poly *p, bool compress);
+
+/**
+ * Writes the product of two polynomials to a packed file without building
+ * the product. The monomials of the product are computed twice, first
+ * to count them and then to write them.
+ * @param[in] path : path of the file
+ * @param[in] p : polynomial
+ * @param[in] q : polynomial
+ * @param[in] compress : whether the file is compressed
+ * @return true if the file couldn't be written, false otherwise
+ */
+bool PackSaveProduct(const char *path, const Poly *p, const Poly *q,
+                     bool compress);
+
+/**
+ * Checks if a file starts like a packed file.
+ * @param[in] path : path of the file
+ * @return true if the file is a packed file, false otherwise
+ */
+bool PackIsPacked(const char *path);
+
+/**
+ * Reads a polynomial from a packed file.
+ * @param[in] path : path of the file
+ * @param[out] p : polynomial
+ * @return true if the file isn't a correct packed file, false otherwise
+ */
+bool PackLoad(const char *path, Poly *p);
+
+#endif /* __PACK_POLY_H__ */
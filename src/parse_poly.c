@@ -0,0 +1,407 @@
+/** @file
+   Implementation of the parser of polynomials
+
+   The parser reads a line in a single pass, without recursion. It is driven
+   by a table of transitions over classes of characters. Monomials of all
+   polynomials which are being read are kept in one shared vector, every
+   polynomial which isn't finished yet owns a frame pointing at the beginning
+   of its part of the vector.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-26
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include "parse_poly.h"
+#include "input_poly.h"
+
+/** number of monomials kept without allocating memory */
+#define MONOS_STARTING_SIZE 32
+/** number of frames kept without allocating memory */
+#define FRAMES_STARTING_SIZE 16
+/** number by which the sizes of the vectors are multiplicated */
+#define VECTOR_SIZE_MULTIPLICATION 2
+
+/**
+ * Enumerates classes of characters.
+ */
+typedef enum CharClass {
+    CLASS_OPEN, CLASS_CLOSE, CLASS_COMMA, CLASS_PLUS, CLASS_MINUS, CLASS_DIGIT,
+    CLASS_END, CLASS_OTHER, NUM_OF_CLASSES
+} CharClass;
+
+/**
+ * Enumerates states of the parser, named after the expected part of a line.
+ */
+typedef enum ParseState {
+    STATE_START, ///< beginning of the line
+    STATE_MONO, ///< monomial after `+`
+    STATE_COEFF, ///< coefficient after `(`
+    STATE_COMMA, ///< separator after a number being a coefficient
+    STATE_EXP, ///< exponential after `,`
+    STATE_CLOSE, ///< end of a monomial after its exponential
+    STATE_NEXT, ///< anything that can follow a monomial
+    STATE_END, ///< end of the line after a constant polynomial
+    NUM_OF_STATES
+} ParseState;
+
+/**
+ * Enumerates actions of the parser.
+ */
+typedef enum ParseAction {
+    ACTION_ERROR, ///< the character is incorrect
+    ACTION_OPEN_POLY, ///< starts a polynomial with its first monomial
+    ACTION_OPEN_MONO, ///< starts a next monomial
+    ACTION_CONST, ///< reads a constant polynomial being the whole line
+    ACTION_COEFF, ///< reads a number being a coefficient
+    ACTION_COMMA, ///< skips the separator
+    ACTION_EXP, ///< reads an exponential
+    ACTION_CLOSE, ///< adds the monomial to its polynomial
+    ACTION_PLUS, ///< skips the separator
+    ACTION_END_COEFF, ///< finishes a polynomial being a coefficient
+    ACTION_END_LINE ///< finishes the line
+} ParseAction;
+
+/**
+ * Transitions of the parser for every state and class of character.
+ * Missing entries are errors.
+ */
+static const unsigned char transitions[NUM_OF_STATES][NUM_OF_CLASSES] = {
+    [STATE_START] = {[CLASS_OPEN] = ACTION_OPEN_POLY,
+                     [CLASS_MINUS] = ACTION_CONST,
+                     [CLASS_DIGIT] = ACTION_CONST},
+    [STATE_MONO] = {[CLASS_OPEN] = ACTION_OPEN_MONO},
+    [STATE_COEFF] = {[CLASS_OPEN] = ACTION_OPEN_POLY,
+                     [CLASS_MINUS] = ACTION_COEFF,
+                     [CLASS_DIGIT] = ACTION_COEFF},
+    [STATE_COMMA] = {[CLASS_COMMA] = ACTION_COMMA},
+    [STATE_EXP] = {[CLASS_DIGIT] = ACTION_EXP},
+    [STATE_CLOSE] = {[CLASS_CLOSE] = ACTION_CLOSE},
+    [STATE_NEXT] = {[CLASS_PLUS] = ACTION_PLUS,
+                    [CLASS_COMMA] = ACTION_END_COEFF,
+                    [CLASS_END] = ACTION_END_LINE},
+    [STATE_END] = {[CLASS_END] = ACTION_END_LINE}
+};
+
+/**
+ * Structure containing a polynomial which isn't finished yet
+ */
+typedef struct parse_frame {
+    size_t start; ///< index of its first monomial in the shared vector
+    bool sorted; ///< whether the exponentials are increasing so far
+    poly_exp_t lastExp; ///< exponential of its last monomial
+} ParseFrame;
+
+/**
+ * Structure containing the state of the parser
+ */
+typedef struct parser {
+    Mono *monos; ///< monomials of the unfinished polynomials
+    size_t count; ///< number of monomials
+    size_t size; ///< number of allocated monomials
+    ParseFrame *frames; ///< unfinished polynomials, the innermost is the last
+    size_t depth; ///< number of unfinished polynomials
+    size_t framesSize; ///< number of allocated frames
+    Poly coeff; ///< coefficient of the current monomial
+    bool hasCoeff; ///< whether the coefficient was already read
+    int column; ///< column of the current character
+} Parser;
+
+/**
+ * Returns the class of a character.
+ * @param c
+ * @return
+ */
+static inline CharClass ClassOf(int c) {
+    switch (c) {
+        case POLY_OPENING_SEPARATOR: return CLASS_OPEN;
+        case POLY_CLOSING_SEPARATOR: return CLASS_CLOSE;
+        case POLY_COEFF_EXP_SEPARATOR: return CLASS_COMMA;
+        case POLY_MONO_SEPARATOR: return CLASS_PLUS;
+        case '-': return CLASS_MINUS;
+        case '\n': case EOF: return CLASS_END;
+        default:
+            return c >= '0' && c <= '9' ? CLASS_DIGIT : CLASS_OTHER;
+    }
+}
+
+/**
+ * Reads the next character of the line.
+ * @param ps
+ * @return
+ */
+static inline int Next(Parser *ps) {
+    ps->column++;
+    return InputGetc();
+}
+
+/**
+ * Makes room for one more element of a vector. The first array of the vector
+ * is given by the caller and isn't freed.
+ * @param arr : array of the vector
+ * @param size : number of allocated elements
+ * @param elemSize : size of an element
+ * @param initial : first array of the vector
+ */
+static void GrowVector(void **arr, size_t *size, size_t elemSize,
+                       void *initial) {
+    size_t newSize = *size * VECTOR_SIZE_MULTIPLICATION;
+    void *newArr;
+    if (*arr == initial) {
+        newArr = malloc(newSize * elemSize);
+        assert(newArr != NULL);
+        memcpy(newArr, *arr, *size * elemSize);
+    }
+    else {
+        newArr = realloc(*arr, newSize * elemSize);
+        assert(newArr != NULL);
+    }
+    *arr = newArr;
+    *size = newSize;
+}
+
+/**
+ * Reads a coefficient, the first character of which was already read.
+ * Whole numbers are read at once if possible, otherwise digit by digit.
+ * @param ps
+ * @param c : first character, replaced with the one after the number
+ * @param coeff
+ * @return true if the number is incorrect or too big, false otherwise
+ */
+static bool ReadCoeff(Parser *ps, int *c, poly_coeff_t *coeff) {
+    bool negative = *c == '-';
+    if (negative) {
+        *c = Next(ps);
+        if (ClassOf(*c) != CLASS_DIGIT) {
+            return true;
+        }
+    }
+    uint64_t value, max = negative ? (uint64_t) LONG_MAX + 1 : LONG_MAX;
+    InputUngetc(*c);
+    int digits = InputDigits(max, &value);
+    if (digits > 0) {
+        ps->column += digits - 1;
+        *coeff = negative ? -(poly_coeff_t) (value - 1) - 1 :
+                 (poly_coeff_t) value;
+        *c = Next(ps);
+        return false;
+    }
+    *c = InputGetc();
+    /* The number is accumulated as a negative one, which covers LONG_MIN.
+     * The error is reported at the digit which makes it too big. */
+    poly_coeff_t number = 0, limit = negative ? LONG_MIN : -LONG_MAX;
+    while (*c >= '0' && *c <= '9') {
+        int digit = *c - '0';
+        if (number < limit / 10 || number * 10 < limit + digit) {
+            return true;
+        }
+        number = number * 10 - digit;
+        *c = Next(ps);
+    }
+    if (!negative) {
+        number = -number;
+    }
+    *coeff = number;
+    return false;
+}
+
+/**
+ * Reads an exponential, the first digit of which was already read.
+ * Whole numbers are read at once if possible, otherwise digit by digit.
+ * @param ps
+ * @param c : first digit, replaced with the character after the number
+ * @param exp
+ * @return true if the number is too big, false otherwise
+ */
+static bool ReadExp(Parser *ps, int *c, poly_exp_t *exp) {
+    uint64_t value;
+    InputUngetc(*c);
+    int digits = InputDigits(INT_MAX, &value);
+    if (digits > 0) {
+        ps->column += digits - 1;
+        *exp = value;
+        *c = Next(ps);
+        return false;
+    }
+    *c = InputGetc();
+    poly_exp_t number = 0;
+    while (*c >= '0' && *c <= '9') {
+        int digit = *c - '0';
+        if (number > (INT_MAX - digit) / 10) {
+            return true;
+        }
+        number = number * 10 + digit;
+        *c = Next(ps);
+    }
+    *exp = number;
+    return false;
+}
+
+/**
+ * Starts a new polynomial whose monomials follow in the line.
+ * @param ps
+ * @param initial : first array of frames
+ */
+static void OpenFrame(Parser *ps, ParseFrame *initial) {
+    if (ps->depth == ps->framesSize) {
+        GrowVector((void **) &ps->frames, &ps->framesSize, sizeof(ParseFrame),
+                   initial);
+    }
+    ps->frames[ps->depth++] = (ParseFrame) {.start = ps->count, .sorted = true,
+                                            .lastExp = -1};
+}
+
+/**
+ * Adds the current monomial to the innermost polynomial.
+ * Monomials with zero coefficients are skipped.
+ * @param ps
+ * @param exp
+ * @param initial : first array of monomials
+ */
+static void AddMono(Parser *ps, poly_exp_t exp, Mono *initial) {
+    ps->hasCoeff = false;
+    if (PolyIsZero(&ps->coeff)) {
+        return;
+    }
+    if (ps->count == ps->size) {
+        GrowVector((void **) &ps->monos, &ps->size, sizeof(Mono), initial);
+    }
+    ParseFrame *f = &ps->frames[ps->depth - 1];
+    if (exp <= f->lastExp) {
+        f->sorted = false;
+    }
+    f->lastExp = exp;
+    ps->monos[ps->count++] = MonoFromPoly(&ps->coeff, exp);
+}
+
+/**
+ * Builds the innermost polynomial from its monomials.
+ * If they are sorted, they are linked in the given order,
+ * otherwise they are sorted and merged.
+ * @param ps
+ * @return polynomial
+ */
+static Poly CloseFrame(Parser *ps) {
+    ParseFrame *f = &ps->frames[--ps->depth];
+    Mono *first = &ps->monos[f->start];
+    size_t count = ps->count - f->start;
+    ps->count = f->start;
+    if (count == 0) {
+        return PolyZero();
+    }
+    if (!f->sorted) {
+        return PolyAddMonos(count, first);
+    }
+    if (count == 1 && first->exp == 0 && PolyIsCoeff(&first->p)) {
+        return first->p;
+    }
+    Mono *head = NULL;
+    for (size_t i = count; i > 0; i--) {
+        Mono *m = malloc(sizeof(Mono));
+        assert(m != NULL);
+        *m = first[i - 1];
+        m->next = head;
+        head = m;
+    }
+    return (Poly) {.coeff = 0, .list = head};
+}
+
+bool ParsePolyLine(Poly *p, int *column) {
+    Mono initialMonos[MONOS_STARTING_SIZE];
+    ParseFrame initialFrames[FRAMES_STARTING_SIZE];
+    Parser ps = {.monos = initialMonos, .count = 0,
+                 .size = MONOS_STARTING_SIZE, .frames = initialFrames,
+                 .depth = 0, .framesSize = FRAMES_STARTING_SIZE,
+                 .hasCoeff = false, .column = 0};
+    ParseState state = STATE_START;
+    bool error = false, done = false;
+    poly_coeff_t number;
+    poly_exp_t exp = 0;
+    int c = Next(&ps);
+    while (!error && !done) {
+        switch ((ParseAction) transitions[state][ClassOf(c)]) {
+            case ACTION_OPEN_POLY:
+                OpenFrame(&ps, initialFrames);
+                c = Next(&ps);
+                state = STATE_COEFF;
+                break;
+            case ACTION_OPEN_MONO:
+                c = Next(&ps);
+                state = STATE_COEFF;
+                break;
+            case ACTION_CONST:
+            case ACTION_COEFF:
+                error = ReadCoeff(&ps, &c, &number);
+                if (!error) {
+                    ps.coeff = PolyFromCoeff(number);
+                    ps.hasCoeff = true;
+                    state = state == STATE_START ? STATE_END : STATE_COMMA;
+                }
+                break;
+            case ACTION_COMMA:
+                c = Next(&ps);
+                state = STATE_EXP;
+                break;
+            case ACTION_EXP:
+                error = ReadExp(&ps, &c, &exp);
+                state = STATE_CLOSE;
+                break;
+            case ACTION_CLOSE:
+                AddMono(&ps, exp, initialMonos);
+                c = Next(&ps);
+                state = STATE_NEXT;
+                break;
+            case ACTION_PLUS:
+                c = Next(&ps);
+                state = STATE_MONO;
+                break;
+            case ACTION_END_COEFF:
+                if (ps.depth == 1) {
+                    error = true;
+                }
+                else {
+                    ps.coeff = CloseFrame(&ps);
+                    ps.hasCoeff = true;
+                    c = Next(&ps);
+                    state = STATE_EXP;
+                }
+                break;
+            case ACTION_END_LINE:
+                if (ps.depth > 1) {
+                    error = true;
+                }
+                else {
+                    if (ps.depth == 1) {
+                        ps.coeff = CloseFrame(&ps);
+                    }
+                    *p = ps.coeff;
+                    done = true;
+                }
+                break;
+            default:
+                error = true;
+                break;
+        }
+    }
+    if (error) {
+        if (ps.hasCoeff) {
+            PolyDestroy(&ps.coeff);
+        }
+        for (size_t i = 0; i < ps.count; i++) {
+            MonoDestroy(&ps.monos[i]);
+        }
+        *column = ps.column;
+    }
+    if (ps.monos != initialMonos) {
+        free(ps.monos);
+    }
+    if (ps.frames != initialFrames) {
+        free(ps.frames);
+    }
+    InputUngetc(c);
+    return error;
+}
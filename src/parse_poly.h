@@ -0,0 +1,35 @@
+/** @file
+   Interface of the parser of polynomials
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-26
+*/
+
+#ifndef __PARSE_POLY_H__
+#define __PARSE_POLY_H__
+
+#include "poly.h"
+
+/** character which opens a sequence in the notation of polynomials */
+#define POLY_OPENING_SEPARATOR '('
+/** character which closes a sequence in the notation of polynomials */
+#define POLY_CLOSING_SEPARATOR ')'
+/** character which separates coefficient and exponential in
+  * the notation of polynomials */
+#define POLY_COEFF_EXP_SEPARATOR ','
+/** character which separates monomials in the notation of polynomials */
+#define POLY_MONO_SEPARATOR '+'
+
+/**
+ * Parses a polynomial from the current line of the input.
+ * Stops at the end of the line, which isn't read.
+ * Monomials given in the order of increasing exponents are linked directly,
+ * the other ones are sorted and merged.
+ * @param[out] p : polynomial
+ * @param[out] column : column of the first incorrect character
+ * @return true if the line isn't a correct polynomial, false otherwise
+ */
+bool ParsePolyLine(Poly *p, int *column);
+
+#endif /* __PARSE_POLY_H__ */
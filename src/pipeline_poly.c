@@ -0,0 +1,253 @@
+/** @file
+   Implementation of the pipes and the stages of the pipelined calculator
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pipeline_poly.h"
+#include "input_poly.h"
+#include "output_poly.h"
+#include "utils.h"
+
+void PipeInit(Pipe *pipe) {
+    pipe->head = pipe->count = 0;
+    pipe->closed = false;
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->notEmpty, NULL);
+    pthread_cond_init(&pipe->notFull, NULL);
+}
+
+void PipeDestroy(Pipe *pipe) {
+    assert(pipe->count == 0);
+    pthread_cond_destroy(&pipe->notFull);
+    pthread_cond_destroy(&pipe->notEmpty);
+    pthread_mutex_destroy(&pipe->lock);
+}
+
+void PipeWriterInit(PipeWriter *w, Pipe *pipe) {
+    w->pipe = pipe;
+    w->count = 0;
+}
+
+void PipeWrite(PipeWriter *w, const Message *m) {
+    w->batch[w->count++] = *m;
+    if (w->count == PIPE_BATCH) {
+        PipeFlush(w);
+    }
+}
+
+void PipeFlush(PipeWriter *w) {
+    Pipe *pipe = w->pipe;
+    size_t sent = 0;
+    while (sent < w->count) {
+        pthread_mutex_lock(&pipe->lock);
+        while (pipe->count == PIPE_SIZE) {
+            pthread_cond_wait(&pipe->notFull, &pipe->lock);
+        }
+        bool wasEmpty = pipe->count == 0;
+        for (; sent < w->count && pipe->count < PIPE_SIZE; sent++) {
+            pipe->arr[(pipe->head + pipe->count++) % PIPE_SIZE] =
+                w->batch[sent];
+        }
+        if (wasEmpty) {
+            pthread_cond_signal(&pipe->notEmpty);
+        }
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    w->count = 0;
+}
+
+void PipeClose(PipeWriter *w) {
+    PipeFlush(w);
+    Pipe *pipe = w->pipe;
+    pthread_mutex_lock(&pipe->lock);
+    pipe->closed = true;
+    pthread_cond_signal(&pipe->notEmpty);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+size_t PipeRead(Pipe *pipe, Message batch[], bool wait) {
+    pthread_mutex_lock(&pipe->lock);
+    while (wait && pipe->count == 0 && !pipe->closed) {
+        pthread_cond_wait(&pipe->notEmpty, &pipe->lock);
+    }
+    bool wasFull = pipe->count == PIPE_SIZE;
+    size_t n = 0;
+    for (; n < PIPE_BATCH && pipe->count > 0; n++) {
+        batch[n] = pipe->arr[pipe->head];
+        pipe->head = (pipe->head + 1) % PIPE_SIZE;
+        pipe->count--;
+    }
+    if (wasFull && n > 0) {
+        pthread_cond_signal(&pipe->notFull);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return n;
+}
+
+/**
+ * Structure for the pipes between the stages of the pipelined mode.
+ */
+typedef struct pipeline {
+    Pipe parsed; ///< lines sent by the parsing stage to be executed
+    Pipe printed; ///< results and errors sent to the printing stage
+} Pipeline;
+
+/**
+ * Parsing stage of the pipelined mode. Parses the lines of the standard
+ * input and sends them to be executed, together with their errors.
+ * @param arg : pipeline
+ * @return
+ */
+static void *ParseStage(void *arg) {
+    PipeWriter w;
+    PipeWriterInit(&w, &((Pipeline *) arg)->parsed);
+    SetNextStage(&w);
+    InputOpen(STDIN_FILENO);
+    /* The parsed lines are executed while more input is waited for. */
+    InputSetIdle(FlushNextStage);
+    CommandAndParam cap;
+    int lineCount = 1, line = CheckLinePolyOrCommand();
+    int c = 0;
+    while (c != EOF && line != VAL_IF_EOF) {
+        if (line == VAL_IF_POLY) {
+            Poly p;
+            if (!ParsePoly(&p, lineCount)) {
+                SendMessage(PUSH_LITERAL_OP, lineCount, 0, p, NULL);
+            }
+        }
+        else if (!ParseCommand(&cap, lineCount)) {
+            SendMessage(cap.id, lineCount, NumericParam(&cap), PolyZero(),
+                        TextParam(&cap));
+        }
+        ForwardToNewLine();
+        c = InputGetc();
+        if (c != EOF) {
+            line = CheckLinePolyOrCommand();
+            lineCount++;
+        }
+    }
+    InputClose();
+    PipeClose(&w);
+    SetNextStage(NULL);
+    return NULL;
+}
+
+/**
+ * Printing stage of the pipelined mode. Formats and writes the results
+ * and the error messages in the order in which they were sent.
+ * @param arg : pipeline
+ * @return
+ */
+static void *PrintStage(void *arg) {
+    Pipe *pipe = &((Pipeline *) arg)->printed;
+    Message batch[PIPE_BATCH];
+    size_t n;
+    OutputOpen(STDOUT_FILENO);
+    while ((n = PipeRead(pipe, batch, true)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            Message *m = &batch[i];
+            switch (m->kind) {
+                case PRINT_POLY_MESSAGE:
+                    OutputPoly(&m->p);
+                    OutputEndLine();
+                    PolyDestroy(&m->p);
+                    break;
+                case PRINT_NUMBER_MESSAGE:
+                    OutputLong(m->param);
+                    OutputEndLine();
+                    break;
+                case ERROR_MESSAGE:
+                    ErrorMsg(m->line, m->text);
+                    free(m->text);
+                    break;
+                default:
+                    ParsingErrorMsg(m->line, (int) m->param);
+                    break;
+            }
+        }
+    }
+    OutputClose();
+    return NULL;
+}
+
+/**
+ * Executes a message sent by the parsing stage. The errors of parsing
+ * are passed to the printing stage in their place among the results.
+ * @param calc
+ * @param m
+ * @param printed : writer to the printing stage
+ */
+static void ExecuteMessage(Calculator *calc, Message *m, PipeWriter *printed) {
+    if (m->kind == PUSH_LITERAL_OP) {
+        if (Push(&calc->stack, m->p)) {
+            PolyDestroy(&m->p);
+            MemoryErrorMsg(m->line);
+        }
+    }
+    else if (m->kind < NUM_OF_COMMANDS) {
+        int error = ExecuteCommand(calc, m->kind, m->param, m->text, m->line);
+        CommandErrorMsg(error, m->line);
+        free(m->text);
+    }
+    else {
+        PipeWrite(printed, m);
+    }
+}
+
+bool RunPipelined(Calculator *calc, bool force) {
+    /* The stages can't overlap on a single processor, where the threads
+       would only make the allocations slower. */
+    if (!force && sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        fprintf(stderr, "The input isn't pipelined on a single processor\n");
+        return true;
+    }
+    Pipeline *pl = malloc(sizeof(Pipeline));
+    assert(pl != NULL);
+    PipeInit(&pl->parsed);
+    PipeInit(&pl->printed);
+    PipeWriter w;
+    PipeWriterInit(&w, &pl->printed);
+    pthread_t parser, printer;
+    bool error = pthread_create(&printer, NULL, PrintStage, pl) != 0;
+    if (!error && pthread_create(&parser, NULL, ParseStage, pl) != 0) {
+        PipeClose(&w);
+        pthread_join(printer, NULL);
+        error = true;
+    }
+    if (error) {
+        fprintf(stderr, "Cannot start the threads of the pipeline\n");
+    }
+    else {
+        SetNextStage(&w);
+        Message batch[PIPE_BATCH];
+        for (;;) {
+            size_t n = PipeRead(&pl->parsed, batch, false);
+            if (n == 0) {
+                /* The results are printed while more lines are waited for. */
+                PipeFlush(&w);
+                n = PipeRead(&pl->parsed, batch, true);
+            }
+            if (n == 0) {
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                ExecuteMessage(calc, &batch[i], &w);
+            }
+        }
+        PipeClose(&w);
+        SetNextStage(NULL);
+        pthread_join(parser, NULL);
+        pthread_join(printer, NULL);
+    }
+    PipeDestroy(&pl->printed);
+    PipeDestroy(&pl->parsed);
+    free(pl);
+    return error;
+}
@@ -0,0 +1,128 @@
+/** @file
+   Interface of the pipes between the stages of the pipelined calculator
+
+   A pipe is a bounded queue of messages passed from one thread to another
+   in the order in which they were written. The messages are written and
+   read in batches, so the threads seldom wait for each other's lock.
+   The meaning of the messages is given by the users of the pipe.
+
+   In the pipelined mode the input is parsed by one thread, executed by
+   another and the results are printed by a third one, which are joined
+   by the pipes.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-04
+*/
+
+#ifndef __PIPELINE_POLY_H__
+#define __PIPELINE_POLY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "poly.h"
+#include "calc_poly.h"
+
+/** number of messages which can wait in a pipe */
+#define PIPE_SIZE 4096
+/** number of messages written or read at once */
+#define PIPE_BATCH 64
+
+/**
+ * Structure containing a message.
+ */
+typedef struct message {
+    int kind; ///< kind of the message
+    int line; ///< number of the line of the input
+    long param; ///< numeric parameter
+    Poly p; ///< polynomial, owned by the message
+    char *text; ///< text owned by the message or NULL
+} Message;
+
+/**
+ * Structure containing a pipe.
+ */
+typedef struct pipe {
+    Message arr[PIPE_SIZE]; ///< queue of the messages
+    size_t head; ///< index of the first message in the queue
+    size_t count; ///< number of messages in the queue
+    bool closed; ///< whether no more messages are written
+    pthread_mutex_t lock; ///< lock of the queue
+    pthread_cond_t notEmpty; ///< signalled when messages are written
+    pthread_cond_t notFull; ///< signalled when messages are read
+} Pipe;
+
+/**
+ * Structure containing the messages written to a pipe but not sent yet.
+ */
+typedef struct pipe_writer {
+    Pipe *pipe; ///< pipe
+    Message batch[PIPE_BATCH]; ///< messages waiting to be sent
+    size_t count; ///< number of waiting messages
+} PipeWriter;
+
+/**
+ * Initializes an empty pipe.
+ * @param[in] pipe : pipe
+ */
+void PipeInit(Pipe *pipe);
+
+/**
+ * Releases the resources of a closed pipe, which was read to the end.
+ * @param[in] pipe : pipe
+ */
+void PipeDestroy(Pipe *pipe);
+
+/**
+ * Initializes a writer of a pipe.
+ * @param[in] w : writer
+ * @param[in] pipe : pipe
+ */
+void PipeWriterInit(PipeWriter *w, Pipe *pipe);
+
+/**
+ * Writes a message. It is sent with the next full batch, so the reader
+ * gets it after PipeFlush at the latest.
+ * @param[in] w : writer
+ * @param[in] m : message
+ */
+void PipeWrite(PipeWriter *w, const Message *m);
+
+/**
+ * Sends the written messages, waiting while the pipe is full.
+ * @param[in] w : writer
+ */
+void PipeFlush(PipeWriter *w);
+
+/**
+ * Sends the written messages and closes the pipe.
+ * @param[in] w : writer
+ */
+void PipeClose(PipeWriter *w);
+
+/**
+ * Reads the messages waiting in the pipe, at most PIPE_BATCH of them.
+ * @param[in] pipe : pipe
+ * @param[out] batch : read messages
+ * @param[in] wait : whether to wait while the pipe is empty and
+ * isn't closed
+ * @return number of read messages, 0 at the end of the pipe or if
+ * the pipe is empty and it wasn't waited for
+ */
+size_t PipeRead(Pipe *pipe, Message batch[], bool wait);
+
+/**
+ * Executes the standard input with the parsing and the printing done by
+ * separate threads, so they overlap with the execution. The results and
+ * the error messages are the same as those of RunLines. A note is printed
+ * on the standard error if the input isn't pipelined.
+ * @param[in] calc : calculator
+ * @param[in] force : whether the input is pipelined also on a single
+ * processor
+ * @return true if nothing was read, because there is a single processor
+ * or the threads couldn't be started, false otherwise
+ */
+bool RunPipelined(Calculator *calc, bool force);
+
+#endif /* __PIPELINE_POLY_H__ */
@@ -7,6 +7,7 @@
 */
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -44,6 +45,13 @@ Poly PolyClone(const Poly *p) {
     return r;
 }
 
+size_t PolyMemSize(const Poly *p) {
+    size_t bytes = 0;
+    for (Mono *m = p->list; m != NULL; m = m->next)
+        bytes += sizeof(Mono) + PolyMemSize(&m->p);
+    return bytes;
+}
+
 static Poly PolyAddCoeff(const Poly* p, poly_coeff_t c );
 
 /**
@@ -197,6 +205,7 @@ Poly PolyAddMonos(unsigned count, const Mono monos[]) {
     Mono *dummy, *head, *prev = NULL;
     dummy = head = malloc(sizeof(Mono));
     assert(dummy != NULL);
+    dummy->next = NULL;
     for (unsigned i = 0; i < count; i++) {
         if (head == dummy || head->exp != arr[i].exp) {
             assert(!PolyIsZero(&arr[i].p));
@@ -205,6 +214,7 @@ Poly PolyAddMonos(unsigned count, const Mono monos[]) {
             prev = head;
             head = head->next;
             *head = arr[i];
+            head->next = NULL;
         }
         else {
             Mono m = (Mono) {.p = PolyAdd(&head->p, &arr[i].p),
@@ -334,6 +344,699 @@ Poly PolyMul(const Poly *p, const Poly *q) {
         return PolyMulPolyPoly(p, q);
 }
 
+/**
+ * Structure containing the products of a monomial of one factor and
+ * the remaining monomials of the other one, in the order of exponents.
+ */
+typedef struct ProductStream {
+    const Mono *outer; ///< monomial of the first factor
+    const Mono *inner; ///< next monomial of the second factor
+} ProductStream;
+
+/**
+ * Returns the exponent of the next product of a stream.
+ * @param s : stream
+ * @return exponent
+ */
+static inline poly_exp_t StreamExp(const ProductStream *s) {
+    return s->outer->exp + s->inner->exp;
+}
+
+/**
+ * Moves a stream down the heap of streams to its place.
+ * @param heap : heap ordered by the exponents of the next products
+ * @param count : number of streams
+ * @param i : index of the stream
+ */
+static void SiftDown(ProductStream heap[], unsigned count, unsigned i) {
+    ProductStream s = heap[i];
+    poly_exp_t exp = StreamExp(&s);
+    while (2 * i + 1 < count) {
+        unsigned child = 2 * i + 1;
+        if (child + 1 < count
+            && StreamExp(&heap[child + 1]) < StreamExp(&heap[child]))
+            child++;
+        if (StreamExp(&heap[child]) >= exp)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = s;
+}
+
+/**
+ * Returns the monomials of a polynomial. A constant is given as a single
+ * monomial with the exponent 0.
+ * @param[in] p : polynomial
+ * @param[out] single : room for the monomial of a constant
+ * @return list of monomials
+ */
+static const Mono *MonoList(const Poly *p, Mono *single) {
+    if (!PolyIsCoeff(p))
+        return p->list;
+    *single = (Mono) {.p = *p, .exp = 0, .next = NULL};
+    return single;
+}
+
+/**
+ * Turns a constant, which isn't zero, into a list of one monomial,
+ * so that monomials can be merged into it.
+ * @param p : polynomial
+ */
+static void PolyOpen(Poly *p) {
+    if (PolyIsCoeff(p) && p->coeff != 0) {
+        Mono *m = malloc(sizeof(Mono));
+        assert(m != NULL);
+        *m = (Mono) {.p = PolyFromCoeff(p->coeff), .exp = 0, .next = NULL};
+        p->list = m;
+    }
+}
+
+/**
+ * Brings a polynomial opened by PolyOpen back to the normal form.
+ * @param p : polynomial
+ */
+static void PolyClose(Poly *p) {
+    if (p->list == NULL)
+        *p = PolyZero();
+    else if (p->list->next == NULL && p->list->exp == 0
+             && PolyIsCoeff(&p->list->p)) {
+        Mono *m = p->list;
+        *p = m->p;
+        free(m);
+    }
+}
+
+void PolyMulAdd(Poly *acc, const Poly *p, const Poly *q) {
+    if (PolyIsZero(p) || PolyIsZero(q))
+        return;
+    if (PolyIsCoeff(acc) && PolyIsCoeff(p) && PolyIsCoeff(q)) {
+        acc->coeff += p->coeff * q->coeff;
+        return;
+    }
+    Mono singleP, singleQ;
+    const Mono *outer = MonoList(p, &singleP), *inner = MonoList(q, &singleQ);
+    unsigned count = PolyLength(p) + PolyIsCoeff(p),
+             innerCount = PolyLength(q) + PolyIsCoeff(q);
+    if (innerCount < count) {
+        const Mono *temp = outer;
+        outer = inner;
+        inner = temp;
+        count = innerCount;
+    }
+    /* The streams start in the order of the exponents, so they are
+       a heap already. */
+    ProductStream *heap = calloc(count, sizeof(ProductStream));
+    assert(heap != NULL);
+    for (unsigned i = 0; i < count; i++) {
+        heap[i] = (ProductStream) {.outer = outer, .inner = inner};
+        outer = outer->next;
+    }
+    PolyOpen(acc);
+    Mono **link = &acc->list;
+    while (count > 0) {
+        ProductStream *s = &heap[0];
+        poly_exp_t exp = StreamExp(s);
+        while (*link != NULL && (*link)->exp < exp)
+            link = &(*link)->next;
+        if (*link == NULL || (*link)->exp > exp) {
+            Mono *m = malloc(sizeof(Mono));
+            assert(m != NULL);
+            *m = (Mono) {.p = PolyZero(), .exp = exp, .next = *link};
+            *link = m;
+        }
+        PolyMulAdd(&(*link)->p, &s->outer->p, &s->inner->p);
+        if (PolyIsZero(&(*link)->p)) {
+            Mono *m = *link;
+            *link = m->next;
+            free(m);
+        }
+        s->inner = s->inner->next;
+        if (s->inner == NULL)
+            heap[0] = heap[--count];
+        if (count > 0)
+            SiftDown(heap, count, 0);
+    }
+    free(heap);
+    PolyClose(acc);
+}
+
+/**
+ * Moves a list of monomials down the heap of lists to its place.
+ * @param heap : heap ordered by the exponents of the first monomials
+ * @param count : number of lists
+ * @param i : index of the list
+ */
+static void SiftDownMonos(const Mono *heap[], unsigned count, unsigned i) {
+    const Mono *m = heap[i];
+    while (2 * i + 1 < count) {
+        unsigned child = 2 * i + 1;
+        if (child + 1 < count && heap[child + 1]->exp < heap[child]->exp)
+            child++;
+        if (heap[child]->exp >= m->exp)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = m;
+}
+
+Poly PolyAddMany(unsigned count, const Poly polys[]) {
+    poly_coeff_t c = 0;
+    const Mono **heap = calloc(count + 1, sizeof(Mono *));
+    assert(heap != NULL);
+    unsigned lists = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (PolyIsCoeff(&polys[i]))
+            c += polys[i].coeff;
+        else
+            heap[lists++] = polys[i].list;
+    }
+    if (lists == 0) {
+        free(heap);
+        return PolyFromCoeff(c);
+    }
+    for (unsigned i = lists / 2; i > 0; i--)
+        SiftDownMonos(heap, lists, i - 1);
+    /* The coefficients of the monomials with the same exponent, and the sum
+       of the constants, are summed together. */
+    Poly *group = calloc(lists + 1, sizeof(Poly));
+    assert(group != NULL);
+    Poly r = (Poly) {.list = NULL};
+    Mono **tail = &r.list;
+    if (c != 0 && heap[0]->exp > 0) {
+        Mono *m = malloc(sizeof(Mono));
+        assert(m != NULL);
+        *m = (Mono) {.p = PolyFromCoeff(c), .exp = 0, .next = NULL};
+        *tail = m;
+        tail = &m->next;
+        c = 0;
+    }
+    while (lists > 0) {
+        poly_exp_t exp = heap[0]->exp;
+        unsigned n = 0;
+        if (c != 0) {
+            group[n++] = PolyFromCoeff(c);
+            c = 0;
+        }
+        while (lists > 0 && heap[0]->exp == exp) {
+            group[n++] = heap[0]->p;
+            heap[0] = heap[0]->next;
+            if (heap[0] == NULL)
+                heap[0] = heap[--lists];
+            if (lists > 0)
+                SiftDownMonos(heap, lists, 0);
+        }
+        Poly sum = n == 1 ? PolyClone(&group[0]) : PolyAddMany(n, group);
+        if (!PolyIsZero(&sum)) {
+            Mono *m = malloc(sizeof(Mono));
+            assert(m != NULL);
+            *m = (Mono) {.p = sum, .exp = exp, .next = NULL};
+            *tail = m;
+            tail = &m->next;
+        }
+    }
+    free(group);
+    free(heap);
+    PolyClose(&r);
+    return r;
+}
+
+void PolyProductBegin(PolyProductIter *it, const Poly *p, const Poly *q) {
+    it->heap = NULL;
+    it->count = 0;
+    if (PolyIsZero(p) || PolyIsZero(q))
+        return;
+    const Mono *outer = MonoList(p, &it->single[0]),
+               *inner = MonoList(q, &it->single[1]);
+    unsigned count = PolyLength(p) + PolyIsCoeff(p),
+             innerCount = PolyLength(q) + PolyIsCoeff(q);
+    if (innerCount < count) {
+        const Mono *temp = outer;
+        outer = inner;
+        inner = temp;
+        count = innerCount;
+    }
+    it->heap = calloc(count, sizeof(ProductStream));
+    assert(it->heap != NULL);
+    for (; it->count < count; it->count++) {
+        it->heap[it->count] = (ProductStream) {.outer = outer,
+                                               .inner = inner};
+        outer = outer->next;
+    }
+}
+
+bool PolyProductNext(PolyProductIter *it, Mono *m) {
+    while (it->count > 0) {
+        ProductStream *s = &it->heap[0];
+        poly_exp_t exp = StreamExp(s);
+        Poly coeff = PolyZero();
+        while (it->count > 0 && StreamExp(s) == exp) {
+            PolyMulAdd(&coeff, &s->outer->p, &s->inner->p);
+            s->inner = s->inner->next;
+            if (s->inner == NULL)
+                it->heap[0] = it->heap[--it->count];
+            if (it->count > 0)
+                SiftDown(it->heap, it->count, 0);
+        }
+        if (!PolyIsZero(&coeff)) {
+            *m = (Mono) {.p = coeff, .exp = exp, .next = NULL};
+            return true;
+        }
+    }
+    return false;
+}
+
+void PolyProductEnd(PolyProductIter *it) {
+    free(it->heap);
+    it->heap = NULL;
+    it->count = 0;
+}
+
+/**
+ * Finds the first monomial of a list whose exponent isn't smaller than
+ * a given one.
+ * @param monos : monomials in the order of exponents
+ * @param count : number of monomials
+ * @param exp : exponent
+ * @return index of the monomial, @p count if there is none
+ */
+static unsigned MonoLowerBound(const Mono *monos[], unsigned count,
+                               long exp) {
+    unsigned lo = 0, hi = count;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (monos[mid]->exp < exp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+Poly PolyMulBand(const Poly *p, const Poly *q, poly_exp_t lo,
+                 poly_exp_t hi) {
+    if (PolyIsZero(p) || PolyIsZero(q) || lo > hi)
+        return PolyZero();
+    Mono singleP, singleQ;
+    const Mono *outer = MonoList(p, &singleP), *inner = MonoList(q, &singleQ);
+    unsigned count = PolyLength(p) + PolyIsCoeff(p),
+             innerCount = PolyLength(q) + PolyIsCoeff(q);
+    if (innerCount < count) {
+        const Mono *temp = outer;
+        outer = inner;
+        inner = temp;
+        unsigned tempCount = count;
+        count = innerCount;
+        innerCount = tempCount;
+    }
+    /* Every stream starts at the first product in the band, found by
+       binary search, so the skipped products cost nothing. */
+    const Mono **monos = calloc(innerCount, sizeof(Mono *));
+    ProductStream *heap = calloc(count, sizeof(ProductStream));
+    assert(monos != NULL && heap != NULL);
+    for (unsigned i = 0; inner != NULL; inner = inner->next)
+        monos[i++] = inner;
+    unsigned streams = 0;
+    for (; outer != NULL; outer = outer->next) {
+        unsigned i = MonoLowerBound(monos, innerCount,
+                                    (long) lo - outer->exp);
+        if (i < innerCount && (long) outer->exp + monos[i]->exp <= hi)
+            heap[streams++] = (ProductStream) {.outer = outer,
+                                               .inner = monos[i]};
+    }
+    free(monos);
+    for (unsigned i = streams / 2; i-- > 0;)
+        SiftDown(heap, streams, i);
+    Poly r = PolyZero();
+    Mono **tail = &r.list;
+    while (streams > 0 && StreamExp(&heap[0]) <= hi) {
+        ProductStream *s = &heap[0];
+        poly_exp_t exp = StreamExp(s);
+        Poly coeff = PolyZero();
+        while (streams > 0 && StreamExp(s) == exp) {
+            PolyMulAdd(&coeff, &s->outer->p, &s->inner->p);
+            s->inner = s->inner->next;
+            if (s->inner == NULL)
+                heap[0] = heap[--streams];
+            if (streams > 0)
+                SiftDown(heap, streams, 0);
+        }
+        if (!PolyIsZero(&coeff)) {
+            Mono *m = malloc(sizeof(Mono));
+            assert(m != NULL);
+            *m = (Mono) {.p = coeff, .exp = exp, .next = NULL};
+            *tail = m;
+            tail = &m->next;
+        }
+    }
+    free(heap);
+    PolyClose(&r);
+    return r;
+}
+
+/**
+ * Structure containing a factor of a product.
+ */
+typedef struct Factor {
+    Poly p; ///< polynomial
+    size_t size; ///< number of bytes of the polynomial
+    bool owned; ///< whether the polynomial is a partial product
+} Factor;
+
+/**
+ * Moves a factor down the heap of factors to its place.
+ * @param heap : heap ordered by the sizes of the factors
+ * @param count : number of factors
+ * @param i : index of the factor
+ */
+static void SiftDownFactors(Factor heap[], unsigned count, unsigned i) {
+    Factor f = heap[i];
+    while (2 * i + 1 < count) {
+        unsigned child = 2 * i + 1;
+        if (child + 1 < count && heap[child + 1].size < heap[child].size)
+            child++;
+        if (heap[child].size >= f.size)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = f;
+}
+
+Poly PolyMulMany(unsigned count, const Poly polys[]) {
+    poly_coeff_t c = 1;
+    Factor *heap = calloc(count + 1, sizeof(Factor));
+    assert(heap != NULL);
+    unsigned factors = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (PolyIsCoeff(&polys[i]))
+            c *= polys[i].coeff;
+        else
+            heap[factors++] = (Factor) {.p = polys[i],
+                                        .size = PolyMemSize(&polys[i]),
+                                        .owned = false};
+    }
+    if (c == 0 || factors == 0) {
+        free(heap);
+        return PolyFromCoeff(c);
+    }
+    for (unsigned i = factors / 2; i > 0; i--)
+        SiftDownFactors(heap, factors, i - 1);
+    /* The two smallest factors are multiplied first, so the factors
+       of similar sizes make a balanced tree of products. */
+    while (factors > 1) {
+        Factor f = heap[0];
+        heap[0] = heap[--factors];
+        SiftDownFactors(heap, factors, 0);
+        Poly r = PolyZero();
+        PolyMulAdd(&r, &f.p, &heap[0].p);
+        if (f.owned)
+            PolyDestroy(&f.p);
+        if (heap[0].owned)
+            PolyDestroy(&heap[0].p);
+        heap[0] = (Factor) {.p = r, .size = PolyMemSize(&r), .owned = true};
+        SiftDownFactors(heap, factors, 0);
+    }
+    Poly r = heap[0].owned ? heap[0].p : PolyClone(&heap[0].p);
+    free(heap);
+    if (c != 1) {
+        Poly temp = PolyMulCoeff(&r, c);
+        PolyDestroy(&r);
+        r = temp;
+    }
+    return r;
+}
+
+/**
+ * Structure containing an upper bound of the shape of a polynomial.
+ * A path of level d is a monomial of depth d or a path ending above it
+ * with a constant coefficient.
+ */
+typedef struct PolyShape {
+    unsigned depth; ///< number of levels of the monomials
+    size_t *paths; ///< number of the paths of every level
+    size_t *deg; ///< maximal exponent of every level
+    size_t leaves; ///< number of the paths ending with a constant
+} PolyShape;
+
+/**
+ * Adds two numbers, saturating at SIZE_MAX.
+ * @param[in] a : number
+ * @param[in] b : number
+ * @return `a + b` or SIZE_MAX
+ */
+static inline size_t SatAdd(size_t a, size_t b) {
+    return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
+
+/**
+ * Multiplies two numbers, saturating at SIZE_MAX.
+ * @param[in] a : number
+ * @param[in] b : number
+ * @return `a * b` or SIZE_MAX
+ */
+static inline size_t SatMul(size_t a, size_t b) {
+    return b != 0 && a > SIZE_MAX / b ? SIZE_MAX : a * b;
+}
+
+/**
+ * Returns the number of the paths of a level of a shape.
+ * @param[in] s : shape
+ * @param[in] d : level
+ * @return number of the paths
+ */
+static inline size_t ShapePaths(const PolyShape *s, unsigned d) {
+    return d < s->depth ? s->paths[d] : s->leaves;
+}
+
+/**
+ * Returns the maximal exponent of a level of a shape.
+ * @param[in] s : shape
+ * @param[in] d : level
+ * @return exponent
+ */
+static inline size_t ShapeDeg(const PolyShape *s, unsigned d) {
+    return d < s->depth ? s->deg[d] : 0;
+}
+
+/**
+ * Creates a shape of a constant.
+ * @param[in] depth : number of levels to make room for
+ * @param[in] leaves : 1 for a nonzero constant, 0 for zero
+ * @return shape
+ */
+static PolyShape ShapeNew(unsigned depth, size_t leaves) {
+    PolyShape s = {.depth = depth, .leaves = leaves};
+    s.paths = calloc(depth + 1, sizeof(size_t));
+    s.deg = calloc(depth + 1, sizeof(size_t));
+    assert(s.paths != NULL && s.deg != NULL);
+    return s;
+}
+
+/**
+ * Releases a shape.
+ * @param[in] s : shape
+ */
+static void ShapeDestroy(PolyShape *s) {
+    free(s->paths);
+    free(s->deg);
+}
+
+/**
+ * Returns the number of levels of the monomials of a polynomial.
+ * @param[in] p : polynomial
+ * @return number of levels
+ */
+static unsigned PolyDepth(const Poly *p) {
+    unsigned depth = 0;
+    for (Mono *m = p->list; m != NULL; m = m->next) {
+        unsigned d = 1 + PolyDepth(&m->p);
+        if (d > depth)
+            depth = d;
+    }
+    return depth;
+}
+
+/**
+ * Counts the monomials of a polynomial on every level.
+ * @param[in] p : non constant polynomial
+ * @param[in] d : level of its monomials
+ * @param[in,out] s : shape
+ * @param[in,out] ends : numbers of the constant coefficients of every level
+ */
+static void ShapeCount(const Poly *p, unsigned d, PolyShape *s,
+                       size_t ends[]) {
+    for (Mono *m = p->list; m != NULL; m = m->next) {
+        s->paths[d]++;
+        if ((size_t) m->exp > s->deg[d])
+            s->deg[d] = m->exp;
+        if (PolyIsCoeff(&m->p))
+            ends[d]++;
+        else
+            ShapeCount(&m->p, d + 1, s, ends);
+    }
+}
+
+/**
+ * Computes the shape of a polynomial.
+ * @param[in] p : polynomial
+ * @return shape
+ */
+static PolyShape ShapeOf(const Poly *p) {
+    if (PolyIsCoeff(p))
+        return ShapeNew(0, !PolyIsZero(p));
+    PolyShape s = ShapeNew(PolyDepth(p), 0);
+    size_t *ends = calloc(s.depth, sizeof(size_t));
+    assert(ends != NULL);
+    ShapeCount(p, 0, &s, ends);
+    for (unsigned d = 0; d < s.depth; d++) {
+        s.paths[d] += s.leaves;
+        s.leaves += ends[d];
+    }
+    free(ends);
+    return s;
+}
+
+/**
+ * Bounds the shape of a sum or a product of polynomials. A path of
+ * the result comes from a pair of paths of the arguments in a product
+ * and from a path of one of them in a sum. The monomials under a path
+ * have distinct exponents, which bounds their number too.
+ * @param[in] a : shape of a polynomial
+ * @param[in] b : shape of a polynomial
+ * @param[in] mul : whether the polynomials are multiplied
+ * @return shape of the result
+ */
+static PolyShape ShapeCombine(const PolyShape *a, const PolyShape *b,
+                              bool mul) {
+    PolyShape r = ShapeNew(a->depth > b->depth ? a->depth : b->depth, 0);
+    size_t prev = 1;
+    for (unsigned d = 0; d < r.depth; d++) {
+        size_t degA = ShapeDeg(a, d), degB = ShapeDeg(b, d);
+        size_t pathsA = ShapePaths(a, d), pathsB = ShapePaths(b, d);
+        r.deg[d] = mul ? SatAdd(degA, degB) : degA > degB ? degA : degB;
+        size_t paths = mul ? SatMul(pathsA, pathsB) : SatAdd(pathsA, pathsB);
+        size_t dense = SatMul(prev, SatAdd(r.deg[d], 1));
+        r.paths[d] = prev = paths < dense ? paths : dense;
+    }
+    size_t leaves = mul ? SatMul(a->leaves, b->leaves) :
+                    SatAdd(a->leaves, b->leaves);
+    r.leaves = leaves < prev ? leaves : prev;
+    return r;
+}
+
+/**
+ * Replaces a shape with its combination with another one.
+ * @param[in,out] a : shape
+ * @param[in] b : shape
+ * @param[in] mul : whether the polynomials are multiplied
+ */
+static void ShapeCombineWith(PolyShape *a, const PolyShape *b, bool mul) {
+    PolyShape r = ShapeCombine(a, b, mul);
+    ShapeDestroy(a);
+    *a = r;
+}
+
+/**
+ * Bounds the shape of a power of a polynomial.
+ * @param[in] s : shape of the polynomial
+ * @param[in] exp : exponent
+ * @return shape of the power
+ */
+static PolyShape ShapePow(const PolyShape *s, poly_exp_t exp) {
+    PolyShape r = ShapeNew(0, 1), base = ShapeCombine(s, &r, true);
+    while (exp > 0) {
+        if (exp % 2 == 1)
+            ShapeCombineWith(&r, &base, true);
+        exp /= 2;
+        if (exp > 0)
+            ShapeCombineWith(&base, &base, true);
+    }
+    ShapeDestroy(&base);
+    return r;
+}
+
+/**
+ * Returns the sum of the paths of all levels of a shape, which bounds
+ * the number of the monomials.
+ * @param[in] s : shape
+ * @return number of the monomials
+ */
+static size_t ShapeTerms(const PolyShape *s) {
+    size_t terms = 0;
+    for (unsigned d = 0; d < s->depth; d++)
+        terms = SatAdd(terms, s->paths[d]);
+    return terms;
+}
+
+size_t PolyMulTermsBound(const Poly *p, const Poly *q) {
+    PolyShape a = ShapeOf(p), b = ShapeOf(q);
+    PolyShape r = ShapeCombine(&a, &b, true);
+    size_t terms = ShapeTerms(&r);
+    ShapeDestroy(&a);
+    ShapeDestroy(&b);
+    ShapeDestroy(&r);
+    return terms;
+}
+
+size_t PolyMulManyTermsBound(unsigned count, const Poly polys[]) {
+    PolyShape r = ShapeNew(0, 1);
+    for (unsigned i = 0; i < count; i++) {
+        PolyShape s = ShapeOf(&polys[i]);
+        ShapeCombineWith(&r, &s, true);
+        ShapeDestroy(&s);
+    }
+    size_t terms = ShapeTerms(&r);
+    ShapeDestroy(&r);
+    return terms;
+}
+
+/**
+ * Bounds the shape of a polynomial composed with polynomials from
+ * a given variable on.
+ * @param[in] p : polynomial
+ * @param[in] count : number of the substituted polynomials
+ * @param[in] x : shapes of the substituted polynomials
+ * @param[in] idx : index of the variable of the monomials of @p p
+ * @return shape of the composition
+ */
+static PolyShape ShapeCompose(const Poly *p, unsigned count,
+                              const PolyShape x[], unsigned idx) {
+    if (PolyIsCoeff(p))
+        return ShapeNew(0, !PolyIsZero(p));
+    PolyShape r = ShapeNew(0, 0);
+    for (Mono *m = p->list; m != NULL; m = m->next) {
+        PolyShape t = ShapeCompose(&m->p, count, x, idx + 1);
+        if (idx < count) {
+            PolyShape pow = ShapePow(&x[idx], m->exp);
+            ShapeCombineWith(&t, &pow, true);
+            ShapeDestroy(&pow);
+        }
+        else if (m->exp > 0) {
+            ShapeDestroy(&t);
+            continue;
+        }
+        ShapeCombineWith(&r, &t, false);
+        ShapeDestroy(&t);
+    }
+    return r;
+}
+
+size_t PolyComposeTermsBound(const Poly *p, unsigned count, const Poly x[]) {
+    PolyShape *shapes = calloc(count + 1, sizeof(PolyShape));
+    assert(shapes != NULL);
+    for (unsigned i = 0; i < count; i++)
+        shapes[i] = ShapeOf(&x[i]);
+    PolyShape r = ShapeCompose(p, count, shapes, 0);
+    size_t terms = ShapeTerms(&r);
+    ShapeDestroy(&r);
+    for (unsigned i = 0; i < count; i++)
+        ShapeDestroy(&shapes[i]);
+    free(shapes);
+    return terms;
+}
+
 Poly PolyNeg(const Poly *p) {
     if (PolyIsCoeff(p))
         return PolyFromCoeff(-1 * p->coeff);
@@ -362,6 +1065,190 @@ Poly PolySub(const Poly *p, const Poly *q) {
     return r;
 }
 
+/**
+ * Structure containing the products of a monomial of the quotient and
+ * the remaining monomials of the divisor, in the order of decreasing
+ * exponents.
+ */
+typedef struct DivStream {
+    const Mono *quot; ///< monomial of the quotient
+    unsigned next; ///< index of the next monomial of the divisor
+    poly_exp_t exp; ///< exponent of the next product
+} DivStream;
+
+/**
+ * Moves a stream down the heap of streams to its place.
+ * @param heap : heap ordered by the decreasing exponents of the products
+ * @param count : number of streams
+ * @param i : index of the stream
+ */
+static void SiftDownDiv(DivStream heap[], unsigned count, unsigned i) {
+    DivStream s = heap[i];
+    while (2 * i + 1 < count) {
+        unsigned child = 2 * i + 1;
+        if (child + 1 < count && heap[child + 1].exp > heap[child].exp)
+            child++;
+        if (heap[child].exp <= s.exp)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = s;
+}
+
+/**
+ * Moves a stream up the heap of streams to its place.
+ * @param heap : heap ordered by the decreasing exponents of the products
+ * @param i : index of the stream
+ */
+static void SiftUpDiv(DivStream heap[], unsigned i) {
+    DivStream s = heap[i];
+    while (i > 0 && heap[(i - 1) / 2].exp < s.exp) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = s;
+}
+
+/**
+ * Returns the monomials of a polynomial in the order of decreasing
+ * exponents. A constant is given as a single monomial with the exponent 0.
+ * @param[in] p : polynomial
+ * @param[out] single : room for the monomial of a constant
+ * @param[out] count : number of monomials
+ * @return array of monomials
+ */
+static const Mono **MonosDescending(const Poly *p, Mono *single,
+                                    unsigned *count) {
+    *count = PolyIsZero(p) ? 0 : PolyLength(p) + PolyIsCoeff(p);
+    const Mono **arr = calloc(*count + 1, sizeof(Mono *));
+    assert(arr != NULL);
+    const Mono *m = MonoList(p, single);
+    for (unsigned i = *count; i > 0; i--, m = m->next)
+        arr[i - 1] = m;
+    return arr;
+}
+
+/**
+ * Puts a monomial before the monomials of a list with larger exponents.
+ * @param list : list
+ * @param p : coefficient, which isn't zero
+ * @param exp : exponent smaller than the ones of the list
+ * @return monomial
+ */
+static Mono *MonoPrepend(Mono *list, Poly p, poly_exp_t exp) {
+    Mono *m = malloc(sizeof(Mono));
+    assert(m != NULL);
+    *m = (Mono) {.p = p, .exp = exp, .next = list};
+    return m;
+}
+
+/**
+ * Divides polynomials with a remainder by the main variable. The next
+ * monomial of the remainder comes from the dividend and the heap of
+ * the products of the quotient and the divisor without its leading
+ * monomial, as in Johnson's division, so the partial remainders aren't
+ * built. Its coefficient is divided by the leading coefficient of
+ * the divisor recursively.
+ * @param[in] p : dividend
+ * @param[in] q : divisor, which isn't zero
+ * @param[out] quot : quotient
+ * @param[out] rem : remainder
+ * @param[in] exact : whether to stop at the first monomial of
+ *                    the remainder
+ * @return false if it was stopped, true otherwise
+ */
+static bool PolyDivRemHelp(const Poly *p, const Poly *q, Poly *quot,
+                           Poly *rem, bool exact) {
+    assert(!PolyIsZero(q));
+    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+        /* The quotient of the smallest number by -1 doesn't fit. */
+        *quot = PolyFromCoeff(q->coeff == -1 ?
+                              (poly_coeff_t) (0UL - (unsigned long) p->coeff) :
+                              p->coeff / q->coeff);
+        *rem = PolyFromCoeff(q->coeff == -1 ? 0 : p->coeff % q->coeff);
+        return !exact || PolyIsZero(rem);
+    }
+    Mono singleP, singleQ;
+    unsigned countP, countQ, streams = 0, size = 0, k = 0;
+    const Mono **dividend = MonosDescending(p, &singleP, &countP);
+    const Mono **divisor = MonosDescending(q, &singleQ, &countQ);
+    const Mono *lead = divisor[0];
+    DivStream *heap = NULL;
+    *quot = *rem = PolyZero();
+    bool done = true;
+    while (k < countP || streams > 0) {
+        poly_exp_t exp = k < countP ? dividend[k]->exp : -1;
+        if (streams > 0 && heap[0].exp > exp)
+            exp = heap[0].exp;
+        Poly products = PolyZero();
+        while (streams > 0 && heap[0].exp == exp) {
+            DivStream *s = &heap[0];
+            PolyMulAdd(&products, &s->quot->p, &divisor[s->next]->p);
+            if (++s->next < countQ)
+                s->exp = s->quot->exp + divisor[s->next]->exp;
+            else
+                heap[0] = heap[--streams];
+            SiftDownDiv(heap, streams, 0);
+        }
+        Poly c;
+        if (k < countP && dividend[k]->exp == exp)
+            c = PolySub(&dividend[k++]->p, &products);
+        else
+            c = PolyNeg(&products);
+        PolyDestroy(&products);
+        if (PolyIsZero(&c))
+            continue;
+        Poly t = PolyZero(), r = c;
+        if (exp >= lead->exp) {
+            done = PolyDivRemHelp(&c, &lead->p, &t, &r, exact);
+            PolyDestroy(&c);
+        }
+        if (!PolyIsZero(&t)) {
+            quot->list = MonoPrepend(quot->list, t, exp - lead->exp);
+            if (countQ > 1) {
+                if (streams == size) {
+                    size = size == 0 ? 16 : 2 * size;
+                    heap = realloc(heap, size * sizeof(DivStream));
+                    assert(heap != NULL);
+                }
+                heap[streams] = (DivStream) {
+                    .quot = quot->list, .next = 1,
+                    .exp = quot->list->exp + divisor[1]->exp};
+                SiftUpDiv(heap, streams++);
+            }
+        }
+        if (!PolyIsZero(&r)) {
+            rem->list = MonoPrepend(rem->list, r, exp);
+            if (exact) {
+                done = false;
+                break;
+            }
+        }
+    }
+    free(heap);
+    free(dividend);
+    free(divisor);
+    PolyClose(quot);
+    PolyClose(rem);
+    return done;
+}
+
+void PolyDivRem(const Poly *p, const Poly *q, Poly *quot, Poly *rem) {
+    PolyDivRemHelp(p, q, quot, rem, false);
+}
+
+bool PolyDivExact(const Poly *p, const Poly *q, Poly *quot) {
+    Poly rem;
+    bool divisible = PolyDivRemHelp(p, q, quot, &rem, true);
+    PolyDestroy(&rem);
+    if (!divisible) {
+        PolyDestroy(quot);
+        *quot = PolyZero();
+    }
+    return divisible;
+}
+
 poly_exp_t PolyDegBy(const Poly *p, unsigned var_idx) {
     if (PolyIsCoeff(p)) {
         if (PolyIsZero(p))
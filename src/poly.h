@@ -41,6 +41,18 @@ typedef struct Mono {
     Mono* next; ///< next term of polynomial
 } Mono;
 
+struct ProductStream;
+
+/**
+ * Structure containing the state of the iteration over the monomials of
+ * a product of two polynomials. It can't be moved while it is used.
+ */
+typedef struct PolyProductIter {
+    struct ProductStream *heap; ///< streams of the products of monomials
+    unsigned count; ///< number of the streams
+    Mono single[2]; ///< monomials of the constant factors
+} PolyProductIter;
+
 /**
  * Builds a constant polynomial.
  * @param[in] c : coefficient
@@ -124,6 +136,13 @@ static inline Mono MonoClone(const Mono *m)
 	return (Mono) {.p = PolyClone(&m->p), .exp = m->exp, .next = NULL};
 }
 
+/**
+ * Returns the number of bytes held by the monomials of a polynomial.
+ * @param[in] p : polynomial
+ * @return number of bytes
+ */
+size_t PolyMemSize(const Poly *p);
+
 /**
  * Adds two polynomials.
  * @param[in] p : polynomial
@@ -141,6 +160,16 @@ Poly PolyAdd(const Poly *p, const Poly *q);
  */
 Poly PolyAddMonos(unsigned count, const Mono monos[]);
 
+/**
+ * Sums polynomials. The monomials of all of them are merged at once
+ * in the order of their exponents, and so are the coefficients of
+ * the monomials with the same exponent.
+ * @param[in] count : number of polynomials
+ * @param[in] polys : array of polynomials
+ * @return sum of the polynomials
+ */
+Poly PolyAddMany(unsigned count, const Poly polys[]);
+
 /**
  * Multiplies two polynomials.
  * @param[in] p : polynomial
@@ -149,6 +178,88 @@ Poly PolyAddMonos(unsigned count, const Mono monos[]);
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/**
+ * Multiplies polynomials. The two smallest factors are multiplied first
+ * and their product takes their place, until one polynomial is left.
+ * @param[in] count : number of polynomials
+ * @param[in] polys : array of polynomials
+ * @return product of the polynomials
+ */
+Poly PolyMulMany(unsigned count, const Poly polys[]);
+
+/**
+ * Adds the product of two polynomials to a polynomial in place.
+ * The products of the monomials are merged into @p acc in the order of
+ * their exponents, without building the product `p * q`.
+ * @param[in,out] acc : polynomial, which can't share monomials
+ *                      with @p p nor @p q
+ * @param[in] p : polynomial
+ * @param[in] q : polynomial
+ */
+void PolyMulAdd(Poly *acc, const Poly *p, const Poly *q);
+
+/**
+ * Computes the monomials of the product of two polynomials whose
+ * exponents are in a band. The products of the monomials outside
+ * the band aren't computed, so disjoint bands can be computed separately.
+ * @param[in] p : polynomial
+ * @param[in] q : polynomial
+ * @param[in] lo : lowest exponent of the band
+ * @param[in] hi : highest exponent of the band
+ * @return sum of the monomials of `p * q` with the exponents from @p lo
+ *         to @p hi
+ */
+Poly PolyMulBand(const Poly *p, const Poly *q, poly_exp_t lo,
+                 poly_exp_t hi);
+
+/**
+ * Bounds the number of the monomials of the product of two polynomials,
+ * counted on all levels, in time linear in their sizes and before
+ * anything is allocated for the product. The product takes at most
+ * `sizeof(Mono)` bytes per monomial, as counted by PolyMemSize.
+ * @param[in] p : polynomial
+ * @param[in] q : polynomial
+ * @return upper bound of the number of the monomials of `p * q`,
+ *         SIZE_MAX if it doesn't fit in size_t
+ */
+size_t PolyMulTermsBound(const Poly *p, const Poly *q);
+
+/**
+ * Bounds the number of the monomials of the product of polynomials,
+ * like PolyMulTermsBound.
+ * @param[in] count : number of polynomials
+ * @param[in] polys : array of polynomials
+ * @return upper bound of the number of the monomials of the product
+ */
+size_t PolyMulManyTermsBound(unsigned count, const Poly polys[]);
+
+/**
+ * Starts the iteration over the monomials of the product of two
+ * polynomials, which can't be changed until the iteration ends.
+ * The product isn't built, only one monomial at a time.
+ * @param[out] it : iterator
+ * @param[in] p : polynomial
+ * @param[in] q : polynomial
+ */
+void PolyProductBegin(PolyProductIter *it, const Poly *p, const Poly *q);
+
+/**
+ * Gives the next monomial of the product of two polynomials. The monomials
+ * are given in the order of their exponents and their coefficients aren't
+ * zero. A product which is a constant is given as one monomial with
+ * the exponent 0, if it isn't zero.
+ * @param[in,out] it : iterator
+ * @param[out] m : monomial, whose coefficient becomes owned by the caller
+ * @return false if there are no more monomials, true otherwise
+ */
+bool PolyProductNext(PolyProductIter *it, Mono *m);
+
+/**
+ * Ends the iteration over the monomials of a product.
+ * @param[in] it : iterator
+ */
+void PolyProductEnd(PolyProductIter *it);
+
 /**
  * Returns the negation of the polynomial.
  * @param[in] p : polynomial
@@ -164,6 +275,33 @@ Poly PolyNeg(const Poly *p);
  */
 Poly PolySub(const Poly *p, const Poly *q);
 
+/**
+ * Divides polynomials with a remainder by the main variable `x_0`, so that
+ * `p = quot * q + rem`. The monomials of what is left of the dividend are
+ * divided from the highest one while their exponents aren't smaller than
+ * the degree of @p q in `x_0`. Their coefficients are divided by
+ * the leading coefficient of @p q the same way, down to the division of
+ * integers rounding towards zero, and the remainders of those divisions
+ * are left in the remainder. The remainder is zero if and only if @p q
+ * divides @p p. It takes time proportional to the product of the sizes of
+ * the quotient and the divisor, times the logarithm of the first one.
+ * @param[in] p : dividend
+ * @param[in] q : divisor, which isn't zero
+ * @param[out] quot : quotient
+ * @param[out] rem : remainder
+ */
+void PolyDivRem(const Poly *p, const Poly *q, Poly *quot, Poly *rem);
+
+/**
+ * Divides polynomials exactly, like PolyDivRem. It stops at the first
+ * monomial of the remainder.
+ * @param[in] p : dividend
+ * @param[in] q : divisor, which isn't zero
+ * @param[out] quot : quotient if @p q divides @p p, zero otherwise
+ * @return whether @p q divides @p p
+ */
+bool PolyDivExact(const Poly *p, const Poly *q, Poly *quot);
+
 /**
  * Returns the degree of the polynomial in a given variable (return -1 
  * if the polynomial equals 0).
@@ -210,4 +348,16 @@ Poly PolyAt(const Poly *p, poly_coeff_t x);
  */
 Poly PolyCompose(const Poly *p, unsigned count, const Poly x[]);
 
+/**
+ * Bounds the number of the monomials of the composition of polynomials,
+ * like PolyMulTermsBound. The powers of the substituted polynomials are
+ * bounded by squaring, so the time is linear in the size of @p p times
+ * the logarithms of its exponents.
+ * @param[in] p : polynomial
+ * @param[in] count : number of the substituted polynomials
+ * @param[in] x : array of the substituted polynomials
+ * @return upper bound of the number of the monomials of PolyCompose
+ */
+size_t PolyComposeTermsBound(const Poly *p, unsigned count, const Poly x[]);
+
 #endif /* __POLY_H__ */
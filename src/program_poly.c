@@ -0,0 +1,448 @@
+/** @file
+   Implementation of the compiled programs of the calculator
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-03
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <unistd.h>
+#include "program_poly.h"
+#include "input_poly.h"
+#include "utils.h"
+
+/** magic number at the beginning of a program file */
+#define PROGRAM_MAGIC "POLYPRG"
+/** starting number of elements of the arrays of a program */
+#define PROGRAM_STARTING_SIZE 16
+
+/**
+ * Structure containing the header of a program file.
+ */
+typedef struct program_header {
+    char magic[8]; ///< PROGRAM_MAGIC
+    uint32_t version; ///< PROGRAM_VERSION
+    uint32_t reserved; ///< zero
+    uint64_t length; ///< number of instructions
+    uint64_t literals; ///< number of literal polynomials
+    uint64_t texts; ///< number of texts
+    uint64_t minDepth; ///< number of polynomials needed on the stack
+    uint64_t imageOffset; ///< offset of the image of the literals,
+                          ///< a multiple of the page size
+} ProgramHeader;
+
+/**
+ * Makes room for one more element of an array.
+ * @param arr : array
+ * @param count : number of elements
+ * @param size : number of allocated elements
+ * @param elem : size of an element
+ * @return array, moved if it had to grow
+ */
+static void *Reserve(void *arr, size_t count, size_t *size, size_t elem) {
+    if (count < *size) {
+        return arr;
+    }
+    *size = *size == 0 ? PROGRAM_STARTING_SIZE : 2 * *size;
+    arr = realloc(arr, *size * elem);
+    assert(arr != NULL);
+    return arr;
+}
+
+void ProgramInit(Program *prog) {
+    prog->code = NULL;
+    prog->length = prog->size = 0;
+    prog->literals = NULL;
+    prog->literalCount = prog->literalSize = 0;
+    prog->image = NULL;
+    prog->texts = NULL;
+    prog->textCount = prog->textSize = 0;
+    prog->minDepth = 0;
+}
+
+void ProgramEmit(Program *prog, int op, int line, long param) {
+    prog->code = Reserve(prog->code, prog->length, &prog->size,
+                         sizeof(Instruction));
+    prog->code[prog->length++] = (Instruction) {.op = op, .line = line,
+                                                .param = param};
+}
+
+long ProgramAddLiteral(Program *prog, Poly p) {
+    prog->literals = Reserve(prog->literals, prog->literalCount,
+                             &prog->literalSize, sizeof(Poly));
+    prog->literals[prog->literalCount] = p;
+    return (long) prog->literalCount++;
+}
+
+long ProgramAddText(Program *prog, const char *text) {
+    prog->texts = Reserve(prog->texts, prog->textCount, &prog->textSize,
+                          sizeof(char *));
+    char *copy = malloc(strlen(text) + 1);
+    assert(copy != NULL);
+    strcpy(copy, text);
+    prog->texts[prog->textCount] = copy;
+    return (long) prog->textCount++;
+}
+
+/**
+ * Writes the image of the polynomial whose coefficients are the literals.
+ * The polynomial shares the literals, only its monomials are made.
+ * @param prog
+ * @param f
+ * @param path : path of the file
+ * @return true if the writing failed, false otherwise
+ */
+static bool WriteLiterals(const Program *prog, FILE *f, const char *path) {
+    Mono *monos = malloc((prog->literalCount + 1) * sizeof(Mono));
+    assert(monos != NULL);
+    Poly bundle = PolyZero();
+    Mono **last = &bundle.list;
+    for (size_t i = 0; i < prog->literalCount; i++) {
+        if (!PolyIsZero(&prog->literals[i])) {
+            Mono *m = &monos[i];
+            *m = (Mono) {.p = prog->literals[i], .exp = (poly_exp_t) i,
+                         .next = NULL};
+            *last = m;
+            last = &m->next;
+        }
+    }
+    bool error = ImageWrite(f, path, &bundle);
+    free(monos);
+    return error;
+}
+
+/**
+ * Writes the parts of a program after the header.
+ * @param prog
+ * @param f
+ * @param path : path of the file
+ * @param imageOffset : offset of the image of the literals
+ * @return true if the writing failed, false otherwise
+ */
+static bool WriteBody(const Program *prog, FILE *f, const char *path,
+                      uint64_t *imageOffset) {
+    if (prog->length > 0 &&
+        fwrite(prog->code, sizeof(Instruction), prog->length, f) !=
+        prog->length) {
+        return true;
+    }
+    for (size_t i = 0; i < prog->textCount; i++) {
+        uint32_t length = strlen(prog->texts[i]);
+        if (fwrite(&length, sizeof(length), 1, f) != 1 ||
+            fwrite(prog->texts[i], 1, length, f) != length) {
+            return true;
+        }
+    }
+    /* The image is mapped, so it has to start at a page. */
+    long page = sysconf(_SC_PAGESIZE), position = ftell(f);
+    if (page <= 0 || position < 0) {
+        return true;
+    }
+    for (; position % page != 0; position++) {
+        if (fputc(0, f) == EOF) {
+            return true;
+        }
+    }
+    *imageOffset = position;
+    return WriteLiterals(prog, f, path);
+}
+
+bool ProgramWrite(const Program *prog, const char *path) {
+    /* An old program may still be mapped, so it isn't truncated. */
+    unlink(path);
+    FILE *f = fopen(path, "w+b");
+    if (f == NULL) {
+        return true;
+    }
+    ProgramHeader header;
+    memset(&header, 0, sizeof(header));
+    bool error = fwrite(&header, sizeof(header), 1, f) != 1 ||
+                 WriteBody(prog, f, path, &header.imageOffset);
+    memcpy(header.magic, PROGRAM_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_VERSION;
+    header.length = prog->length;
+    header.literals = prog->literalCount;
+    header.texts = prog->textCount;
+    header.minDepth = prog->minDepth;
+    /* The header is written last, so an incomplete file is never taken
+       for a program. */
+    error = error || fseek(f, 0, SEEK_SET) != 0 ||
+            fwrite(&header, sizeof(header), 1, f) != 1;
+    if (fclose(f) != 0 || error) {
+        remove(path);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Maps the image of the literals and finds them in its polynomial.
+ * @param prog
+ * @param header
+ * @param f
+ * @return true if the image is incorrect, false otherwise
+ */
+static bool MapLiterals(Program *prog, const ProgramHeader *header, FILE *f) {
+    if (header->imageOffset > INT64_MAX ||
+        header->literals >= SIZE_MAX / sizeof(Poly)) {
+        return true;
+    }
+    Poly bundle;
+    prog->image = ImageMap(fileno(f), (off_t) header->imageOffset, &bundle);
+    if (prog->image == NULL) {
+        return true;
+    }
+    prog->literalCount = prog->literalSize = header->literals;
+    prog->literals = malloc((prog->literalCount + 1) * sizeof(Poly));
+    assert(prog->literals != NULL);
+    for (size_t i = 0; i < prog->literalCount; i++) {
+        prog->literals[i] = PolyZero();
+    }
+    if (PolyIsCoeff(&bundle)) {
+        return !PolyIsZero(&bundle);
+    }
+    for (const Mono *m = bundle.list; m != NULL; m = m->next) {
+        if (m->exp < 0 || (uint64_t) m->exp >= header->literals) {
+            return true;
+        }
+        prog->literals[m->exp] = m->p;
+    }
+    return false;
+}
+
+/**
+ * Reads the parts of a program after the header.
+ * @param prog : empty program
+ * @param header
+ * @param f
+ * @return true if the file is too short or damaged, false otherwise
+ */
+static bool ReadBody(Program *prog, const ProgramHeader *header, FILE *f) {
+    for (uint64_t i = 0; i < header->length; i++) {
+        Instruction ins;
+        if (fread(&ins, sizeof(ins), 1, f) != 1) {
+            return true;
+        }
+        ProgramEmit(prog, ins.op, ins.line, ins.param);
+    }
+    for (uint64_t i = 0; i < header->texts; i++) {
+        uint32_t length;
+        if (fread(&length, sizeof(length), 1, f) != 1) {
+            return true;
+        }
+        char *text = malloc((size_t) length + 1);
+        assert(text != NULL);
+        bool error = fread(text, 1, length, f) != length;
+        text[length] = '\0';
+        if (!error) {
+            ProgramAddText(prog, text);
+        }
+        free(text);
+        if (error) {
+            return true;
+        }
+    }
+    long position = ftell(f);
+    return position < 0 || (uint64_t) position > header->imageOffset ||
+           MapLiterals(prog, header, f);
+}
+
+bool ProgramRead(Program *prog, const char *path) {
+    ProgramInit(prog);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return true;
+    }
+    ProgramHeader header;
+    bool error = fread(&header, sizeof(header), 1, f) != 1 ||
+                 memcmp(header.magic, PROGRAM_MAGIC,
+                        sizeof(header.magic)) != 0 ||
+                 header.version != PROGRAM_VERSION ||
+                 ReadBody(prog, &header, f);
+    fclose(f);
+    if (error) {
+        ProgramFree(prog);
+        return true;
+    }
+    prog->minDepth = header.minDepth;
+    return false;
+}
+
+void ProgramFree(Program *prog) {
+    if (prog->image != NULL) {
+        ImageRelease(prog->image);
+    }
+    else {
+        for (size_t i = 0; i < prog->literalCount; i++) {
+            PolyDestroy(&prog->literals[i]);
+        }
+    }
+    for (size_t i = 0; i < prog->textCount; i++) {
+        free(prog->texts[i]);
+    }
+    free(prog->code);
+    free(prog->literals);
+    free(prog->texts);
+    ProgramInit(prog);
+}
+
+/**
+ * Finds the first instruction of a compiled program which would find
+ * too few polynomials on the stack, without running the program.
+ * The other errors of the instructions are assumed not to happen.
+ * @param prog
+ * @param depth : number of polynomials on the stack at the start
+ * @param minDepth : number of polynomials needed at the start
+ * @return index of the instruction or the length of the program
+ */
+static size_t FindUnderflow(const Program *prog, long depth,
+                            size_t *minDepth) {
+    size_t first = prog->length;
+    *minDepth = 0;
+    for (size_t i = 0; i < prog->length; i++) {
+        long pops, pushes;
+        StackEffect(prog->code[i].op, prog->code[i].param, &pops, &pushes);
+        if (pops > depth) {
+            if (first == prog->length) {
+                first = i;
+            }
+            if ((size_t) (pops - depth) > *minDepth) {
+                *minDepth = pops - depth;
+            }
+        }
+        depth += pushes - pops;
+    }
+    return first;
+}
+
+/**
+ * Compiles the lines of the input to a program. The wrong lines are
+ * reported like when they are executed.
+ * @param prog : empty program
+ * @return true if there were wrong lines, false otherwise
+ */
+static bool CompileLines(Program *prog) {
+    CommandAndParam cap;
+    int lineCount = 1, line = CheckLinePolyOrCommand();
+    int c = 0;
+    bool error = false;
+    while (c != EOF && line != VAL_IF_EOF) {
+        if (line == VAL_IF_POLY) {
+            Poly p;
+            if (!ParsePoly(&p, lineCount)) {
+                ProgramEmit(prog, PUSH_LITERAL_OP, lineCount,
+                            ProgramAddLiteral(prog, p));
+            }
+            else {
+                error = true;
+            }
+        }
+        else if (!ParseCommand(&cap, lineCount)) {
+            const char *text = TextParam(&cap);
+            ProgramEmit(prog, cap.id, lineCount,
+                        text != NULL ? ProgramAddText(prog, text) :
+                                       NumericParam(&cap));
+        }
+        else {
+            error = true;
+        }
+        ForwardToNewLine();
+        c = InputGetc();
+        if (c != EOF) {
+            line = CheckLinePolyOrCommand();
+            lineCount++;
+        }
+    }
+    FindUnderflow(prog, 0, &prog->minDepth);
+    return error;
+}
+
+/**
+ * Checks if the instructions of a program read from a file are correct.
+ * @param prog
+ * @return true if there is a wrong instruction, false otherwise
+ */
+static bool CheckProgram(const Program *prog) {
+    for (size_t i = 0; i < prog->length; i++) {
+        const Instruction *ins = &prog->code[i];
+        if (ins->op < 0 || ins->op > PUSH_LITERAL_OP) {
+            return true;
+        }
+        if (ins->op == PUSH_LITERAL_OP) {
+            if (ins->param < 0 || (size_t) ins->param >= prog->literalCount) {
+                return true;
+            }
+        }
+        else if (HasTextParam(ins->op)) {
+            if (ins->param < 0 || (size_t) ins->param >= prog->textCount) {
+                return true;
+            }
+        }
+        else if (ins->op == DEG_BY_ID &&
+                 (ins->param < 0 || ins->param > INT_MAX) ||
+                 (ins->op == COMPOSE_ID || ins->op == ADD_N_ID ||
+                  ins->op == MUL_N_ID) &&
+                 (ins->param < 0 || ins->param > UINT_MAX)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RunProgram(Calculator *calc, const Program *prog) {
+    Stack *stack = &calc->stack;
+    if (Depth(stack) < prog->minDepth) {
+        size_t minDepth;
+        UnderflowErrorMsg(prog->code[FindUnderflow(prog, (long) Depth(stack),
+                                                   &minDepth)].line);
+        return true;
+    }
+    for (size_t i = 0; i < prog->length; i++) {
+        const Instruction *ins = &prog->code[i];
+        int error;
+        if (ins->op == PUSH_LITERAL_OP) {
+            /* The literals are shared with the image of the program. */
+            error = PushImage(stack, prog->literals[ins->param],
+                              prog->image) ? ERROR_MEMORY : NO_ERROR;
+        }
+        else {
+            bool hasText = HasTextParam(ins->op);
+            error = ExecuteCommand(calc, ins->op, hasText ? 0 : ins->param,
+                                   hasText ? prog->texts[ins->param] : NULL,
+                                   ins->line);
+        }
+        CommandErrorMsg(error, ins->line);
+    }
+    return false;
+}
+
+int CompileProgram(const char *path) {
+    Program prog;
+    ProgramInit(&prog);
+    InputOpen(STDIN_FILENO);
+    int result = CompileLines(&prog) ? 1 : 0;
+    InputClose();
+    if (result == 0 && ProgramWrite(&prog, path)) {
+        fprintf(stderr, "Cannot write the program %s\n", path);
+        result = 1;
+    }
+    ProgramFree(&prog);
+    return result;
+}
+
+bool LoadProgram(Program *prog, const char *path) {
+    if (ProgramRead(prog, path)) {
+        return true;
+    }
+    if (CheckProgram(prog)) {
+        ProgramFree(prog);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,141 @@
+/** @file
+   Interface of the compiled programs of the calculator
+
+   A program is a list of instructions made from the lines of a script.
+   The literal polynomials of the script are parsed once and the parameters
+   which are texts are kept in a table, so running a program reads no text
+   at all. A program file ends with an image of a polynomial whose
+   coefficient at x^i is the i-th literal, so the literals of a read
+   program are mapped and used in place like the polynomials of images.
+   The operations are the commands of the calculator and PUSH_LITERAL_OP,
+   which pushes a literal.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-03
+*/
+
+#ifndef __PROGRAM_POLY_H__
+#define __PROGRAM_POLY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "poly.h"
+#include "image_poly.h"
+#include "calc_poly.h"
+
+/** version of the format of the program files */
+#define PROGRAM_VERSION 1
+
+/**
+ * Structure containing an instruction of a program.
+ */
+typedef struct instruction {
+    int op; ///< operation
+    int line; ///< number of the line of the script
+    long param; ///< numeric parameter or index of a literal or a text
+} Instruction;
+
+/**
+ * Structure containing a program.
+ */
+typedef struct program {
+    Instruction *code; ///< instructions
+    size_t length; ///< number of instructions
+    size_t size; ///< number of allocated instructions
+    Poly *literals; ///< literal polynomials
+    size_t literalCount; ///< number of literal polynomials
+    size_t literalSize; ///< number of allocated literal polynomials
+    Image *image; ///< image holding the literals of a read program or NULL
+                  ///< if they are owned by the program
+    char **texts; ///< parameters which are texts
+    size_t textCount; ///< number of texts
+    size_t textSize; ///< number of allocated texts
+    size_t minDepth; ///< number of polynomials needed on the stack
+                     ///< before the program is run
+} Program;
+
+/**
+ * Initializes an empty program.
+ * @param[in] prog : program
+ */
+void ProgramInit(Program *prog);
+
+/**
+ * Adds an instruction at the end of the program.
+ * @param[in] prog : program
+ * @param[in] op : operation
+ * @param[in] line : number of the line of the script
+ * @param[in] param : parameter
+ */
+void ProgramEmit(Program *prog, int op, int line, long param);
+
+/**
+ * Adds a literal polynomial to the program. Takes ownership of
+ * the polynomial @p p.
+ * @param[in] prog : program
+ * @param[in] p : polynomial
+ * @return index of the literal
+ */
+long ProgramAddLiteral(Program *prog, Poly p);
+
+/**
+ * Adds a copy of a text to the program.
+ * @param[in] prog : program
+ * @param[in] text : text
+ * @return index of the text
+ */
+long ProgramAddText(Program *prog, const char *text);
+
+/**
+ * Writes a program to a file.
+ * The format is meant only for the files read by the same program.
+ * @param[in] prog : program
+ * @param[in] path : path of the file
+ * @return true if the file couldn't be written, false otherwise
+ */
+bool ProgramWrite(const Program *prog, const char *path);
+
+/**
+ * Reads a program written by ProgramWrite. The operations and
+ * the parameters have to be checked by the user of the program.
+ * The literals are held by the image of the program.
+ * @param[out] prog : program
+ * @param[in] path : path of the file
+ * @return true if the file isn't a correct program, false otherwise
+ */
+bool ProgramRead(Program *prog, const char *path);
+
+/**
+ * Deletes the program and its literals or releases its image.
+ * @param[in] prog : program
+ */
+void ProgramFree(Program *prog);
+
+/**
+ * Runs a compiled program on the stack. Nothing is run if the stack
+ * has too few polynomials for the program, the first instruction which
+ * would find too few is reported instead.
+ * @param[in] calc : calculator
+ * @param[in] prog : program
+ * @return true if the stack had too few polynomials, false otherwise
+ */
+bool RunProgram(Calculator *calc, const Program *prog);
+
+/**
+ * Compiles the standard input to a program file. The wrong lines are
+ * reported like when they are executed.
+ * @param[in] path : path of the file
+ * @return exit code of the program
+ */
+int CompileProgram(const char *path);
+
+/**
+ * Reads a program file and checks its instructions.
+ * @param[out] prog : program
+ * @param[in] path : path of the file
+ * @return true if the file isn't a correct program, false otherwise
+ */
+bool LoadProgram(Program *prog, const char *path);
+
+#endif /* __PROGRAM_POLY_H__ */
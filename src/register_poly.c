@@ -0,0 +1,145 @@
+/** @file
+   Implementation of the named registers of polynomials
+
+   The table uses open addressing with linear probing. A deleted register
+   is filled by moving the following registers of its probe sequence back,
+   so there are no tombstones.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-01
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "register_poly.h"
+
+/** starting number of slots of the table */
+#define REGISTERS_STARTING_SIZE 16
+
+/**
+ * Computes the FNV-1a hash of a name.
+ * @param name
+ * @return
+ */
+static uint64_t Hash(const char *name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *c = name; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Finds the slot of a register or the free slot where it would be put.
+ * @param r : table with at least one free slot
+ * @param name
+ * @return
+ */
+static RegisterEntry *Slot(Registers *r, const char *name) {
+    size_t mask = r->size - 1;
+    for (size_t i = Hash(name) & mask; ; i = (i + 1) & mask) {
+        RegisterEntry *e = &r->arr[i];
+        if (e->name == NULL || strcmp(e->name, name) == 0) {
+            return e;
+        }
+    }
+}
+
+/**
+ * Doubles the number of slots of the table if it is at least half full.
+ * @param r
+ */
+static void Grow(Registers *r) {
+    if (2 * (r->count + 1) <= r->size) {
+        return;
+    }
+    RegisterEntry *old = r->arr;
+    size_t oldSize = r->size;
+    r->size = oldSize == 0 ? REGISTERS_STARTING_SIZE : 2 * oldSize;
+    r->arr = calloc(r->size, sizeof(RegisterEntry));
+    assert(r->arr != NULL);
+    for (size_t i = 0; i < oldSize; i++) {
+        if (old[i].name != NULL) {
+            *Slot(r, old[i].name) = old[i];
+        }
+    }
+    free(old);
+}
+
+void RegistersInit(Registers *r) {
+    r->arr = NULL;
+    r->size = r->count = 0;
+    pthread_mutex_init(&r->lock, NULL);
+}
+
+void RegisterStore(Registers *r, const char *name, Poly p, Image *image) {
+    pthread_mutex_lock(&r->lock);
+    Grow(r);
+    RegisterEntry *e = Slot(r, name);
+    ImageRetain(image);
+    if (e->name != NULL) {
+        ImageRelease(e->image);
+    }
+    else {
+        e->name = strdup(name);
+        assert(e->name != NULL);
+        r->count++;
+    }
+    e->p = p;
+    e->image = image;
+    pthread_mutex_unlock(&r->lock);
+}
+
+bool RegisterGet(Registers *r, const char *name, Poly *p, Image **image) {
+    pthread_mutex_lock(&r->lock);
+    RegisterEntry *e = r->count == 0 ? NULL : Slot(r, name);
+    bool error = e == NULL || e->name == NULL;
+    if (!error) {
+        *p = e->p;
+        *image = e->image;
+        ImageRetain(e->image);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return error;
+}
+
+bool RegisterDrop(Registers *r, const char *name) {
+    pthread_mutex_lock(&r->lock);
+    RegisterEntry *e = r->count == 0 ? NULL : Slot(r, name);
+    if (e == NULL || e->name == NULL) {
+        pthread_mutex_unlock(&r->lock);
+        return true;
+    }
+    free(e->name);
+    ImageRelease(e->image);
+    r->count--;
+    size_t mask = r->size - 1, hole = e - r->arr;
+    /* Moves back the registers which couldn't be found over the hole. */
+    for (size_t i = (hole + 1) & mask; r->arr[i].name != NULL;
+         i = (i + 1) & mask) {
+        size_t home = Hash(r->arr[i].name) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            r->arr[hole] = r->arr[i];
+            hole = i;
+        }
+    }
+    r->arr[hole].name = NULL;
+    pthread_mutex_unlock(&r->lock);
+    return false;
+}
+
+void RegistersClear(Registers *r) {
+    for (size_t i = 0; i < r->size; i++) {
+        if (r->arr[i].name != NULL) {
+            free(r->arr[i].name);
+            ImageRelease(r->arr[i].image);
+        }
+    }
+    free(r->arr);
+    r->arr = NULL;
+    r->size = r->count = 0;
+    pthread_mutex_destroy(&r->lock);
+}
@@ -0,0 +1,82 @@
+/** @file
+   Interface of the named registers of polynomials
+
+   A register shares its polynomial through an image, so putting it
+   on the stack doesn't copy the polynomial. The table may be used
+   by many threads at once.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-01
+*/
+
+#ifndef __REGISTER_POLY_H__
+#define __REGISTER_POLY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "poly.h"
+#include "image_poly.h"
+
+/**
+ * Structure containing a register
+ */
+typedef struct register_entry {
+    char *name; ///< name of the register or NULL if the slot is free
+    Poly p; ///< polynomial held by the image
+    Image *image; ///< image holding the polynomial
+} RegisterEntry;
+
+/**
+ * Structure containing the hash table of the registers
+ */
+typedef struct registers {
+    RegisterEntry *arr; ///< slots of the table, their number is a power of 2
+    size_t size; ///< number of slots
+    size_t count; ///< number of registers
+    pthread_mutex_t lock; ///< lock of the table
+} Registers;
+
+/**
+ * Initializes an empty table of registers.
+ * @param[in] r : table of registers
+ */
+void RegistersInit(Registers *r);
+
+/**
+ * Sets a register to a polynomial held by an image. Adds a reference
+ * to the image and removes the reference of the previous polynomial
+ * of the register.
+ * @param[in] r : table of registers
+ * @param[in] name : name of the register
+ * @param[in] p : polynomial held by the image
+ * @param[in] image : image
+ */
+void RegisterStore(Registers *r, const char *name, Poly p, Image *image);
+
+/**
+ * Finds a register and adds a reference to the image of its polynomial.
+ * @param[in] r : table of registers
+ * @param[in] name : name of the register
+ * @param[out] p : polynomial held by the image
+ * @param[out] image : image
+ * @return true if there is no such register, false otherwise
+ */
+bool RegisterGet(Registers *r, const char *name, Poly *p, Image **image);
+
+/**
+ * Deletes a register.
+ * @param[in] r : table of registers
+ * @param[in] name : name of the register
+ * @return true if there is no such register, false otherwise
+ */
+bool RegisterDrop(Registers *r, const char *name);
+
+/**
+ * Deletes all registers and frees the memory of the table.
+ * @param[in] r : table of registers
+ */
+void RegistersClear(Registers *r);
+
+#endif /* __REGISTER_POLY_H__ */
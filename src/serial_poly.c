@@ -0,0 +1,56 @@
+/** @file
+   Implementation of the binary serialization of polynomials
+
+   A polynomial is written in prefix order: the number of its monomials
+   followed either by the coefficient (if there are no monomials) or by
+   the exponent and the coefficient polynomial of every monomial.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-24
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "serial_poly.h"
+
+bool PolyWrite(FILE *f, const Poly *p) {
+    uint32_t count = 0;
+    for (Mono *m = p->list; m != NULL; m = m->next)
+        count++;
+    if (fwrite(&count, sizeof(count), 1, f) != 1)
+        return true;
+    if (count == 0)
+        return fwrite(&p->coeff, sizeof(p->coeff), 1, f) != 1;
+    for (Mono *m = p->list; m != NULL; m = m->next) {
+        if (fwrite(&m->exp, sizeof(m->exp), 1, f) != 1 || PolyWrite(f, &m->p))
+            return true;
+    }
+    return false;
+}
+
+bool PolyRead(FILE *f, Poly *p) {
+    uint32_t count;
+    if (fread(&count, sizeof(count), 1, f) != 1)
+        return true;
+    *p = PolyZero();
+    if (count == 0)
+        return fread(&p->coeff, sizeof(p->coeff), 1, f) != 1;
+    Mono **last = &p->list;
+    for (uint32_t i = 0; i < count; i++) {
+        Mono *m = malloc(sizeof(Mono));
+        if (m == NULL) {
+            PolyDestroy(p);
+            return true;
+        }
+        m->next = NULL;
+        m->p = PolyZero();
+        *last = m;
+        last = &m->next;
+        if (fread(&m->exp, sizeof(m->exp), 1, f) != 1 || PolyRead(f, &m->p)) {
+            PolyDestroy(p);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,32 @@
+/** @file
+   Interface of the binary serialization of polynomials
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-06-24
+*/
+
+#ifndef __SERIAL_POLY_H__
+#define __SERIAL_POLY_H__
+
+#include <stdio.h>
+#include "poly.h"
+
+/**
+ * Writes a polynomial to a binary stream.
+ * The format is meant only for the files read by the same program.
+ * @param[in] f : stream
+ * @param[in] p : polynomial
+ * @return true if the writing failed, false otherwise
+ */
+bool PolyWrite(FILE *f, const Poly *p);
+
+/**
+ * Reads a polynomial written by PolyWrite from a binary stream.
+ * @param[in] f : stream
+ * @param[out] p : polynomial
+ * @return true if the reading failed, false otherwise
+ */
+bool PolyRead(FILE *f, Poly *p);
+
+#endif /* __SERIAL_POLY_H__ */
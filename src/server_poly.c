@@ -0,0 +1,312 @@
+/** @file
+   Implementation of the server of the polynomial calculator
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-02
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server_poly.h"
+#include "input_poly.h"
+#include "output_poly.h"
+#include "utils.h"
+
+/** number of accepted connections waiting for a worker thread */
+#define SERVER_QUEUE_SIZE 64
+/** number of connections waiting to be accepted */
+#define SERVER_BACKLOG 64
+/** smallest number of seconds between the reports of the latencies of
+ * a running session */
+#define LATENCY_REPORT_INTERVAL 1
+
+/**
+ * Structure containing the state of the server
+ */
+typedef struct server {
+    int fds[SERVER_QUEUE_SIZE]; ///< queue of the accepted connections
+    unsigned long ids[SERVER_QUEUE_SIZE]; ///< numbers of the connections
+    size_t head; ///< index of the first connection in the queue
+    size_t count; ///< number of connections in the queue
+    bool closed; ///< whether no more connections are accepted
+    pthread_mutex_t lock; ///< lock of the queue
+    pthread_cond_t notEmpty; ///< signalled when a connection is queued
+    pthread_cond_t notFull; ///< signalled when a connection is taken
+    ServerSession session; ///< function serving a connection
+    void *arg; ///< argument of the function
+} Server;
+
+/** Whether SIGINT or SIGTERM was received. */
+static volatile sig_atomic_t stopping = 0;
+
+/**
+ * Handles SIGINT and SIGTERM.
+ * @param sig
+ */
+static void Stop(int sig) {
+    (void) sig;
+    stopping = 1;
+}
+
+/**
+ * Queues an accepted connection, waiting if the queue is full.
+ * @param server
+ * @param fd
+ * @param id
+ */
+static void Enqueue(Server *server, int fd, unsigned long id) {
+    pthread_mutex_lock(&server->lock);
+    while (server->count == SERVER_QUEUE_SIZE) {
+        pthread_cond_wait(&server->notFull, &server->lock);
+    }
+    size_t i = (server->head + server->count++) % SERVER_QUEUE_SIZE;
+    server->fds[i] = fd;
+    server->ids[i] = id;
+    pthread_cond_signal(&server->notEmpty);
+    pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Takes a connection from the queue, waiting if it is empty.
+ * @param server
+ * @param fd
+ * @param id
+ * @return true if the queue is empty and closed, false otherwise
+ */
+static bool Dequeue(Server *server, int *fd, unsigned long *id) {
+    pthread_mutex_lock(&server->lock);
+    while (server->count == 0 && !server->closed) {
+        pthread_cond_wait(&server->notEmpty, &server->lock);
+    }
+    bool empty = server->count == 0;
+    if (!empty) {
+        *fd = server->fds[server->head];
+        *id = server->ids[server->head];
+        server->head = (server->head + 1) % SERVER_QUEUE_SIZE;
+        server->count--;
+        pthread_cond_signal(&server->notFull);
+    }
+    pthread_mutex_unlock(&server->lock);
+    return empty;
+}
+
+/**
+ * Serves the queued connections.
+ * @param arg : server
+ * @return
+ */
+static void *Worker(void *arg) {
+    Server *server = arg;
+    int fd;
+    unsigned long id;
+    while (!Dequeue(server, &fd, &id)) {
+        server->session(fd, id, server->arg);
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * Creates the listening socket. Removes a socket left at the path.
+ * @param path
+ * @return socket or -1 if it couldn't be created
+ */
+static int Listen(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+        listen(fd, SERVER_BACKLOG) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool ServerRun(const char *path, size_t workers, ServerSession session,
+               void *arg) {
+    int listener = Listen(path);
+    if (listener < 0) {
+        return true;
+    }
+    Server server = {.head = 0, .count = 0, .closed = false,
+                     .session = session, .arg = arg};
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.notEmpty, NULL);
+    pthread_cond_init(&server.notFull, NULL);
+
+    /* The signals are handled only by the accepting thread. */
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = Stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t blocked, old;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &old);
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    assert(threads != NULL);
+    size_t started = 0;
+    while (started < workers &&
+           pthread_create(&threads[started], NULL, Worker, &server) == 0) {
+        started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    unsigned long id = 0;
+    while (started == workers && !stopping) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0) {
+            Enqueue(&server, fd, ++id);
+        }
+    }
+
+    close(listener);
+    unlink(path);
+    pthread_mutex_lock(&server.lock);
+    server.closed = true;
+    pthread_cond_broadcast(&server.notEmpty);
+    pthread_mutex_unlock(&server.lock);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_cond_destroy(&server.notFull);
+    pthread_cond_destroy(&server.notEmpty);
+    pthread_mutex_destroy(&server.lock);
+    return started < workers;
+}
+
+/**
+ * Returns the bound of the times of a given fraction of the lines.
+ * @param latency
+ * @param fraction
+ * @return number of microseconds
+ */
+static unsigned long LatencyPercentile(const Latency *latency,
+                                       double fraction) {
+    unsigned long seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += latency->histogram[bucket];
+        if (seen >= fraction * latency->count) {
+            return 1UL << bucket;
+        }
+    }
+    return 1UL << (LATENCY_BUCKETS - 1);
+}
+
+/**
+ * Prints the latencies of the lines of a session so far on the standard
+ * error.
+ * @param latency
+ * @param closed : whether the session is closed
+ */
+static void ReportLatency(const Latency *latency, bool closed) {
+    if (latency->count == 0) {
+        return;
+    }
+    fprintf(stderr, "session %lu%s: %lu lines, mean %.1f us, "
+                    "p50 < %lu us, p99 < %lu us, max %.1f us\n",
+            latency->id, closed ? " closed" : "", latency->count,
+            latency->total / latency->count,
+            LatencyPercentile(latency, 0.5),
+            LatencyPercentile(latency, 0.99), latency->max);
+}
+
+void AddLatency(Latency *latency, const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double micros = (end.tv_sec - start->tv_sec) * 1e6 +
+                    (end.tv_nsec - start->tv_nsec) / 1e3;
+    int bucket = 0;
+    while (bucket + 1 < LATENCY_BUCKETS && micros >= (double) (1UL << bucket)) {
+        bucket++;
+    }
+    latency->count++;
+    latency->total += micros;
+    if (micros > latency->max) {
+        latency->max = micros;
+    }
+    latency->histogram[bucket]++;
+    if (end.tv_sec - latency->reported.tv_sec >= LATENCY_REPORT_INTERVAL) {
+        ReportLatency(latency, false);
+        latency->reported = end;
+    }
+}
+
+int ExecuteConfined(Calculator *calc, int id, long param, const char *text,
+                    int lineCount) {
+    if (id != SAVE_ID && id != LOAD_ID && id != CHECKPOINT_ID &&
+        id != MUL_SAVE_ID) {
+        return ExecuteCommand(calc, id, param, text, lineCount);
+    }
+    const char *dir = calc->opts->serverDir;
+    if (dir == NULL || text[0] == '\0' || strchr(text, '/') != NULL ||
+        strcmp(text, ".") == 0 || strcmp(text, "..") == 0) {
+        return ERROR_CONFINED;
+    }
+    char *path = JoinPath(dir, text, strlen(text));
+    int error = ExecuteCommand(calc, id, param, path, lineCount);
+    free(path);
+    return error;
+}
+
+void ServeSession(int fd, unsigned long id, void *arg) {
+    const Calculator *server = arg;
+    Latency latency;
+    memset(&latency, 0, sizeof(latency));
+    latency.id = id;
+    clock_gettime(CLOCK_MONOTONIC, &latency.reported);
+    Calculator calc = {.registers = server->registers, .opts = server->opts,
+                       .latency = &latency, .confined = true};
+    Init(&calc.stack, calc.opts->memLimit);
+    if (calc.opts->spillFile != NULL) {
+        /* Every session needs its own spill file. */
+        size_t length = strlen(calc.opts->spillFile) + 2 +
+                        OUTPUT_MAX_NUMBER_LENGTH;
+        char *path = malloc(length);
+        assert(path != NULL);
+        snprintf(path, length, "%s.%lu", calc.opts->spillFile, id);
+        if (SetSpill(&calc.stack, path, calc.opts->spillDepth)) {
+            fprintf(stderr, "Cannot create the spill file %s\n", path);
+        }
+        free(path);
+    }
+    CheckpointInit(&calc.checkpoint);
+    SetErrorsToOutput(true);
+    OutputOpen(fd);
+    InputOpen(fd);
+    InputSetIdle(OutputFlush);
+    RunLines(&calc, 1);
+    InputClose();
+    OutputClose();
+    Clear(&calc.stack);
+    CheckpointFree(&calc.checkpoint);
+    ReportLatency(&latency, true);
+}
@@ -0,0 +1,95 @@
+/** @file
+   Interface of the server of the polynomial calculator
+
+   The server listens on a Unix domain socket. Every connection is served
+   by one of a fixed number of worker threads. The connections of
+   the calculator are its sessions, each with its own stack, whose
+   latencies are reported on the standard error.
+
+   @author Jan Łanecki <jl385826@students.mimuw.edu.pl>
+   @copyright University of Warsaw, Poland
+   @date 2017-07-02
+*/
+
+#ifndef __SERVER_POLY_H__
+#define __SERVER_POLY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "calc_poly.h"
+
+/** number of buckets of the histogram of the latencies */
+#define LATENCY_BUCKETS 32
+
+/**
+ * Function serving a connection until it is closed by the client.
+ * @param[in] fd : socket of the connection, closed by the server
+ * @param[in] id : number of the connection
+ * @param[in] arg : argument given to ServerRun
+ */
+typedef void (*ServerSession)(int fd, unsigned long id, void *arg);
+
+/**
+ * Structure for the latencies of the lines of a session.
+ */
+typedef struct latency {
+    unsigned long id; ///< id of the session
+    struct timespec reported; ///< time of the last report
+    unsigned long count; ///< number of lines
+    double total; ///< sum of the times in microseconds
+    double max; ///< maximal time in microseconds
+    unsigned long histogram[LATENCY_BUCKETS]; ///< number of lines by
+                                              ///< the binary logarithm of
+                                              ///< the time in microseconds
+} Latency;
+
+/**
+ * Serves the connections to a Unix domain socket until SIGINT or SIGTERM
+ * is received. Waits for the connections being served before it returns.
+ * @param[in] path : path of the socket
+ * @param[in] workers : number of worker threads
+ * @param[in] session : function serving a connection
+ * @param[in] arg : argument of the function
+ * @return true if the socket or the threads couldn't be created,
+ * false otherwise
+ */
+bool ServerRun(const char *path, size_t workers, ServerSession session,
+               void *arg);
+
+/**
+ * Adds the time of a line to the latencies. They are reported while
+ * the session runs, at most once in LATENCY_REPORT_INTERVAL seconds.
+ * @param[in] latency : latencies of a session
+ * @param[in] start : time when the line was started
+ */
+void AddLatency(Latency *latency, const struct timespec *start);
+
+/**
+ * Executes a command of a session of the server. The files of its
+ * commands are given only by their names, which are looked up in
+ * the directory of --server-dir, so the clients can't use the other files.
+ * @param[in] calc : calculator of the session
+ * @param[in] id : id of the command
+ * @param[in] param : numeric parameter
+ * @param[in] text : parameter which is a text
+ * @param[in] lineCount : number of the line
+ * @return error of the command, ERROR_CONFINED if its file isn't allowed
+ */
+int ExecuteConfined(Calculator *calc, int id, long param, const char *text,
+                    int lineCount);
+
+/**
+ * Serves a connection of the server mode, as a ServerSession. The lines
+ * are executed like the lines of the standard input, with their own stack,
+ * and the error messages are sent to the client with the results.
+ * The files of the commands are confined to the directory of --server-dir.
+ * The latencies of the lines are reported on the standard error while
+ * the connection is open and when it is closed.
+ * @param[in] fd : socket of the connection
+ * @param[in] id : number of the connection
+ * @param[in] arg : calculator whose registers and options are used
+ */
+void ServeSession(int fd, unsigned long id, void *arg);
+
+#endif /* __SERVER_POLY_H__ */
@@ -8,51 +8,467 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
 #include "stack_poly.h"
+#include "serial_poly.h"
+
+/** Starting number of elements of the stack array */
+#define STACK_STARTING_SIZE 16
+/** Number by which the size of the stack array is multiplicated */
+#define STACK_SIZE_MULTIPLICATION 2
+
+/**
+ * Checks if the polynomials on the stack can hold @p bytes more bytes.
+ * @param s
+ * @param released : number of bytes released beforehand
+ * @param bytes
+ * @return
+ */
+static bool Fits(Stack *s, size_t released, size_t bytes) {
+    size_t held = s->bytes - released;
+    return held <= s->memLimit && bytes <= s->memLimit - held;
+}
+
+/**
+ * Makes room for one more element of the stack.
+ * @param s
+ * @return true if the memory couldn't be allocated, false otherwise
+ */
+static bool Grow(Stack *s) {
+    if (s->depth < s->size) {
+        return false;
+    }
+    size_t size = s->size == 0 ? STACK_STARTING_SIZE :
+                  s->size * STACK_SIZE_MULTIPLICATION;
+    StackEntry *arr = realloc(s->arr, size * sizeof(StackEntry));
+    if (arr == NULL) {
+        return true;
+    }
+    s->arr = arr;
+    s->size = size;
+    return false;
+}
+
+/**
+ * Moves the least recently used polynomial, which isn't among the hot ones
+ * nor the @p keep ones from the top, to the spill file.
+ * @param s
+ * @param keep
+ * @return true if nothing could be spilled, false otherwise
+ */
+static bool SpillOne(Stack *s, size_t keep) {
+    if (s->spill == NULL) {
+        return true;
+    }
+    if (keep < s->hotDepth) {
+        keep = s->hotDepth;
+    }
+    StackEntry *victim = NULL;
+    for (size_t i = 0; i + keep < s->depth; i++) {
+        StackEntry *e = &s->arr[i];
+        if (!e->spilled && e->node == NULL && e->bytes > 0 &&
+            e->lastUse < s->tick &&
+            (victim == NULL || e->lastUse < victim->lastUse)) {
+            victim = e;
+        }
+    }
+    if (victim == NULL || fseek(s->spill, s->spillEnd, SEEK_SET) != 0) {
+        return true;
+    }
+    if (PolyWrite(s->spill, &victim->p) || fflush(s->spill) != 0) {
+        return true;
+    }
+    victim->offset = s->spillEnd;
+    victim->spilled = true;
+    s->spillEnd = ftell(s->spill);
+    s->spilledCount++;
+    s->bytes -= victim->bytes;
+    PolyDestroy(&victim->p);
+    return false;
+}
+
+/**
+ * Spills cold polynomials until @p bytes more bytes fit in the memory limit.
+ * @param s
+ * @param keep : number of polynomials from the top which can't be spilled
+ * @param released : number of bytes released beforehand
+ * @param bytes
+ * @return true if the polynomials still don't fit, false otherwise
+ */
+static bool MakeRoom(Stack *s, size_t keep, size_t released, size_t bytes) {
+    while (!Fits(s, released, bytes)) {
+        if (SpillOne(s, keep)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Forgets about a spilled polynomial. Reuses the spill file when
+ * there are no spilled polynomials left.
+ * @param s
+ * @param e
+ */
+static void Unspill(Stack *s, StackEntry *e) {
+    e->spilled = false;
+    if (--s->spilledCount == 0) {
+        s->spillEnd = 0;
+    }
+}
+
+/**
+ * Loads a spilled polynomial back to memory. The polynomial stays spilled
+ * if it can't be read or doesn't fit in the memory limit.
+ * @param s
+ * @param e
+ * @return true if the polynomial couldn't be loaded, false otherwise
+ */
+static bool LoadSpilled(Stack *s, StackEntry *e) {
+    if (!e->spilled) {
+        return false;
+    }
+    Poly p;
+    if (MakeRoom(s, 0, 0, e->bytes) ||
+        fseek(s->spill, e->offset, SEEK_SET) != 0 || PolyRead(s->spill, &p)) {
+        return true;
+    }
+    e->p = p;
+    Unspill(s, e);
+    s->bytes += e->bytes;
+    return false;
+}
+
+/**
+ * Loads a spilled polynomial back to memory, evaluates an expression and
+ * marks the polynomial as used. The value of an expression is counted
+ * in the memory of the stack once it is evaluated, the same value shared by
+ * several polynomials is counted for each of them.
+ * @param s
+ * @param e
+ * @return true if the polynomial couldn't be loaded or the value was too
+ * large or doesn't fit in the memory limit, false otherwise
+ */
+static bool Use(Stack *s, StackEntry *e) {
+    e->lastUse = s->tick;
+    if (e->node == NULL) {
+        return LoadSpilled(s, e);
+    }
+    const Poly *v = NodeEval(e->node);
+    if (v == NULL) {
+        return true;
+    }
+    e->p = *v;
+    if (e->bytes == 0) {
+        size_t bytes = PolyMemSize(&e->p);
+        if (MakeRoom(s, 0, 0, bytes)) {
+            return true;
+        }
+        e->bytes = bytes;
+        s->bytes += bytes;
+    }
+    return false;
+}
+
+/**
+ * Forgets that the polynomials above the top of the stack were unchanged.
+ * @param s
+ */
+static void Shrunk(Stack *s) {
+    if (s->clean > s->depth) {
+        s->clean = s->depth;
+    }
+}
+
+/**
+ * Puts an element on the top of the stack which has room for it.
+ * @param s
+ * @param p
+ * @param bytes
+ */
+static void PushEntry(Stack *s, Poly p, size_t bytes) {
+    s->arr[s->depth++] = (StackEntry) {.p = p, .bytes = bytes,
+                                       .spilled = false, .offset = 0,
+                                       .lastUse = s->tick, .image = NULL,
+                                       .node = NULL};
+    s->bytes += bytes;
+    s->tick++;
+}
 
 bool Empty(Stack *s) {
-    return (s == NULL);
+    return s->depth == 0;
+}
+
+size_t Depth(Stack *s) {
+    return s->depth;
+}
+
+void Init(Stack *s, size_t memLimit) {
+    s->arr = NULL;
+    s->depth = s->size = s->bytes = 0;
+    s->memLimit = memLimit;
+    s->spill = NULL;
+    s->hotDepth = s->spilledCount = 0;
+    s->spillEnd = 0;
+    s->tick = 0;
+    s->clean = 0;
+}
+
+bool SetSpill(Stack *s, const char *path, size_t hotDepth) {
+    FILE *f = fopen(path, "w+b");
+    if (f == NULL) {
+        return true;
+    }
+    /* The file is needed only by this process. */
+    unlink(path);
+    if (s->spill != NULL) {
+        fclose(s->spill);
+    }
+    s->spill = f;
+    s->hotDepth = hotDepth;
+    return false;
 }
 
-void Init(Stack **s) {
-    *s = NULL;
+bool Push(Stack *s, Poly p) {
+    size_t bytes = PolyMemSize(&p);
+    if (MakeRoom(s, 0, 0, bytes) || Grow(s)) {
+        return true;
+    }
+    PushEntry(s, p, bytes);
+    return false;
 }
 
-void Push(Stack **s, Poly p) {
-    Stack *temp = malloc(sizeof(Stack));
-    assert(temp != NULL);
-    temp->next = *s;
-    temp->p = p;
-    *s = temp;
+bool PushImage(Stack *s, Poly p, Image *image) {
+    if (Grow(s)) {
+        return true;
+    }
+    PushEntry(s, p, 0);
+    s->arr[s->depth - 1].image = image;
+    ImageRetain(image);
+    return false;
 }
 
-Poly Pop(Stack **s) {
-    Stack *temp = *s;
-    Poly p = (*s)->p;
-    *s = (*s)->next;
-    free(temp);
-    return p;
+bool PushNode(Stack *s, Node *n) {
+    if (Grow(s)) {
+        return true;
+    }
+    PushEntry(s, PolyZero(), 0);
+    s->arr[s->depth - 1].node = n;
+    return false;
 }
 
-Poly Top(Stack *s) {
-    return s->p;
+bool Fetch(Stack *s, size_t n, bool evaluate) {
+    assert(n <= s->depth);
+    /* The polynomials which are used aren't spilled to make room for
+     * the others. */
+    for (size_t i = s->depth - n; i < s->depth; i++) {
+        s->arr[i].lastUse = s->tick;
+    }
+    for (size_t i = s->depth - n; i < s->depth; i++) {
+        StackEntry *e = &s->arr[i];
+        if (evaluate ? Use(s, e) : LoadSpilled(s, e)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-bool Full(Stack *s) { 
-    Stack *temp = malloc(sizeof(Stack));
-    
-    if (temp == NULL) {
-        return (true);
+bool TooLarge(Stack *s, size_t n) {
+    assert(n <= s->depth);
+    for (size_t i = s->depth - n; i < s->depth; i++) {
+        if (s->arr[i].node != NULL && NodeTooLarge(s->arr[i].node)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Node *PopNode(Stack *s) {
+    assert(!Empty(s));
+    StackEntry *e = &s->arr[s->depth - 1];
+    if (e->node != NULL || e->image != NULL) {
+        s->depth--;
+        s->bytes -= e->bytes;
+        Shrunk(s);
+        return e->node != NULL ? e->node : NodeFromImage(e->p, e->image);
+    }
+    Poly p;
+    if (Pop(s, &p)) {
+        return NULL;
+    }
+    return NodeFromPoly(p);
+}
+
+bool Pop(Stack *s, Poly *p) {
+    assert(!Empty(s));
+    StackEntry *e = &s->arr[s->depth - 1];
+    if (Use(s, e)) {
+        return true;
+    }
+    s->depth--;
+    s->bytes -= e->bytes;
+    Shrunk(s);
+    if (e->node != NULL) {
+        *p = NodeTake(e->node);
+    }
+    else if (e->image != NULL) {
+        *p = PolyClone(&e->p);
+        ImageRelease(e->image);
+    }
+    else {
+        *p = e->p;
+    }
+    return false;
+}
+
+void Drop(Stack *s) {
+    assert(!Empty(s));
+    StackEntry *e = &s->arr[--s->depth];
+    Shrunk(s);
+    if (e->spilled) {
+        Unspill(s, e);
+    }
+    else if (e->node != NULL) {
+        s->bytes -= e->bytes;
+        NodeRelease(e->node);
+    }
+    else if (e->image != NULL) {
+        ImageRelease(e->image);
+    }
+    else {
+        s->bytes -= e->bytes;
+        PolyDestroy(&e->p);
+    }
+}
+
+const Poly *Peek(Stack *s, size_t k) {
+    assert(k < s->depth);
+    StackEntry *e = &s->arr[s->depth - 1 - k];
+    return Use(s, e) ? NULL : &e->p;
+}
+
+Image *PeekImage(Stack *s, size_t k) {
+    assert(k < s->depth);
+    return s->arr[s->depth - 1 - k].image;
+}
+
+/**
+ * Forgets that the polynomials from a given one up were unchanged.
+ * @param s
+ * @param i : index of the changed polynomial counted from the bottom
+ */
+static void Changed(Stack *s, size_t i) {
+    if (s->clean > i) {
+        s->clean = i;
+    }
+}
+
+bool Take(Stack *s, size_t k, Poly *p) {
+    assert(k < s->depth);
+    StackEntry *e = &s->arr[s->depth - 1 - k];
+    if (Use(s, e)) {
+        return true;
+    }
+    Changed(s, s->depth - 1 - k);
+    s->bytes -= e->bytes;
+    if (e->node != NULL) {
+        *p = NodeTake(e->node);
+        e->node = NULL;
+    }
+    else if (e->image != NULL) {
+        *p = PolyClone(&e->p);
+        ImageRelease(e->image);
+        e->image = NULL;
     }
     else {
-        free(temp); 
-        return (false);
+        *p = e->p;
+    }
+    e->p = PolyZero();
+    e->bytes = 0;
+    return false;
+}
+
+void Put(Stack *s, size_t k, Poly p) {
+    assert(k < s->depth);
+    StackEntry *e = &s->arr[s->depth - 1 - k];
+    assert(e->node == NULL && e->image == NULL && PolyIsZero(&e->p));
+    e->p = p;
+    e->bytes = PolyMemSize(&p);
+    s->bytes += e->bytes;
+}
+
+bool Replace(Stack *s, size_t n, Poly p) {
+    assert(n <= s->depth);
+    size_t released = 0, bytes = PolyMemSize(&p);
+    for (size_t i = s->depth - n; i < s->depth; i++) {
+        if (!s->arr[i].spilled) {
+            released += s->arr[i].bytes;
+        }
+    }
+    if (MakeRoom(s, n, released, bytes) || n == 0 && Grow(s)) {
+        return true;
+    }
+    while (n > 0) {
+        Drop(s);
+        n--;
+    }
+    PushEntry(s, p, bytes);
+    return false;
+}
+
+size_t Clean(Stack *s) {
+    return s->clean;
+}
+
+void MarkClean(Stack *s) {
+    s->clean = s->depth;
+}
+
+bool WriteEntry(Stack *s, size_t i, FILE *f) {
+    assert(i < s->depth);
+    StackEntry *e = &s->arr[i];
+    if (e->node != NULL) {
+        const Poly *v = NodeEval(e->node);
+        return v == NULL || PolyWrite(f, v);
     }
+    if (!e->spilled) {
+        return PolyWrite(f, &e->p);
+    }
+    Poly p;
+    if (fseek(s->spill, e->offset, SEEK_SET) != 0 || PolyRead(s->spill, &p)) {
+        return true;
+    }
+    bool error = PolyWrite(f, &p);
+    PolyDestroy(&p);
+    return error;
+}
+
+void Move(Stack *s, Stack *from) {
+    assert(Empty(s) && from->spilledCount == 0);
+    StackEntry *arr = s->arr;
+    size_t size = s->size;
+    s->arr = from->arr;
+    s->size = from->size;
+    s->depth = from->depth;
+    s->bytes = from->bytes;
+    s->clean = 0;
+    from->arr = arr;
+    from->size = size;
+    from->depth = from->bytes = from->clean = 0;
+    for (size_t i = 0; i < s->depth; i++) {
+        s->arr[i].lastUse = s->tick;
+    }
+    s->tick++;
+    MakeRoom(s, 0, 0, 0);
 }
 
-void Clear(Stack **s) {
-    while (!Empty(*s)) {
-        Poly p = Pop(s);
-        PolyDestroy(&p);
+void Clear(Stack *s) {
+    while (!Empty(s)) {
+        Drop(s);
+    }
+    free(s->arr);
+    if (s->spill != NULL) {
+        fclose(s->spill);
     }
+    Init(s, s->memLimit);
 }
@@ -9,28 +9,241 @@
 #ifndef __STACK_POLY_H__
 #define __STACK_POLY_H__
 
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "poly.h"
+#include "image_poly.h"
+#include "lazy_poly.h"
+
+/** value of the memory limit if the stack isn't limited */
+#define NO_MEMORY_LIMIT SIZE_MAX
+
+/**
+ * Structure containing an element of the stack of polynomials
+ */
+typedef struct stack_entry {
+    Poly p; ///< polynomial, valid only if it isn't spilled
+    size_t bytes; ///< number of bytes held by the polynomial
+    bool spilled; ///< whether the polynomial was moved to the spill file
+    long offset; ///< position of the spilled polynomial in the spill file
+    unsigned long lastUse; ///< number of the last operation which used it
+    Image *image; ///< image holding the polynomial or NULL if it is owned
+    Node *node; ///< expression giving the polynomial or NULL, the polynomial
+                ///< is its value and is valid only once it is evaluated
+} StackEntry;
 
 /**
  * Structure containing the stack of polynomials
  */
 typedef struct stack {
-    Poly p; ///< polynomial
-    struct stack *next; ///< next stack element
+    StackEntry *arr; ///< elements of the stack, the top is the last one
+    size_t depth; ///< number of polynomials on the stack
+    size_t size; ///< number of allocated elements
+    size_t bytes; ///< number of bytes held by the polynomials in memory
+    size_t memLimit; ///< maximal number of bytes held by the polynomials
+    FILE *spill; ///< file for the cold polynomials or NULL
+    size_t hotDepth; ///< number of polynomials from the top never spilled
+    size_t spilledCount; ///< number of spilled polynomials
+    long spillEnd; ///< end of the used part of the spill file
+    unsigned long tick; ///< number of the current operation
+    size_t clean; ///< number of polynomials from the bottom not changed
+                  ///< since the last call to MarkClean
 } Stack;
 
-void Init(Stack **s);
+/**
+ * Initializes an empty stack.
+ * @param[in] s : stack
+ * @param[in] memLimit : maximal number of bytes held by the polynomials
+ */
+void Init(Stack *s, size_t memLimit);
+
+/**
+ * Lets the stack move cold polynomials to a file when the memory limit
+ * is reached. The polynomials are loaded back when they are used.
+ * @param[in] s : stack
+ * @param[in] path : path of the spill file
+ * @param[in] hotDepth : number of polynomials from the top never spilled
+ * @return true if the file couldn't be created, false otherwise
+ */
+bool SetSpill(Stack *s, const char *path, size_t hotDepth);
+
+/**
+ * Puts a polynomial on the top of the stack.
+ * Takes ownership of the polynomial @p p only if it was put on the stack.
+ * @param[in] s : stack
+ * @param[in] p : polynomial
+ * @return true if the memory limit would be exceeded, false otherwise
+ */
+bool Push(Stack *s, Poly p);
+
+/**
+ * Puts a polynomial held by an image on the top of the stack.
+ * The polynomial takes no memory of the stack and is never spilled.
+ * Adds a reference to the image only if the polynomial was put on the stack.
+ * @param[in] s : stack
+ * @param[in] p : polynomial held by the image
+ * @param[in] image : image
+ * @return true if the memory couldn't be allocated, false otherwise
+ */
+bool PushImage(Stack *s, Poly p, Image *image);
+
+/**
+ * Puts an expression on the top of the stack. It is evaluated when
+ * the polynomial is used. Its value takes the memory of the stack from
+ * then on and is never spilled. Takes the reference to the node only if
+ * it was put on the stack.
+ * @param[in] s : stack
+ * @param[in] n : node
+ * @return true if the memory couldn't be allocated, false otherwise
+ */
+bool PushNode(Stack *s, Node *n);
+
+/**
+ * Loads the spilled polynomials among the @p n ones from the top of
+ * the stack back to memory, so that they can be used without errors.
+ * @param[in] s : stack with at least @p n polynomials
+ * @param[in] n : number of polynomials
+ * @param[in] evaluate : whether their expressions are evaluated too
+ * @return true if a polynomial couldn't be read or it or the value of
+ *         an expression doesn't fit in the memory limit or was too large,
+ *         false otherwise
+ */
+bool Fetch(Stack *s, size_t n, bool evaluate);
+
+/**
+ * Checks if the value of an expression among the @p n polynomials from
+ * the top of the stack was evaluated and too large, which makes Fetch
+ * fail on them.
+ * @param[in] s : stack with at least @p n polynomials
+ * @param[in] n : number of polynomials
+ * @return whether a value was too large
+ */
+bool TooLarge(Stack *s, size_t n);
 
-void Push(Stack **s, Poly p);
+/**
+ * Takes the polynomial from the top of the non empty stack as
+ * an expression, without evaluating it.
+ * @param[in] s : stack
+ * @return node with the reference of the stack, NULL if the polynomial
+ *         couldn't be loaded
+ */
+Node *PopNode(Stack *s);
 
-Poly Pop(Stack **s);
+/**
+ * Takes the polynomial from the top of the non empty stack.
+ * A polynomial held by an image is copied.
+ * @param[in] s : stack
+ * @param[out] p : polynomial
+ * @return true if the polynomial couldn't be loaded, false otherwise
+ */
+bool Pop(Stack *s, Poly *p);
 
-Poly Top(Stack *s);
+/**
+ * Deletes the polynomial from the top of the non empty stack.
+ * @param[in] s : stack
+ */
+void Drop(Stack *s);
 
+/**
+ * Returns a polynomial lying under @p k other polynomials on the stack.
+ * @param[in] s : stack with more than @p k polynomials
+ * @param[in] k : index of the polynomial counted from the top
+ * @return polynomial, NULL if it couldn't be loaded
+ */
+const Poly *Peek(Stack *s, size_t k);
+
+/**
+ * Returns the image which holds a polynomial on the stack.
+ * @param[in] s : stack with more than @p k polynomials
+ * @param[in] k : index of the polynomial counted from the top
+ * @return image or NULL if the polynomial is owned by the stack
+ */
+Image *PeekImage(Stack *s, size_t k);
+
+/**
+ * Takes a polynomial lying under @p k other polynomials on the stack and
+ * leaves zero in its place, so that it can be changed and put back.
+ * A polynomial held by an image is copied.
+ * @param[in] s : stack with more than @p k polynomials
+ * @param[in] k : index of the polynomial counted from the top
+ * @param[out] p : polynomial
+ * @return true if the polynomial couldn't be loaded, false otherwise
+ */
+bool Take(Stack *s, size_t k, Poly *p);
+
+/**
+ * Puts a polynomial in the place emptied by Take. The memory limit isn't
+ * checked. Takes ownership of the polynomial @p p.
+ * @param[in] s : stack with more than @p k polynomials
+ * @param[in] k : index of the polynomial counted from the top
+ * @param[in] p : polynomial
+ */
+void Put(Stack *s, size_t k, Poly p);
+
+/**
+ * Replaces @p n polynomials from the top of the stack with @p p.
+ * Deletes the replaced polynomials. Takes ownership of the polynomial @p p
+ * only if the stack was changed.
+ * @param[in] s : stack with at least @p n polynomials
+ * @param[in] n : number of replaced polynomials
+ * @param[in] p : polynomial
+ * @return true if the memory limit would be exceeded, false otherwise
+ */
+bool Replace(Stack *s, size_t n, Poly p);
+
+/**
+ * Checks if the stack is empty.
+ * @param[in] s : stack
+ * @return
+ */
 bool Empty(Stack *s);
 
-bool Full(Stack *s);
+/**
+ * Returns the number of polynomials on the stack.
+ * @param[in] s : stack
+ * @return depth of the stack
+ */
+size_t Depth(Stack *s);
+
+/**
+ * Returns the number of polynomials from the bottom of the stack which
+ * weren't popped, dropped nor replaced since the last call to MarkClean.
+ * @param[in] s : stack
+ * @return number of unchanged polynomials
+ */
+size_t Clean(Stack *s);
 
-void Clear(Stack **s);
+/**
+ * Marks all polynomials on the stack as unchanged.
+ * @param[in] s : stack
+ */
+void MarkClean(Stack *s);
+
+/**
+ * Writes a polynomial to a binary stream using PolyWrite.
+ * A spilled polynomial is copied from the spill file and stays spilled.
+ * @param[in] s : stack with more than @p i polynomials
+ * @param[in] i : index of the polynomial counted from the bottom
+ * @param[in] f : stream
+ * @return true if the writing failed, false otherwise
+ */
+bool WriteEntry(Stack *s, size_t i, FILE *f);
+
+/**
+ * Moves all polynomials of the stack @p from, which has no spilled ones,
+ * to the empty stack @p s. The stack @p from becomes empty.
+ * The polynomials which don't fit in the memory limit of @p s are spilled
+ * if it is possible.
+ * @param[in] s : empty stack
+ * @param[in] from : stack
+ */
+void Move(Stack *s, Stack *from);
+
+/**
+ * Deletes all polynomials on the stack and frees its memory.
+ * @param[in] s : stack
+ */
+void Clear(Stack *s);
 
 #endif /* __STACK_POLY_H__ */
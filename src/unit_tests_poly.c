@@ -11,12 +11,16 @@
 #include <string.h>
 #include <setjmp.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include "cmocka.h"
 #include "poly.h"
+#include "pack_poly.h"
+#include "fork_poly.h"
 
 #define BUFFER_SIZE 256 ///< size of buffers
 
-extern int calculator_main(); ///< macro for the main function in calc_poly.c
+/// macro for the main function in calc_poly.c
+extern int calculator_main(int argc, char *argv[]);
 
 static char fprintf_buffer[BUFFER_SIZE]; ///< stderr buffer
 static char printf_buffer[BUFFER_SIZE]; ///< stdout buffer
@@ -256,7 +260,7 @@ static void test_poly_x_count_one_x(void **state) {
 static void test_parse_no_parameter(void **state) {
     (void) state;
     init_input_stream("COMPOSE ");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
     assert_string_equal(printf_buffer, "");
@@ -269,7 +273,7 @@ static void test_parse_no_parameter(void **state) {
 static void test_parse_zero(void **state) {
     (void) state;
     init_input_stream("COMPOSE 0");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 STACK UNDERFLOW\n");
     assert_string_equal(printf_buffer, "");
@@ -282,7 +286,7 @@ static void test_parse_zero(void **state) {
 static void test_parse_max(void **state) {
     (void) state;
     init_input_stream("COMPOSE 4294967295");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 STACK UNDERFLOW\n");
     assert_string_equal(printf_buffer, "");
@@ -295,7 +299,7 @@ static void test_parse_max(void **state) {
 static void test_parse_min_minus_one(void **state) {
     (void) state;
     init_input_stream("COMPOSE -1");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
     assert_string_equal(printf_buffer, "");
@@ -308,7 +312,7 @@ static void test_parse_min_minus_one(void **state) {
 static void test_parse_max_plus_one(void **state) {
     (void) state;
     init_input_stream("COMPOSE 4294967296");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");   
     assert_string_equal(printf_buffer, "");
@@ -321,12 +325,29 @@ static void test_parse_max_plus_one(void **state) {
 static void test_parse_much_more_than_max(void **state) {
     (void) state;
     init_input_stream("COMPOSE 424242424242424242424242424242");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
     assert_string_equal(printf_buffer, "");
 }
 
+/**
+ * Tests the parser with coefficients which are too big. The error is
+ * reported at the digit which makes them too big.
+ * @param state
+ */
+static void test_parse_coeff_overflow(void **state) {
+    (void) state;
+    init_input_stream("92233720368547758080\n(92233720368547758080,1)\n"
+                      "-92233720368547758090\n9223372036854775807\n"
+                      "-9223372036854775808\nADD\nPRINT\n");
+    calculator_main(0, NULL);
+
+    assert_string_equal(fprintf_buffer, "ERROR 1 19\nERROR 2 20\n"
+                                        "ERROR 3 20\n");
+    assert_string_equal(printf_buffer, "-1\n");
+}
+
 /**
  * Tests PolyCompose parser with a parameter which consists of letters.
  * @param state
@@ -334,7 +355,7 @@ static void test_parse_much_more_than_max(void **state) {
 static void test_parse_letters(void **state) {
     (void) state;
     init_input_stream("COMPOSE aAbBcCdDeE");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n"); 
     assert_string_equal(printf_buffer, "");
@@ -347,12 +368,624 @@ static void test_parse_letters(void **state) {
 static void test_parse_digits_and_letters(void **state) {
     (void) state;
     init_input_stream("COMPOSE 123aAaA123C");
-    calculator_main();
+    calculator_main(0, NULL);
     
     assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
     assert_string_equal(printf_buffer, "");
 }
 
+/**
+ * Tests the DEPTH command.
+ * @param state
+ */
+static void test_stack_depth(void **state) {
+    (void) state;
+    init_input_stream("DEPTH\n(1,2)\n3\nDEPTH\nADD\nDEPTH");
+    calculator_main(0, NULL);
+    
+    assert_string_equal(fprintf_buffer, "");
+    assert_string_equal(printf_buffer, "0\n2\n1\n");
+}
+
+/**
+ * Tests the stack with a memory limit which fits only one monomial.
+ * @param state
+ */
+static void test_stack_memory_limit(void **state) {
+    (void) state;
+    char limit[BUFFER_SIZE];
+    char *argv[] = { "calc_poly", "--mem-limit", limit, NULL };
+    snprintf(limit, sizeof(limit), "%zu", sizeof(Mono));
+    init_input_stream("(1,1)\n(1,2)\nCLONE\nZERO\nDEPTH");
+    calculator_main(3, argv);
+    
+    assert_string_equal(fprintf_buffer,
+                        "ERROR 2 OUT OF MEMORY\nERROR 3 OUT OF MEMORY\n");
+    assert_string_equal(printf_buffer, "2\n");
+}
+
+/**
+ * Tests that a spilled polynomial is loaded back only if it fits in
+ * the memory limit.
+ * @param state
+ */
+static void test_stack_spill_limit(void **state) {
+    (void) state;
+    char limit[BUFFER_SIZE];
+    char *argv[] = { "calc_poly", "--mem-limit", limit,
+                     "--spill-file", "unit_tests_poly.spill", NULL };
+    snprintf(limit, sizeof(limit), "%zu", sizeof(Mono));
+    init_input_stream("(1,1)\n(1,2)\nIS_EQ\nDEPTH\nPRINT\nPOP\nPRINT\n");
+    calculator_main(5, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 3 OUT OF MEMORY\n");
+    assert_string_equal(printf_buffer, "2\n(1,2)\n(1,1)\n");
+}
+
+/**
+ * Tests the SAVE and LOAD commands and sharing of a loaded polynomial.
+ * @param state
+ */
+static void test_stack_save_load(void **state) {
+    (void) state;
+    init_input_stream("((1,2)+(3,4),5)+(-1,7)\nSAVE unit_tests_poly.img\n"
+                      "LOAD unit_tests_poly.img\nIS_EQ\nCLONE\nADD\nPRINT\n"
+                      "LOAD\nLOAD unit_tests_poly.none");
+    calculator_main(0, NULL);
+    remove("unit_tests_poly.img");
+
+    assert_string_equal(fprintf_buffer,
+                        "ERROR 8 WRONG FILE\nERROR 9 CANNOT LOAD\n");
+    assert_string_equal(printf_buffer, "1\n((2,2)+(6,4),5)+(-2,7)\n");
+}
+
+/**
+ * Changes the pointer to the next monomial of the last monomial of
+ * an image of a polynomial with two monomials.
+ * @param path : path of the image
+ * @param back : whether it points to the first monomial, otherwise it
+ *               points inside a monomial
+ */
+static void corrupt_image(const char *path, bool back) {
+    FILE *f = fopen(path, "r+b");
+    assert_non_null(f);
+    assert_int_equal(fseek(f, 0, SEEK_END), 0);
+    long table = ftell(f) - 2 * (long) sizeof(Mono);
+    Mono monos[2];
+    assert_int_equal(fseek(f, table, SEEK_SET), 0);
+    assert_int_equal(fread(monos, sizeof(Mono), 2, f), 2);
+    monos[1].next = back ? (Mono *) ((char *) monos[0].next - sizeof(Mono)) :
+                           (Mono *) ((char *) monos[0].next + 1);
+    assert_int_equal(fseek(f, table, SEEK_SET), 0);
+    assert_int_equal(fwrite(monos, sizeof(Mono), 2, f), 2);
+    assert_int_equal(fclose(f), 0);
+}
+
+/**
+ * Tests that the pointers of an image are checked when it is loaded,
+ * also at its preferred address.
+ * @param state
+ */
+static void test_stack_load_corrupt(void **state) {
+    (void) state;
+    init_input_stream("(1,1)+(1,2)\nSAVE unit_tests_poly.img\n");
+    calculator_main(0, NULL);
+    corrupt_image("unit_tests_poly.img", true);
+    init_input_stream("LOAD unit_tests_poly.img\nDEG\n");
+    calculator_main(0, NULL);
+    corrupt_image("unit_tests_poly.img", false);
+    init_input_stream("LOAD unit_tests_poly.img\nPRINT\n");
+    calculator_main(0, NULL);
+    remove("unit_tests_poly.img");
+
+    assert_string_equal(fprintf_buffer,
+                        "ERROR 1 CANNOT LOAD\nERROR 2 STACK UNDERFLOW\n"
+                        "ERROR 1 CANNOT LOAD\nERROR 2 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer, "");
+}
+
+/**
+ * Tests the SAVE and LOAD commands with the packed files.
+ * @param state
+ */
+static void test_stack_save_load_packed(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--storage-format", "packed", NULL};
+    init_input_stream("((1,2)+(-3,2147483647),0)+(-9223372036854775808,7)\n"
+                      "SAVE unit_tests_poly.pak\nLOAD unit_tests_poly.pak\n"
+                      "IS_EQ\nLOAD unit_tests_poly.pak\nPRINT\n");
+    calculator_main(3, argv);
+    remove("unit_tests_poly.pak");
+
+    assert_string_equal(fprintf_buffer, "");
+    assert_string_equal(printf_buffer, "1\n((1,2)+(-3,2147483647),0)+"
+                                       "(-9223372036854775808,7)\n");
+}
+
+/**
+ * Tests the SAVE and LOAD commands with the compressed packed files.
+ * @param state
+ */
+static void test_stack_save_load_packed_zlib(void **state) {
+    (void) state;
+    if (!PackCanCompress()) {
+        skip();
+    }
+    char *argv[] = {"calc_poly", "--storage-format", "packed-zlib", NULL};
+    init_input_stream("((1,0)+(1,1),0)+((1,0),1)\nCLONE\nMUL\nCLONE\nMUL\n"
+                      "CLONE\nMUL\nCLONE\nMUL\nCLONE\nMUL\n"
+                      "SAVE unit_tests_poly.pkz\nLOAD unit_tests_poly.pkz\n"
+                      "IS_EQ\nDEG\n");
+    calculator_main(3, argv);
+    assert_true(PackIsPacked("unit_tests_poly.pkz"));
+    remove("unit_tests_poly.pkz");
+
+    assert_string_equal(fprintf_buffer, "");
+    assert_string_equal(printf_buffer, "1\n32\n");
+}
+
+/**
+ * Replaces the constant at the end of a packed file with the product
+ * of the next variables, each nested in the previous one.
+ * @param path : path of the packed file
+ * @param levels : number of the variables
+ */
+static void nest_packed(const char *path, int levels) {
+    FILE *f = fopen(path, "r+b");
+    assert_non_null(f);
+    /* The constant 1 is encoded as no monomials and its zigzag value. */
+    assert_int_equal(fseek(f, -2, SEEK_END), 0);
+    for (int i = 0; i < levels; i++) {
+        assert_int_equal(fputc(1, f), 1);
+        assert_int_equal(fputc(1, f), 1);
+    }
+    assert_int_equal(fputc(0, f), 0);
+    assert_int_equal(fputc(2, f), 2);
+    assert_int_equal(fclose(f), 0);
+}
+
+/**
+ * Tests that a packed file with too deep polynomials is rejected.
+ * @param state
+ */
+static void test_stack_load_packed_deep(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--storage-format", "packed", NULL};
+    init_input_stream("1\nSAVE unit_tests_poly.pak\n");
+    calculator_main(3, argv);
+    nest_packed("unit_tests_poly.pak", 100);
+    init_input_stream("LOAD unit_tests_poly.pak\nDEG\n");
+    calculator_main(0, NULL);
+    nest_packed("unit_tests_poly.pak", 100000);
+    init_input_stream("LOAD unit_tests_poly.pak\nDEPTH\n");
+    calculator_main(0, NULL);
+    remove("unit_tests_poly.pak");
+
+    assert_string_equal(fprintf_buffer, "ERROR 1 WRONG FILE\n");
+    assert_string_equal(printf_buffer, "100\n0\n");
+}
+
+/**
+ * Tests the CHECKPOINT command and restoring the stack from its file.
+ * @param state
+ */
+static void test_stack_checkpoint_restore(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--restore", "unit_tests_poly.ckp", NULL};
+    init_input_stream("(1,2)\n3\nCHECKPOINT unit_tests_poly.ckp\nNEG\n4\n"
+                      "CHECKPOINT unit_tests_poly.ckp\nCHECKPOINT");
+    calculator_main(1, argv);
+    init_input_stream("DEPTH\nPRINT\nPOP\nPRINT\n");
+    calculator_main(3, argv);
+    remove("unit_tests_poly.ckp");
+
+    assert_string_equal(fprintf_buffer, "ERROR 7 WRONG FILE\n");
+    assert_string_equal(printf_buffer, "3\n4\n-3\n");
+}
+
+/**
+ * Tests the STORE, RECALL and DROP commands.
+ * @param state
+ */
+static void test_stack_registers(void **state) {
+    (void) state;
+    init_input_stream("(1,2)+(3,4)\nSTORE b\nDEPTH\nRECALL b\nRECALL b\n"
+                      "ADD\nPRINT\n5\nSTORE b\nRECALL b\nPRINT\nDROP b\n"
+                      "RECALL b\nSTORE\n");
+    calculator_main(0, NULL);
+
+    assert_string_equal(fprintf_buffer, "ERROR 13 UNKNOWN REGISTER\n"
+                                        "ERROR 14 WRONG NAME\n");
+    assert_string_equal(printf_buffer, "0\n(2,2)+(6,4)\n5\n");
+}
+
+/**
+ * Writes a file for the tests.
+ * @param path
+ * @param text
+ */
+static void write_test_file(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    assert_non_null(f);
+    fputs(text, f);
+    fclose(f);
+}
+
+/**
+ * Tests the chain mode, in which the results printed by a file are
+ * the stack of the next one.
+ * @param state
+ */
+static void test_chain(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--chain", "unit_tests_poly.chain", NULL};
+    mkdir("unit_tests_poly.chain", 0700);
+    write_test_file("unit_tests_poly.chain/a",
+                    "START\n(1,2)\nPRINT\n3\nPRINT\nFILE b\n");
+    write_test_file("unit_tests_poly.chain/b", "ADD\nPRINT\nWRONG\nSTOP\n");
+    calculator_main(3, argv);
+    remove("unit_tests_poly.chain/a");
+    remove("unit_tests_poly.chain/b");
+    remove("unit_tests_poly.chain");
+
+    assert_string_equal(fprintf_buffer, "ERROR 5 WRONG COMMAND\n");
+    assert_string_equal(printf_buffer, "(3,0)+(1,2)\n");
+}
+
+/**
+ * Tests a program compiled once and run on different stacks. The stack
+ * which is too shallow is reported before anything is run.
+ * @param state
+ */
+static void test_program(void **state) {
+    (void) state;
+    char *compile[] = {"calc_poly", "--compile", "unit_tests_poly.prg", NULL};
+    char *exec[] = {"calc_poly", "--exec", "unit_tests_poly.prg", NULL};
+    init_input_stream("ADD\nPRINT\n(1,1)\nMUL\nPRINT\n");
+    calculator_main(3, compile);
+    init_input_stream("(1,2)\n3\n");
+    calculator_main(3, exec);
+    init_input_stream("1\n");
+    calculator_main(3, exec);
+    remove("unit_tests_poly.prg");
+
+    assert_string_equal(fprintf_buffer, "ERROR 1 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer, "(3,0)+(1,2)\n(3,1)+(1,3)\n");
+}
+
+/**
+ * Tests the lazy evaluation: a sum of products, a dropped polynomial
+ * and a product with zero give the same results as the eager one.
+ * @param state
+ */
+static void test_lazy(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--lazy", NULL};
+    init_input_stream("(1,1)\nCLONE\n(1,2)\nMUL\nADD\nPRINT\n"
+                      "(1,5)\nPOP\n(2,1)\n0\nMUL\nIS_ZERO\n");
+    calculator_main(2, argv);
+
+    assert_string_equal(fprintf_buffer, "");
+    assert_string_equal(printf_buffer, "(1,1)+(1,3)\n1\n");
+}
+
+/**
+ * Tests that the values of the lazy commands are counted in the memory
+ * limit when they are evaluated, but not the dropped ones.
+ * @param state
+ */
+static void test_lazy_mem_limit(void **state) {
+    (void) state;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%zu", 8 * sizeof(Mono));
+    char *argv[] = {"calc_poly", "--lazy", "--mem-limit", buf, NULL};
+    init_input_stream("(1,0)+(1,1)\nCLONE\nMUL\nCLONE\nMUL\nDEG\n"
+                      "CLONE\nMUL\nDEG\nPOP\n(1,0)+(1,1)\nCLONE\nMUL\n"
+                      "CLONE\nMUL\nCLONE\nMUL\nPOP\nDEPTH\n");
+    calculator_main(4, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 9 OUT OF MEMORY\n");
+    assert_string_equal(printf_buffer, "4\n0\n");
+}
+
+/**
+ * Tests the MUL_ADD command, which changes the third polynomial in place,
+ * in the eager and the lazy modes.
+ * @param state
+ */
+static void test_mul_add(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--lazy", NULL};
+    const char *input = "(1,1)+(-1,0)\n(1,1)\n(1,1)+(1,0)\nMUL_ADD\n"
+                        "PRINT\n1\nMUL_ADD\n";
+    init_input_stream(input);
+    calculator_main(1, argv);
+    init_input_stream(input);
+    calculator_main(2, argv);
+
+    assert_string_equal(fprintf_buffer,
+                        "ERROR 7 STACK UNDERFLOW\nERROR 7 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer,
+                        "(-1,0)+(2,1)+(1,2)\n(-1,0)+(2,1)+(1,2)\n");
+}
+
+/**
+ * Tests the pipelined mode, forced also on a single processor, in which
+ * the errors of parsing and of the commands keep their order among
+ * the results.
+ * @param state
+ */
+static void test_pipeline(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--force-pipeline", NULL};
+    init_input_stream("(1,1)\nPRINT\n(1,\nWRONG\nPOP\nPOP\nDEG\n3\n"
+                      "IS_COEFF\n");
+    calculator_main(2, argv);
+
+    assert_string_equal(fprintf_buffer,
+                        "ERROR 3 4\nERROR 4 WRONG COMMAND\n"
+                        "ERROR 6 STACK UNDERFLOW\nERROR 7 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer, "(1,1)\n1\n");
+}
+
+/**
+ * Tests evaluating the independent commands in parallel.
+ * @param state
+ */
+static void test_parallel(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--parallel", "2", NULL};
+    init_input_stream("(1,0)+(1,1)\nCLONE\nMUL\n(1,2)\nCLONE\nMUL\nADD\n"
+                      "PRINT\nAT 2\nPRINT\nSUB\nDEG\n");
+    calculator_main(3, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 11 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer,
+                        "(1,0)+(2,1)+(1,2)+(1,4)\n25\n0\n");
+}
+
+/**
+ * Tests the ADD_N command, whose monomials cancel out partly, in the eager
+ * and the lazy modes.
+ * @param state
+ */
+static void test_add_n(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--lazy", NULL};
+    const char *input = "(1,1)\n(2,0)+(1,1)\n((1,1),2)\n((-1,1),2)+(1,3)\n3\n"
+                        "ADD_N 5\nPRINT\nADD_N 0\nPRINT\nADD_N 3\n";
+    init_input_stream(input);
+    calculator_main(1, argv);
+    init_input_stream(input);
+    calculator_main(2, argv);
+
+    assert_string_equal(fprintf_buffer,
+                        "ERROR 10 STACK UNDERFLOW\n"
+                        "ERROR 10 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer,
+                        "(5,0)+(2,1)+(1,3)\n0\n(5,0)+(2,1)+(1,3)\n0\n");
+}
+
+/**
+ * Tests the MUL_N command in the eager and the lazy modes.
+ * @param state
+ */
+static void test_mul_n(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--lazy", NULL};
+    const char *input = "(1,1)+(1,0)\n(1,1)+(-1,0)\n2\n((1,1),2)+(1,0)\n"
+                        "MUL_N 4\nPRINT\nMUL_N 0\nPRINT\nMUL_N 3\n";
+    init_input_stream(input);
+    calculator_main(1, argv);
+    init_input_stream(input);
+    calculator_main(2, argv);
+
+    assert_string_equal(fprintf_buffer,
+                        "ERROR 9 STACK UNDERFLOW\n"
+                        "ERROR 9 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer,
+                        "(-2,0)+((2,0)+(-2,1),2)+((2,1),4)\n1\n"
+                        "(-2,0)+((2,0)+(-2,1),2)+((2,1),4)\n1\n");
+}
+
+/**
+ * Tests the MUL_PRINT and MUL_SAVE commands, which don't build
+ * the product.
+ * @param state
+ */
+static void test_mul_print_save(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", NULL};
+    init_input_stream("(1,1)+(1,0)\n(1,1)+(-1,0)\nMUL_PRINT\n2\n3\n"
+                      "MUL_PRINT\n((1,1),0)+(1,1)\n((1,1),0)+(-1,1)\n"
+                      "MUL_SAVE unit_tests_poly.pak\nLOAD unit_tests_poly.pak\n"
+                      "PRINT\n0\nMUL_PRINT\nMUL_PRINT\n");
+    calculator_main(1, argv);
+    remove("unit_tests_poly.pak");
+
+    assert_string_equal(fprintf_buffer, "ERROR 14 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer, "(-1,0)+(1,2)\n6\n"
+                                       "((1,2),0)+(-1,2)\n0\n");
+}
+
+/**
+ * Tests the limit of the size of the result of a command, which is
+ * checked before the result is computed.
+ * @param state
+ */
+static void test_op_limit(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", "--op-limit", "200", NULL};
+    init_input_stream("(1,1)+(1,0)\n(1,1)+(-1,0)\nMUL\nPRINT\n"
+                      "(1,1)+(1,2)+(1,3)+(1,4)\nCLONE\nMUL\nDEPTH\n"
+                      "CLONE\nCOMPOSE 1\nMUL_N 2\nMUL_N 1\nPRINT\n");
+    calculator_main(3, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 7 RESULT TOO LARGE\n"
+                                        "ERROR 10 RESULT TOO LARGE\n"
+                                        "ERROR 11 RESULT TOO LARGE\n");
+    assert_string_equal(printf_buffer, "(-1,0)+(1,2)\n3\n"
+                                       "(1,1)+(1,2)+(1,3)+(1,4)\n");
+}
+
+/**
+ * Tests the limit of the size of the result in the lazy modes, where it is
+ * checked when a value is evaluated and fails the commands using it.
+ * @param state
+ */
+static void test_lazy_op_limit(void **state) {
+    (void) state;
+    char *lazy[] = {"calc_poly", "--lazy", "--op-limit", "200", NULL};
+    char *parallel[] = {"calc_poly", "--parallel", "2", "--op-limit", "200",
+                        NULL};
+    const char *input = "(1,1)+(1,0)\n(1,1)+(-1,0)\nMUL\nPRINT\n"
+                        "(1,1)+(1,2)+(1,3)+(1,4)\nCLONE\nMUL\nDEPTH\n"
+                        "CLONE\nADD\nDEG\nPRINT\nPOP\nPRINT\n";
+    init_input_stream(input);
+    calculator_main(4, lazy);
+    init_input_stream(input);
+    calculator_main(5, parallel);
+
+    assert_string_equal(fprintf_buffer, "ERROR 11 RESULT TOO LARGE\n"
+                                        "ERROR 12 RESULT TOO LARGE\n"
+                                        "ERROR 11 RESULT TOO LARGE\n"
+                                        "ERROR 12 RESULT TOO LARGE\n");
+    assert_string_equal(printf_buffer, "(-1,0)+(1,2)\n2\n(-1,0)+(1,2)\n"
+                                       "(-1,0)+(1,2)\n2\n(-1,0)+(1,2)\n");
+}
+
+/**
+ * Tests the DIV, REM and IS_DIVISIBLE commands.
+ * @param state
+ */
+static void test_div(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", NULL};
+    init_input_stream("(1,1)+(-1,0)\n(1,2)+(-1,0)\nIS_DIVISIBLE\nDIV\nPRINT\n"
+                      "(1,2)+(1,0)\nIS_DIVISIBLE\nREM\nPRINT\n0\n5\nDIV\n"
+                      "3\n-7\nREM\nPRINT\n((1,1),1)\n"
+                      "((1,1),2)+((1,2),1)\nDIV\nPRINT\n");
+    calculator_main(1, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 12 DIVISION BY ZERO\n");
+    assert_string_equal(printf_buffer, "1\n(1,0)+(1,1)\n0\n2\n-1\n"
+                                       "((1,1),0)+(1,1)\n");
+}
+
+/**
+ * Tests the GCD command.
+ * @param state
+ */
+static void test_gcd(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", NULL};
+    init_input_stream("GCD\n(1,2)+(-1,0)\n(1,2)+(2,1)+(1,0)\nGCD\nPRINT\n"
+                      "((-2,1),1)+((2,1),0)\n((6,1),2)+((-6,1),0)\nGCD\n"
+                      "PRINT\n6\n-4\nGCD\nPRINT\n0\n0\nGCD\nPRINT\n");
+    calculator_main(1, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 1 STACK UNDERFLOW\n");
+    assert_string_equal(printf_buffer, "(1,0)+(1,1)\n((-2,1),0)+((2,1),1)\n"
+                                       "2\n0\n");
+}
+
+/**
+ * Tests the GCD command on polynomials of high degrees, which fails
+ * unless they are small enough to be kept as dense arrays.
+ * @param state
+ */
+static void test_gcd_sparse(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", NULL};
+    init_input_stream("(1,2000000000)+(1,0)\n(1,1000000000)+(1,0)\nGCD\n"
+                      "DEPTH\n(1,1000)+(-1,0)\n(1,600)+(-1,0)\nGCD\nPRINT\n");
+    calculator_main(1, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 3 RESULT TOO LARGE\n");
+    assert_string_equal(printf_buffer, "2\n(-1,0)+(1,200)\n");
+}
+
+/**
+ * Tests the GCD command on polynomials whose gcd has coefficients too
+ * large for the primes, unless one of them divides the other one, and
+ * on a trivariate one of higher degrees.
+ * @param state
+ */
+static void test_gcd_wide(void **state) {
+    (void) state;
+    char *argv[] = {"calc_poly", NULL};
+    init_input_stream("(1,1)+(5000000000000000000,0)\nCLONE\nGCD\nPRINT\n"
+                      "(5000000000000000000,1)+(1,2)\n"
+                      "((5000000000000000000,1),0)+((1,1),1)\nGCD\n"
+                      "(4000000000000000000,1)+(1,2)\n"
+                      "((4000000000000000000,1),0)+((1,1),1)\nGCD\nPRINT\n"
+                      "(((1,25),25),25)+(-1,0)\n(((1,20),20),20)+(-1,0)\n"
+                      "GCD\nPRINT\n");
+    calculator_main(1, argv);
+
+    assert_string_equal(fprintf_buffer, "ERROR 7 RESULT TOO LARGE\n");
+    assert_string_equal(printf_buffer, "(5000000000000000000,0)+(1,1)\n"
+                                       "(4000000000000000000,0)+(1,1)\n"
+                                       "(-1,0)+(((1,5),5),5)\n");
+}
+
+/**
+ * Tests the bands of a product and the products computed by
+ * the processes, which are split however small they are.
+ * @param state
+ */
+static void test_mul_band(void **state) {
+    (void) state;
+    Mono m[3];
+    m[0] = (Mono) {.p = PolyFromCoeff(1), .exp = 0};
+    m[1] = (Mono) {.p = PolyFromCoeff(2), .exp = 1};
+    m[2] = (Mono) {.p = PolyFromCoeff(3), .exp = 3};
+    Poly p = PolyAddMonos(3, m), q = PolyMul(&p, &p), r = PolyZero();
+    for (poly_exp_t lo = -1; lo <= 6; lo += 2) {
+        Poly band = PolyMulBand(&p, &p, lo, lo + 1), sum = PolyAdd(&r, &band);
+        PolyDestroy(&band);
+        PolyDestroy(&r);
+        r = sum;
+    }
+    assert_true(PolyIsEq(&q, &r));
+    Poly band = PolyMulBand(&p, &p, 0, 0);
+    assert_true(PolyIsCoeff(&band) && band.coeff == 1);
+    band = PolyMulBand(&p, &p, 5, 5);
+    assert_true(PolyIsZero(&band));
+    ForkMulSetProcesses(4);
+    ForkMulSetMinWork(0);
+    Poly forked = ForkMul(&q, &p), product = PolyMul(&q, &p);
+    assert_true(PolyIsEq(&forked, &product));
+    PolyDestroy(&forked);
+    PolyDestroy(&product);
+    Mono y[2];
+    y[0] = (Mono) {.p = PolyFromCoeff(1), .exp = 0};
+    y[1] = (Mono) {.p = PolyFromCoeff(-1), .exp = 2};
+    m[0] = (Mono) {.p = PolyAddMonos(2, y), .exp = 1};
+    m[1] = (Mono) {.p = PolyFromCoeff(5), .exp = 4};
+    Poly t = PolyAddMonos(2, m);
+    forked = ForkMul(&q, &t);
+    product = PolyMul(&q, &t);
+    assert_true(PolyIsEq(&forked, &product));
+    ForkMulSetProcesses(1);
+    ForkMulSetMinWork(FORK_MIN_WORK);
+    PolyDestroy(&forked);
+    PolyDestroy(&product);
+    PolyDestroy(&t);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+
+    char *argv[] = {"calc_poly", "--mul-processes", "4", "--mul-min-work", "0",
+                    NULL};
+    init_input_stream("(1,0)+(2,1)+(3,3)\nCLONE\nMUL\nPRINT\n");
+    calculator_main(5, argv);
+
+    assert_string_equal(fprintf_buffer, "");
+    assert_string_equal(printf_buffer, "(1,0)+(4,1)+(4,2)+(6,3)+(12,4)+"
+                                       "(9,6)\n");
+}
+
 /** Initializes the context of the tests. */
 static int test_setup(void **state) {
     memset(fprintf_buffer, 0, sizeof(fprintf_buffer));
@@ -385,12 +1018,44 @@ int main() {
         cmocka_unit_test_setup(test_parse_min_minus_one, test_setup),
         cmocka_unit_test_setup(test_parse_max_plus_one, test_setup),
         cmocka_unit_test_setup(test_parse_much_more_than_max, test_setup),
+        cmocka_unit_test_setup(test_parse_coeff_overflow, test_setup),
         cmocka_unit_test_setup(test_parse_letters, test_setup),
         cmocka_unit_test_setup(test_parse_digits_and_letters, test_setup),
     };
     
+    const struct CMUnitTest stack_tests[] = {
+        cmocka_unit_test_setup(test_stack_depth, test_setup),
+        cmocka_unit_test_setup(test_stack_memory_limit, test_setup),
+        cmocka_unit_test_setup(test_stack_spill_limit, test_setup),
+        cmocka_unit_test_setup(test_stack_save_load, test_setup),
+        cmocka_unit_test_setup(test_stack_load_corrupt, test_setup),
+        cmocka_unit_test_setup(test_stack_save_load_packed, test_setup),
+        cmocka_unit_test_setup(test_stack_save_load_packed_zlib, test_setup),
+        cmocka_unit_test_setup(test_stack_load_packed_deep, test_setup),
+        cmocka_unit_test_setup(test_stack_checkpoint_restore, test_setup),
+        cmocka_unit_test_setup(test_stack_registers, test_setup),
+        cmocka_unit_test_setup(test_chain, test_setup),
+        cmocka_unit_test_setup(test_program, test_setup),
+        cmocka_unit_test_setup(test_lazy, test_setup),
+        cmocka_unit_test_setup(test_lazy_mem_limit, test_setup),
+        cmocka_unit_test_setup(test_mul_add, test_setup),
+        cmocka_unit_test_setup(test_pipeline, test_setup),
+        cmocka_unit_test_setup(test_parallel, test_setup),
+        cmocka_unit_test_setup(test_add_n, test_setup),
+        cmocka_unit_test_setup(test_mul_n, test_setup),
+        cmocka_unit_test_setup(test_mul_print_save, test_setup),
+        cmocka_unit_test_setup(test_op_limit, test_setup),
+        cmocka_unit_test_setup(test_lazy_op_limit, test_setup),
+        cmocka_unit_test_setup(test_div, test_setup),
+        cmocka_unit_test_setup(test_gcd, test_setup),
+        cmocka_unit_test_setup(test_gcd_sparse, test_setup),
+        cmocka_unit_test_setup(test_gcd_wide, test_setup),
+        cmocka_unit_test_setup(test_mul_band, test_setup),
+    };
+    
     int res;
     res = cmocka_run_group_tests(compose_calculations_tests, NULL, NULL);
     res += cmocka_run_group_tests(compose_parser_tests, NULL, NULL);
+    res += cmocka_run_group_tests(stack_tests, NULL, NULL);
     return res;
 }
@@ -91,8 +91,8 @@ void _test_free(void* const ptr, char* const file, const int line);
 
 /* Function main is defined in the unit test so redefine name of the main
  * function here. */
-#define main(...) calculator_main()
-int calculator_main();
+#define main(...) calculator_main(__VA_ARGS__)
+int calculator_main(int argc, char *argv[]);
 
 #endif /* UNIT_TESTING */
 